@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #define __NEED_size_t
+#define __NEED_FILE
 
 #include <bits/alltypes.h>
 
@@ -17,6 +18,28 @@ void *valloc (size_t);
 void *memalign(size_t, size_t);
 
 size_t malloc_usable_size(void *);
+int malloc_trim(size_t);
+
+struct mallinfo2 {
+	size_t arena;
+	size_t ordblks;
+	size_t smblks;
+	size_t hblks;
+	size_t hblkhd;
+	size_t usmblks;
+	size_t fsmblks;
+	size_t uordblks;
+	size_t fordblks;
+	size_t keepcost;
+};
+
+struct mallinfo2 mallinfo2(void);
+int malloc_info(int, FILE *);
+
+struct malloc_arena;
+struct malloc_arena *malloc_arena_create(void);
+void *malloc_arena_alloc(struct malloc_arena *, size_t);
+void malloc_arena_destroy(struct malloc_arena *);
 
 #ifdef __cplusplus
 }
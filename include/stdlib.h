@@ -43,6 +43,11 @@ void *realloc (void *, size_t);
 void free (void *);
 void *aligned_alloc(size_t, size_t);
 
+#if __STDC_VERSION__ >= 202311L || defined(_GNU_SOURCE) || defined(_BSD_SOURCE)
+void free_sized (void *, size_t);
+void free_aligned_sized (void *, size_t, size_t);
+#endif
+
 _Noreturn void abort (void);
 int atexit (void (*) (void));
 _Noreturn void exit (int);
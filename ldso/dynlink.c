@@ -1785,10 +1785,13 @@ hidden void __dls2(unsigned char *base, size_t *sp)
 
 void __dls2b(size_t *sp, size_t *auxv)
 {
-	/* Do this first before string functions start caching them */
+	/* Do this first so string functions are bound before any use */
 	__attribute__((visibility("hidden")))
-	extern void __init_cpu_features(void);
-	__init_cpu_features();
+	extern void __init_cpu_features(char **envp);
+	__attribute__((visibility("hidden")))
+	extern void __init_cpu_dispatch(void);
+	__init_cpu_features((char **)(sp+1+*sp+1));
+	__init_cpu_dispatch();
 
 	/* Setup early thread pointer in builtin_tls for ldso/libc itself to
 	 * use during dynamic linking. If possible it will also serve as the
@@ -15,8 +15,13 @@ extern weak hidden void (*const __init_array_start)(void), (*const __init_array_
 static void dummy1(void *p) {}
 weak_alias(dummy1, __init_ssp);
 
+static void dummy2(char **envp) {}
+weak_alias(dummy2, __malloc_init_options);
+
+__attribute__((visibility("hidden")))
+void __init_cpu_features(char **envp);
 __attribute__((visibility("hidden")))
-void __init_cpu_features(void);
+void __init_cpu_dispatch(void);
 
 #define AUX_CNT 38
 
@@ -26,7 +31,8 @@ __attribute__((__noinline__))
 void __init_libc(char **envp, char *pn)
 {
 	size_t i, *auxv, aux[AUX_CNT] = { 0 };
-	__init_cpu_features();
+	__init_cpu_features(envp);
+	__init_cpu_dispatch();
 	__environ = envp;
 	for (i=0; envp[i]; i++);
 	libc.auxv = auxv = (void *)(envp+i+1);
@@ -44,7 +50,12 @@ void __init_libc(char **envp, char *pn)
 	__init_ssp((void *)aux[AT_RANDOM]);
 
 	if (aux[AT_UID]==aux[AT_EUID] && aux[AT_GID]==aux[AT_EGID]
-		&& !aux[AT_SECURE]) return;
+		&& !aux[AT_SECURE]) {
+		/* secure programs don't take malloc options from
+		 * the environment */
+		__malloc_init_options(envp);
+		return;
+	}
 
 	struct pollfd pfd[3] = { {.fd=0}, {.fd=1}, {.fd=2} };
 	int r =
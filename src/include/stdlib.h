@@ -15,5 +15,6 @@ hidden void *__libc_malloc_impl(size_t);
 hidden void *__libc_calloc(size_t, size_t);
 hidden void *__libc_realloc(void *, size_t);
 hidden void __libc_free(void *);
+hidden void __libc_free_sized(void *, size_t, size_t);
 
 #endif
@@ -25,6 +25,8 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <features.h>
+#include <stddef.h>
 #include <stdint.h>
 #if __x86_64__ || __i386__
 #include <cpuid.h>
@@ -34,22 +36,164 @@
 #include "cpu_features.h"
 
 __attribute__((visibility("hidden")))
-struct cpu_features cpu_features = {0};
+struct cpu_features cpu_features = {
+	.non_temporal_threshold = 1 << 21,
+	.non_temporal_fill_threshold = 1 << 21,
+	.rep_movsb_threshold = -1,
+	.rep_stosb_threshold = -1,
+};
 
 #if __x86_64__ || __i386__
 __attribute__((__target__("xsave")))
 static inline uint64_t my_xgetbv(unsigned int A) { return _xgetbv(A); }
+
+/* sizes of the data and unified caches described by a deterministic
+ * cache parameters leaf (4 on Intel, 0x8000001d on AMD) */
+static void cache_parameters(unsigned int leaf) {
+	unsigned int eax, ebx, ecx, edx;
+	for (unsigned int i = 0; __get_cpuid_count(leaf, i, &eax, &ebx, &ecx, &edx); i++) {
+		unsigned int type = eax & 31;
+		if (type == 0)
+			break;
+		if (type == 2)
+			continue;
+		size_t line = (ebx & 0xfff) + 1;
+		size_t size = (size_t)((ebx >> 22) + 1) * ((ebx >> 12 & 0x3ff) + 1) * line * (ecx + 1);
+		switch (eax >> 5 & 7) {
+		case 1:
+			cpu_features.l1d_size = size;
+			cpu_features.line_size = line;
+			break;
+		case 2:
+			cpu_features.l2_size = size;
+			break;
+		case 3:
+			cpu_features.l3_size = size;
+			break;
+		}
+	}
+}
+
+/* the legacy AMD cache leaves, also implemented by Intel for L2 */
+static void cache_legacy(void) {
+	unsigned int eax, ebx, ecx, edx;
+	if (!cpu_features.l1d_size && __get_cpuid(0x80000005, &eax, &ebx, &ecx, &edx)) {
+		cpu_features.l1d_size = (size_t)(ecx >> 24) << 10;
+		if (!cpu_features.line_size)
+			cpu_features.line_size = ecx & 0xff;
+	}
+	if (__get_cpuid(0x80000006, &eax, &ebx, &ecx, &edx)) {
+		if (!cpu_features.l2_size)
+			cpu_features.l2_size = (size_t)(ecx >> 16) << 10;
+		if (!cpu_features.l3_size)
+			cpu_features.l3_size = (size_t)(edx >> 18) << 19;
+		if (!cpu_features.line_size)
+			cpu_features.line_size = ecx & 0xff;
+	}
+}
+
+#define FEATURE(name) { #name, offsetof(struct cpu_features, name) }
+
+static const struct {
+	char name[12];
+	unsigned short offset;
+} feature_names[] = {
+	FEATURE(sse2),
+	FEATURE(popcnt),
+	FEATURE(avx),
+	FEATURE(avx2),
+	FEATURE(avx512f),
+	FEATURE(avx512bw),
+	FEATURE(avx512cd),
+	FEATURE(avx512dq),
+	FEATURE(avx512er),
+	FEATURE(avx512vl),
+	FEATURE(avx512vbmi),
+	FEATURE(avx512vbmi2),
+	FEATURE(fma),
+	FEATURE(bmi1),
+	FEATURE(bmi2),
+	FEATURE(lzcnt),
+	FEATURE(vaes),
+	FEATURE(vpclmulqdq),
+	FEATURE(erms),
+	FEATURE(fsrm),
+	FEATURE(fzlrm),
+};
+
+/* string functions are not resolved yet, so don't call them */
+static int name_is(const char *s, size_t n, const char *name) {
+	size_t i;
+	for (i = 0; i < n && s[i] == name[i]; i++);
+	return i == n && !name[n];
+}
+
+/*
+ * MUSL_HWCAP_MASK is a comma separated list of features to hide from
+ * dispatch, each optionally prefixed with '-', e.g. "-avx512,-avx2".
+ * "avx512" stands for all AVX-512 subsets. Features can only be taken
+ * away, never added, and those the compiler was told to assume stay.
+ */
+static void mask_features(const char *s) {
+	while (*s) {
+		const char *e = s;
+		while (*e && *e != ',')
+			e++;
+		if (*s == '-')
+			s++;
+		if (name_is(s, e - s, "avx512"))
+			cpu_features.avx512f = 0;
+		for (size_t i = 0; i < sizeof feature_names / sizeof *feature_names; i++)
+			if (name_is(s, e - s, feature_names[i].name))
+				*(int*)((char*)&cpu_features + feature_names[i].offset) = 0;
+		s = *e ? e + 1 : e;
+	}
+	if (!cpu_features.avx) {
+		cpu_features.avx2 = 0;
+		cpu_features.fma = 0;
+		cpu_features.vaes = 0;
+		cpu_features.vpclmulqdq = 0;
+		cpu_features.avx512f = 0;
+	}
+	if (!cpu_features.avx512f) {
+		cpu_features.avx512bw = 0;
+		cpu_features.avx512cd = 0;
+		cpu_features.avx512dq = 0;
+		cpu_features.avx512er = 0;
+		cpu_features.avx512vl = 0;
+		cpu_features.avx512vbmi = 0;
+		cpu_features.avx512vbmi2 = 0;
+	}
+}
+
+static const char *find_env(char **envp, const char *name) {
+	for (; *envp; envp++) {
+		const char *s = *envp;
+		size_t i;
+		for (i = 0; name[i] && s[i] == name[i]; i++);
+		if (!name[i] && s[i] == '=')
+			return s + i + 1;
+	}
+	return 0;
+}
 #endif
 
 __attribute__((visibility("hidden")))
-void __init_cpu_features(void) {
+void __init_cpu_features(char **envp) {
 #if __x86_64__ || __i386__
 	unsigned int eax, ebx, ecx, edx;
+	unsigned int eax7 = 0, ebx7 = 0, ecx7 = 0, edx7 = 0;
+	unsigned int eax71 = 0, ebx71, ecx71, edx71;
 	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
-		return;
+		goto out;
+	if (__get_cpuid_count(7, 0, &eax7, &ebx7, &ecx7, &edx7) && eax7 >= 1)
+		__get_cpuid_count(7, 1, &eax71, &ebx71, &ecx71, &edx71);
 	if (edx & bit_SSE2) {
 		cpu_features.sse2 = 1;
 	}
+	if (ecx & bit_POPCNT) {
+		cpu_features.popcnt = 1;
+	}
 	if (ecx & bit_FMA) {
 		cpu_features.fma = 1;
 	}
@@ -59,28 +203,159 @@ void __init_cpu_features(void) {
 		if ((xcr & 6) == 6) {
 			if (ecx & bit_AVX)
 				cpu_features.avx = 1;
-			if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
-				return;
 			if (cpu_features.avx) {
-				if (ebx & bit_AVX2)
+				if (ebx7 & bit_AVX2)
 					cpu_features.avx2 = 1;
+				if (ecx7 & bit_VAES)
+					cpu_features.vaes = 1;
+				if (ecx7 & bit_VPCLMULQDQ)
+					cpu_features.vpclmulqdq = 1;
 			}
 			if ((xcr & 224) == 224) {
-				if (ebx & bit_AVX512F) {
+				if (ebx7 & bit_AVX512F) {
 					cpu_features.avx512f = 1;
-					if (ebx & bit_AVX512BW)
+					if (ebx7 & bit_AVX512BW)
 						cpu_features.avx512bw = 1;
-					if (ebx & bit_AVX512CD)
+					if (ebx7 & bit_AVX512CD)
 						cpu_features.avx512cd = 1;
-					if (ebx & bit_AVX512DQ)
+					if (ebx7 & bit_AVX512DQ)
 						cpu_features.avx512dq = 1;
-					if (ebx & bit_AVX512ER)
+					if (ebx7 & bit_AVX512ER)
 						cpu_features.avx512er = 1;
-					if (ebx & bit_AVX512VL)
+					if (ebx7 & bit_AVX512VL)
 						cpu_features.avx512vl = 1;
+					if (ecx7 & bit_AVX512VBMI)
+						cpu_features.avx512vbmi = 1;
+					if (ecx7 & bit_AVX512VBMI2)
+						cpu_features.avx512vbmi2 = 1;
 				}
 			}
 		}
 	}
+	if (ebx7 & bit_BMI)
+		cpu_features.bmi1 = 1;
+	if (ebx7 & bit_BMI2)
+		cpu_features.bmi2 = 1;
+	if (ebx7 & bit_ENH_MOVSB)
+		cpu_features.erms = 1;
+	if (edx7 & bit_FSRM)
+		cpu_features.fsrm = 1;
+	if (eax71 & bit_FZLRM)
+		cpu_features.fzlrm = 1;
+	if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) && (ecx & bit_LZCNT))
+		cpu_features.lzcnt = 1;
+
+	const char *mask = find_env(envp, "MUSL_HWCAP_MASK");
+	if (mask)
+		mask_features(mask);
+
+	cache_parameters(4);
+	if (!cpu_features.l1d_size)
+		cache_parameters(0x8000001d);
+	cache_legacy();
+	cpu_features.llc_size = cpu_features.l3_size ? cpu_features.l3_size : cpu_features.l2_size;
+
+	/* stream copies that would evict a good part of the last level cache */
+	if (cpu_features.llc_size) {
+		cpu_features.non_temporal_threshold = cpu_features.llc_size / 4;
+		/* a fill only has a destination, so it may use the whole cache */
+		cpu_features.non_temporal_fill_threshold = cpu_features.llc_size;
+	}
+	if (cpu_features.erms) {
+		cpu_features.rep_movsb_threshold = cpu_features.fsrm ? 2048 : 4096;
+		cpu_features.rep_stosb_threshold = 2048;
+	}
+out:
+#endif
+	/* the line size is left 0 above until some cpuid leaf reports one */
+	if (!cpu_features.line_size)
+		cpu_features.line_size = 64;
+}
+
+#if __x86_64__ || __i386__
+static void dummy(void) {}
+weak_alias(dummy, __memccpy_resolve);
+weak_alias(dummy, __memchr_resolve);
+weak_alias(dummy, __memcmp_resolve);
+weak_alias(dummy, __memcpy_resolve);
+weak_alias(dummy, __memmem_resolve);
+weak_alias(dummy, __memmove_resolve);
+weak_alias(dummy, __memrchr_resolve);
+weak_alias(dummy, __memset_resolve);
+weak_alias(dummy, __rawmemchr_resolve);
+weak_alias(dummy, __stpcpy_resolve);
+weak_alias(dummy, __stpncpy_resolve);
+weak_alias(dummy, __strcasecmp_resolve);
+weak_alias(dummy, __strcasestr_resolve);
+weak_alias(dummy, __strchrnul_resolve);
+weak_alias(dummy, __strcmp_resolve);
+weak_alias(dummy, __strcspn_resolve);
+weak_alias(dummy, __strlen_resolve);
+weak_alias(dummy, __strncasecmp_resolve);
+weak_alias(dummy, __strncmp_resolve);
+weak_alias(dummy, __strnlen_resolve);
+weak_alias(dummy, __strrchr_resolve);
+weak_alias(dummy, __strspn_resolve);
+weak_alias(dummy, __strstr_resolve);
+weak_alias(dummy, __wcpcpy_resolve);
+weak_alias(dummy, __wcschr_resolve);
+weak_alias(dummy, __wcscmp_resolve);
+weak_alias(dummy, __wcscspn_resolve);
+weak_alias(dummy, __wcslen_resolve);
+weak_alias(dummy, __wcsncmp_resolve);
+weak_alias(dummy, __wcsrchr_resolve);
+weak_alias(dummy, __wcsspn_resolve);
+weak_alias(dummy, __wmemchr_resolve);
+weak_alias(dummy, __wmemcmp_resolve);
+weak_alias(dummy, __wmemset_resolve);
+
+/* Every dispatched function has a resolver binding its implementation
+ * pointers from cpu_features. Only the ones linked into the program
+ * override the dummy above, so static binaries pay for what they use. */
+static void (*const resolvers[])(void) = {
+	__memccpy_resolve,
+	__memchr_resolve,
+	__memcmp_resolve,
+	__memcpy_resolve,
+	__memmem_resolve,
+	__memmove_resolve,
+	__memrchr_resolve,
+	__memset_resolve,
+	__rawmemchr_resolve,
+	__stpcpy_resolve,
+	__stpncpy_resolve,
+	__strcasecmp_resolve,
+	__strcasestr_resolve,
+	__strchrnul_resolve,
+	__strcmp_resolve,
+	__strcspn_resolve,
+	__strlen_resolve,
+	__strncasecmp_resolve,
+	__strncmp_resolve,
+	__strnlen_resolve,
+	__strrchr_resolve,
+	__strspn_resolve,
+	__strstr_resolve,
+	__wcpcpy_resolve,
+	__wcschr_resolve,
+	__wcscmp_resolve,
+	__wcscspn_resolve,
+	__wcslen_resolve,
+	__wcsncmp_resolve,
+	__wcsrchr_resolve,
+	__wcsspn_resolve,
+	__wmemchr_resolve,
+	__wmemcmp_resolve,
+	__wmemset_resolve,
+};
+#endif
+
+/* Binds all dispatched functions once, before any threads exist, so the
+ * lazy first-call resolution never runs in a program past startup. */
+__attribute__((visibility("hidden")))
+void __init_cpu_dispatch(void) {
+#if __x86_64__ || __i386__
+	for (size_t i = 0; i < sizeof resolvers / sizeof *resolvers; i++)
+		resolvers[i]();
 #endif
 }
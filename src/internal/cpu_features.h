@@ -28,8 +28,11 @@
 #ifndef CPU_FEATURES_H
 #define CPU_FEATURES_H
 
+#include <stddef.h>
+
 struct cpu_features {
 	int sse2;
+	int popcnt;
 	int osxsave;
 	int avx;
 	int avx2;
@@ -39,7 +42,26 @@ struct cpu_features {
 	int avx512dq;
 	int avx512er;
 	int avx512vl;
+	int avx512vbmi;
+	int avx512vbmi2;
 	int fma;
+	int bmi1;
+	int bmi2;
+	int lzcnt;
+	int vaes;
+	int vpclmulqdq;
+	int erms;
+	int fsrm;
+	int fzlrm;
+	size_t l1d_size;
+	size_t l2_size;
+	size_t l3_size;
+	size_t line_size;
+	size_t llc_size;
+	size_t non_temporal_threshold;
+	size_t non_temporal_fill_threshold;
+	size_t rep_movsb_threshold;
+	size_t rep_stosb_threshold;
 };
 
 __attribute__((visibility("hidden")))
@@ -85,6 +107,30 @@ static inline int has_avx512bw() {
 #endif
 }
 
+static inline int has_avx512vl() {
+#ifdef __AVX512VL__
+	return 1;
+#else
+	return cpu_features.avx512vl;
+#endif
+}
+
+static inline int has_avx512vbmi() {
+#ifdef __AVX512VBMI__
+	return 1;
+#else
+	return cpu_features.avx512vbmi;
+#endif
+}
+
+static inline int has_avx512vbmi2() {
+#ifdef __AVX512VBMI2__
+	return 1;
+#else
+	return cpu_features.avx512vbmi2;
+#endif
+}
+
 static inline int has_fma() {
 #ifdef __FMA__
 	return 1;
@@ -93,4 +139,93 @@ static inline int has_fma() {
 #endif
 }
 
+static inline int has_popcnt() {
+#ifdef __POPCNT__
+	return 1;
+#else
+	return cpu_features.popcnt;
+#endif
+}
+
+static inline int has_bmi1() {
+#ifdef __BMI__
+	return 1;
+#else
+	return cpu_features.bmi1;
+#endif
+}
+
+static inline int has_bmi2() {
+#ifdef __BMI2__
+	return 1;
+#else
+	return cpu_features.bmi2;
+#endif
+}
+
+static inline int has_lzcnt() {
+#ifdef __LZCNT__
+	return 1;
+#else
+	return cpu_features.lzcnt;
+#endif
+}
+
+static inline int has_vaes() {
+#ifdef __VAES__
+	return 1;
+#else
+	return cpu_features.vaes;
+#endif
+}
+
+static inline int has_vpclmulqdq() {
+#ifdef __VPCLMULQDQ__
+	return 1;
+#else
+	return cpu_features.vpclmulqdq;
+#endif
+}
+
+static inline int has_erms() {
+	return cpu_features.erms;
+}
+
+static inline int has_fsrm() {
+	return cpu_features.fsrm;
+}
+
+static inline int has_fzlrm() {
+	return cpu_features.fzlrm;
+}
+
+static inline size_t cache_line_size() {
+	return cpu_features.line_size;
+}
+
+/* size of the last level cache, 0 if unknown */
+static inline size_t llc_size() {
+	return cpu_features.llc_size;
+}
+
+/* copies at least this large bypass the cache */
+static inline size_t non_temporal_threshold() {
+	return cpu_features.non_temporal_threshold;
+}
+
+/* fills at least this large bypass the cache */
+static inline size_t non_temporal_fill_threshold() {
+	return cpu_features.non_temporal_fill_threshold;
+}
+
+/* copies at least this large (and below the non-temporal threshold) use rep movsb */
+static inline size_t rep_movsb_threshold() {
+	return cpu_features.rep_movsb_threshold;
+}
+
+/* fills at least this large (and below the non-temporal threshold) use rep stosb */
+static inline size_t rep_stosb_threshold() {
+	return cpu_features.rep_stosb_threshold;
+}
+
 #endif // CPU_FEATURES_H
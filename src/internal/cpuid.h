@@ -105,6 +105,42 @@
 #define bit_AVX512BW    0x40000000
 #define bit_AVX512VL    0x80000000
 
+/* Features in %ecx for leaf 7 sub-leaf 0 */
+#define bit_PREFTCHWT1       0x00000001
+#define bit_AVX512VBMI       0x00000002
+#define bit_PKU              0x00000004
+#define bit_OSPKE            0x00000010
+#define bit_WAITPKG          0x00000020
+#define bit_AVX512VBMI2      0x00000040
+#define bit_SHSTK            0x00000080
+#define bit_GFNI             0x00000100
+#define bit_VAES             0x00000200
+#define bit_VPCLMULQDQ       0x00000400
+#define bit_AVX512VNNI       0x00000800
+#define bit_AVX512BITALG     0x00001000
+#define bit_AVX512VPOPCNTDQ  0x00004000
+#define bit_RDPID            0x00400000
+
+/* Features in %edx for leaf 7 sub-leaf 0 */
+#define bit_FSRM        0x00000010
+
+/* Features in %eax for leaf 7 sub-leaf 1 */
+#define bit_FZLRM       0x00000400
+#define bit_FSRS        0x00000800
+#define bit_FSRCS       0x00001000
+
+/* Features in %ecx for leaf 0x80000001 */
+#define bit_LAHF_LM     0x00000001
+#define bit_ABM         0x00000020
+#define bit_LZCNT       bit_ABM        /* for gcc compat */
+#define bit_SSE4a       0x00000040
+#define bit_PRFCHW      0x00000100
+#define bit_XOP         0x00000800
+#define bit_LWP         0x00008000
+#define bit_FMA4        0x00010000
+#define bit_TBM         0x00200000
+#define bit_MWAITX      0x20000000
+
 
 #if __i386__
 #define __cpuid(__leaf, __eax, __ebx, __ecx, __edx) \
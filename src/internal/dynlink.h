@@ -113,5 +113,6 @@ hidden extern int __malloc_replaced;
 hidden extern int __aligned_alloc_replaced;
 hidden void __malloc_donate(char *, char *);
 hidden int __malloc_allzerop(void *);
+hidden void __malloc_free_sized(void *, size_t, size_t);
 
 #endif
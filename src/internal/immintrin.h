@@ -13,13 +13,29 @@ typedef long long __m128i __attribute__((__vector_size__(16), __aligned__(16)));
 typedef long long __m128i_u __attribute__((__vector_size__(16), __aligned__(1)));
 typedef long long __v2di __attribute__ ((__vector_size__ (16)));
 typedef char __v16qi __attribute__((__vector_size__(16)));
+typedef unsigned char __v16qu __attribute__((__vector_size__(16)));
 typedef unsigned long long __v2du __attribute__ ((__vector_size__ (16)));
 typedef long long __v4di __attribute__ ((__vector_size__ (32)));
 typedef int __v8si __attribute__ ((__vector_size__ (32)));
 typedef char __v32qi __attribute__ ((__vector_size__ (32)));
+typedef unsigned char __v32qu __attribute__ ((__vector_size__ (32)));
+typedef unsigned short __v16hu __attribute__ ((__vector_size__ (32)));
 typedef unsigned long long __v4du __attribute__ ((__vector_size__ (32)));
 typedef long long __m256i __attribute__((__vector_size__(32), __aligned__(32)));
 typedef long long __m256i_u __attribute__((__vector_size__(32), __aligned__(1)));
+typedef long long __v8di __attribute__ ((__vector_size__ (64)));
+typedef int __v16si __attribute__ ((__vector_size__ (64)));
+typedef short __v32hi __attribute__ ((__vector_size__ (64)));
+typedef unsigned short __v32hu __attribute__ ((__vector_size__ (64)));
+typedef char __v64qi __attribute__ ((__vector_size__ (64)));
+typedef unsigned char __v64qu __attribute__ ((__vector_size__ (64)));
+typedef unsigned long long __v8du __attribute__ ((__vector_size__ (64)));
+typedef long long __m512i __attribute__((__vector_size__(64), __aligned__(64)));
+typedef long long __m512i_u __attribute__((__vector_size__(64), __aligned__(1)));
+typedef unsigned char __mmask8;
+typedef unsigned short __mmask16;
+typedef unsigned int __mmask32;
+typedef unsigned long long __mmask64;
 #define _MM_HINT_NTA 0
 /// Loads one cache line of data from the specified address to a location
 ///    closer to the processor.
@@ -140,6 +156,23 @@ _mm_or_si128(__m128i __a, __m128i __b)
 {
   return (__m128i)((__v2du)__a | (__v2du)__b);
 }
+/// Subtracts the corresponding 8-bit integer values in the operands.
+///
+/// \headerfile <x86intrin.h>
+///
+/// This intrinsic corresponds to the <c> VPSUBB / PSUBB </c> instruction.
+///
+/// \param __a
+///    A 128-bit integer vector containing the minuends.
+/// \param __b
+///    A 128-bit integer vector containing the subtrahends.
+/// \returns A 128-bit integer vector containing the differences of the values
+///    in the operands.
+static __inline__ __m128i __DEFAULT_FN_ATTRS
+_mm_sub_epi8(__m128i __a, __m128i __b)
+{
+  return (__m128i)((__v16qu)__a - (__v16qu)__b);
+}
 /// Compares each of the corresponding 8-bit values of the 128-bit
 ///    integer vectors for equality. Each comparison yields 0x0 for false, 0xFF
 ///    for true.
@@ -330,6 +363,28 @@ _mm_set1_epi32(int __i)
 {
   return _mm_set_epi32(__i, __i, __i, __i);
 }
+/// Compares corresponding elements of two 128-bit unsigned [16 x i8]
+///    vectors, saving the smaller value from each comparison in the
+///    corresponding element of a 128-bit result vector of [16 x i8].
+///
+/// \headerfile <x86intrin.h>
+///
+/// This intrinsic corresponds to the <c> VPMINUB / PMINUB </c> instruction.
+///
+/// \param __a
+///    A 128-bit unsigned [16 x i8] vector.
+/// \param __b
+///    A 128-bit unsigned [16 x i8] vector.
+/// \returns A 128-bit unsigned [16 x i8] vector containing the smaller values.
+static __inline__ __m128i __DEFAULT_FN_ATTRS
+_mm_min_epu8(__m128i __a, __m128i __b)
+{
+#ifdef __clang__
+  return (__m128i)__builtin_elementwise_min((__v16qu)__a, (__v16qu)__b);
+#else
+  return (__m128i)__builtin_ia32_pminub128((__v16qi)__a, (__v16qi)__b);
+#endif
+}
 /// Copies the values of the most significant bits from each 8-bit
 ///    element in a 128-bit integer vector of [16 x i8] to create a 16-bit mask
 ///    value, zero-extends the value, and writes it to the destination.
@@ -879,6 +934,44 @@ _mm256_cmpeq_epi32(__m256i __a, __m256i __b)
 {
   return (__m256i)((__v8si)__a == (__v8si)__b);
 }
+static __inline__ __m256i __DEFAULT_FN_ATTRS256
+_mm256_min_epu8(__m256i __a, __m256i __b)
+{
+#ifdef __clang__
+  return (__m256i)__builtin_elementwise_min((__v32qu)__a, (__v32qu)__b);
+#else
+  return (__m256i)__builtin_ia32_pminub256((__v32qi)__a, (__v32qi)__b);
+#endif
+}
+static __inline__ __m256i __DEFAULT_FN_ATTRS256
+_mm256_xor_si256(__m256i __a, __m256i __b)
+{
+  return (__m256i)((__v4du)__a ^ (__v4du)__b);
+}
+static __inline__ __m256i __DEFAULT_FN_ATTRS256
+_mm256_shuffle_epi8(__m256i __a, __m256i __b)
+{
+  return (__m256i)__builtin_ia32_pshufb256((__v32qi)__a, (__v32qi)__b);
+}
+static __inline__ __m256i __DEFAULT_FN_ATTRS256
+_mm256_srli_epi16(__m256i __a, int __count)
+{
+  return (__m256i)((__v16hu)__a >> __count);
+}
+static __inline__ __m256i __DEFAULT_FN_ATTRS256
+_mm256_broadcastsi128_si256(__m128i __X)
+{
+#ifdef __clang__
+  return (__m256i)__builtin_shufflevector((__v2di)__X, (__v2di)__X, 0, 1, 0, 1);
+#else
+  return (__m256i)__builtin_ia32_vbroadcastsi256((__v2di)__X);
+#endif
+}
+static __inline__ __m256i __DEFAULT_FN_ATTRS256
+_mm256_sub_epi8(__m256i __a, __m256i __b)
+{
+  return (__m256i)((__v32qu)__a - (__v32qu)__b);
+}
 static __inline__ int __DEFAULT_FN_ATTRS256
 _mm256_movemask_epi8(__m256i __a)
 {
@@ -901,6 +994,193 @@ _mm256_or_si256(__m256i __a, __m256i __b)
   (__m256i)__builtin_ia32_psrldqi256((__m256i)(a), (int)(imm) * 8)
 #endif
 #undef __DEFAULT_FN_ATTRS256
+#ifdef __clang__
+#define __DEFAULT_FN_ATTRS512 __attribute__((__always_inline__, __nodebug__, __target__("avx512f"), __min_vector_width__(512)))
+#define __DEFAULT_FN_ATTRS512BW __attribute__((__always_inline__, __nodebug__, __target__("avx512bw"), __min_vector_width__(512)))
+#else
+#define __DEFAULT_FN_ATTRS512 __attribute__((__always_inline__, __target__("avx512f")))
+#define __DEFAULT_FN_ATTRS512BW __attribute__((__always_inline__, __target__("avx512bw")))
+#endif
+static __inline__ __m512i __DEFAULT_FN_ATTRS512
+_mm512_setzero_si512(void)
+{
+  return __extension__ (__m512i)(__v8di){ 0, 0, 0, 0, 0, 0, 0, 0 };
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512
+_mm512_set1_epi8(char __b)
+{
+  return (__m512i)((__v64qi)_mm512_setzero_si512() + __b);
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512
+_mm512_set1_epi32(int __i)
+{
+  return (__m512i)((__v16si)_mm512_setzero_si512() + __i);
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512
+_mm512_broadcast_i32x4(__m128i __a)
+{
+  __v2di __v = (__v2di)__a;
+  return __extension__ (__m512i)(__v8di){ __v[0], __v[1], __v[0], __v[1], __v[0], __v[1], __v[0], __v[1] };
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512
+_mm512_load_si512(void const *__p)
+{
+  return *(const __m512i *)__p;
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512
+_mm512_loadu_si512(void const *__p)
+{
+  struct __loadu_si512 {
+    __m512i_u __v;
+  } __attribute__((__packed__, __may_alias__));
+  return ((const struct __loadu_si512*)__p)->__v;
+}
+static __inline__ void __DEFAULT_FN_ATTRS512
+_mm512_store_si512(void *__p, __m512i __a)
+{
+  *(__m512i *)__p = __a;
+}
+static __inline__ void __DEFAULT_FN_ATTRS512
+_mm512_storeu_si512(void *__p, __m512i __a)
+{
+  struct __storeu_si512 {
+    __m512i_u __v;
+  } __attribute__((__packed__, __may_alias__));
+  ((struct __storeu_si512*)__p)->__v = __a;
+}
+static __inline__ void __DEFAULT_FN_ATTRS512
+_mm512_stream_si512(void *__p, __m512i __a)
+{
+#ifdef __clang__
+  __builtin_nontemporal_store((__v8di)__a, (__v8di*)__p);
+#else
+  __builtin_ia32_movntdq512((__v8di*)__p, (__v8di)__a);
+#endif
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512
+_mm512_and_si512(__m512i __a, __m512i __b)
+{
+  return (__m512i)((__v8du)__a & (__v8du)__b);
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512
+_mm512_or_si512(__m512i __a, __m512i __b)
+{
+  return (__m512i)((__v8du)__a | (__v8du)__b);
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512
+_mm512_xor_si512(__m512i __a, __m512i __b)
+{
+  return (__m512i)((__v8du)__a ^ (__v8du)__b);
+}
+static __inline__ __mmask16 __DEFAULT_FN_ATTRS512
+_mm512_cmpeq_epi32_mask(__m512i __a, __m512i __b)
+{
+  return (__mmask16)__builtin_ia32_cmpd512_mask((__v16si)__a, (__v16si)__b, 0, (__mmask16)-1);
+}
+static __inline__ __mmask16 __DEFAULT_FN_ATTRS512
+_mm512_cmpneq_epi32_mask(__m512i __a, __m512i __b)
+{
+  return (__mmask16)__builtin_ia32_cmpd512_mask((__v16si)__a, (__v16si)__b, 4, (__mmask16)-1);
+}
+static __inline__ __mmask16 __DEFAULT_FN_ATTRS512
+_mm512_testn_epi32_mask(__m512i __a, __m512i __b)
+{
+  return _mm512_cmpeq_epi32_mask(_mm512_and_si512(__a, __b), _mm512_setzero_si512());
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512
+_mm512_maskz_loadu_epi32(__mmask16 __u, void const *__p)
+{
+  return (__m512i)__builtin_ia32_loaddqusi512_mask((const int *)__p, (__v16si)_mm512_setzero_si512(), (__mmask16)__u);
+}
+static __inline__ void __DEFAULT_FN_ATTRS512
+_mm512_mask_storeu_epi32(void *__p, __mmask16 __u, __m512i __a)
+{
+  __builtin_ia32_storedqusi512_mask((int *)__p, (__v16si)__a, (__mmask16)__u);
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512BW
+_mm512_min_epu8(__m512i __a, __m512i __b)
+{
+#ifdef __clang__
+  return (__m512i)__builtin_elementwise_min((__v64qu)__a, (__v64qu)__b);
+#else
+  return (__m512i)__builtin_ia32_pminub512_mask((__v64qi)__a, (__v64qi)__b, (__v64qi)_mm512_setzero_si512(), (__mmask64)-1);
+#endif
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512BW
+_mm512_sub_epi8(__m512i __a, __m512i __b)
+{
+  return (__m512i)((__v64qu)__a - (__v64qu)__b);
+}
+static __inline__ __mmask64 __DEFAULT_FN_ATTRS512BW
+_mm512_cmpeq_epi8_mask(__m512i __a, __m512i __b)
+{
+  return (__mmask64)__builtin_ia32_cmpb512_mask((__v64qi)__a, (__v64qi)__b, 0, (__mmask64)-1);
+}
+static __inline__ __mmask64 __DEFAULT_FN_ATTRS512BW
+_mm512_mask_cmpeq_epi8_mask(__mmask64 __u, __m512i __a, __m512i __b)
+{
+  return (__mmask64)__builtin_ia32_cmpb512_mask((__v64qi)__a, (__v64qi)__b, 0, __u);
+}
+static __inline__ __mmask64 __DEFAULT_FN_ATTRS512BW
+_mm512_cmpneq_epi8_mask(__m512i __a, __m512i __b)
+{
+  return (__mmask64)__builtin_ia32_cmpb512_mask((__v64qi)__a, (__v64qi)__b, 4, (__mmask64)-1);
+}
+static __inline__ __mmask64 __DEFAULT_FN_ATTRS512BW
+_mm512_mask_cmpneq_epi8_mask(__mmask64 __u, __m512i __a, __m512i __b)
+{
+  return (__mmask64)__builtin_ia32_cmpb512_mask((__v64qi)__a, (__v64qi)__b, 4, __u);
+}
+static __inline__ __mmask64 __DEFAULT_FN_ATTRS512BW
+_mm512_test_epi8_mask(__m512i __a, __m512i __b)
+{
+  return _mm512_cmpneq_epi8_mask(_mm512_and_si512(__a, __b), _mm512_setzero_si512());
+}
+static __inline__ __mmask64 __DEFAULT_FN_ATTRS512BW
+_mm512_testn_epi8_mask(__m512i __a, __m512i __b)
+{
+  return _mm512_cmpeq_epi8_mask(_mm512_and_si512(__a, __b), _mm512_setzero_si512());
+}
+static __inline__ __mmask64 __DEFAULT_FN_ATTRS512BW
+_mm512_movepi8_mask(__m512i __a)
+{
+  return (__mmask64)__builtin_ia32_cvtb2mask512((__v64qi)__a);
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512BW
+_mm512_mask_blend_epi8(__mmask64 __u, __m512i __a, __m512i __w)
+{
+#ifdef __clang__
+  return (__m512i)__builtin_ia32_selectb_512((__mmask64)__u, (__v64qi)__w, (__v64qi)__a);
+#else
+  return (__m512i)__builtin_ia32_blendmb_512_mask((__v64qi)__a, (__v64qi)__w, (__mmask64)__u);
+#endif
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512BW
+_mm512_shuffle_epi8(__m512i __a, __m512i __b)
+{
+#ifdef __clang__
+  return (__m512i)__builtin_ia32_pshufb512((__v64qi)__a, (__v64qi)__b);
+#else
+  return (__m512i)__builtin_ia32_pshufb512_mask((__v64qi)__a, (__v64qi)__b, (__v64qi)_mm512_setzero_si512(), (__mmask64)-1);
+#endif
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512BW
+_mm512_srli_epi16(__m512i __a, unsigned int __b)
+{
+  return (__m512i)((__v32hu)__a >> __b);
+}
+static __inline__ __m512i __DEFAULT_FN_ATTRS512BW
+_mm512_maskz_loadu_epi8(__mmask64 __u, void const *__p)
+{
+  return (__m512i)__builtin_ia32_loaddquqi512_mask((const char *)__p, (__v64qi)_mm512_setzero_si512(), (__mmask64)__u);
+}
+static __inline__ void __DEFAULT_FN_ATTRS512BW
+_mm512_mask_storeu_epi8(void *__p, __mmask64 __u, __m512i __a)
+{
+  __builtin_ia32_storedquqi512_mask((char *)__p, (__v64qi)__a, (__mmask64)__u);
+}
+#undef __DEFAULT_FN_ATTRS512BW
+#undef __DEFAULT_FN_ATTRS512
 #define _xgetbv(A) __builtin_ia32_xgetbv((long long)(A))
 #define _xsetbv(A, B) __builtin_ia32_xsetbv((unsigned int)(A), (unsigned long long)(B))
 #else
@@ -58,6 +58,8 @@ struct pthread {
 	volatile int killlock[1];
 	char *dlerror_buf;
 	void *stdio_locks;
+	void *malloc_tcache;
+	size_t malloc_sample;
 
 	/* Part 3 -- the positions of these fields relative to
 	 * the end of the structure is external and internal ABI. */
@@ -145,6 +147,7 @@ hidden void __reset_tls();
 
 hidden void __membarrier_init(void);
 hidden void __dl_thread_cleanup(void);
+hidden void __malloc_flush_tcache(void);
 hidden void __testcancel();
 hidden void __do_cleanup_push(struct __ptcb *);
 hidden void __do_cleanup_pop(struct __ptcb *);
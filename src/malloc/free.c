@@ -1,6 +1,15 @@
 #include <stdlib.h>
+#include "dynlink.h"
 
 void free(void *p)
 {
 	__libc_free(p);
 }
+
+/* The libc free is only linked when it, and so the libc allocator, is
+ * in use. A static program that replaces malloc gets the fallbacks in
+ * free_sized.c and free_aligned_sized.c instead. */
+void __malloc_free_sized(void *p, size_t n, size_t align)
+{
+	__libc_free_sized(p, n, align);
+}
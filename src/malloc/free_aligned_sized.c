@@ -0,0 +1,14 @@
+#include <stdlib.h>
+#include "dynlink.h"
+
+static void plain_free(void *p, size_t n, size_t align)
+{
+	free(p);
+}
+weak_alias(plain_free, __malloc_free_sized);
+
+void free_aligned_sized(void *p, size_t align, size_t n)
+{
+	if (__malloc_replaced) free(p);
+	else __malloc_free_sized(p, n, align);
+}
@@ -19,19 +19,23 @@ void *aligned_alloc(size_t align, size_t len)
 		return 0;
 	}
 
-	if (align <= UNIT) align = UNIT;
+	// every slot is aligned to UNIT already
+	if (align <= UNIT) return malloc(len);
 
 	unsigned char *p = malloc(len + align - UNIT);
 	if (!p)
 		return 0;
 
-	struct meta *g = get_meta(p);
+	struct meta *g = get_fresh_meta(p);
 	int idx = get_slot_index(p);
 	size_t stride = get_stride(g);
 	unsigned char *start = g->mem->storage + stride*idx;
 	unsigned char *end = g->mem->storage + stride*(idx+1) - IB;
 	size_t adj = -(uintptr_t)p & (align-1);
 
+	// a sample taken by malloc belongs to the adjusted pointer
+	if (ctx.prof_rate) prof_move(p, p+adj, len);
+
 	if (!adj) {
 		set_size(p, end, len);
 		return p;
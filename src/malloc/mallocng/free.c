@@ -1,16 +1,68 @@
 #define _BSD_SOURCE
 #include <stdlib.h>
 #include <sys/mman.h>
+#include <time.h>
 
 #include "meta.h"
 
-struct mapinfo {
-	void *base;
-	size_t len;
-};
-
 static struct mapinfo nontrivial_free(struct meta *, int);
 
+// keeps a freed huge mapping for reuse, and returns what to unmap
+// instead: the mapping itself if too big, or the oldest one cached.
+static struct mapinfo cache_huge(struct mapinfo mi)
+{
+	if (mi.len > HUGE_CACHE_MAX) return mi;
+	struct mapinfo old = { 0 };
+	if (ctx.huge_cached == HUGE_CACHE) {
+		old = ctx.huge_cache[0];
+		ctx.huge_cached--;
+		for (int i=0; i<ctx.huge_cached; i++)
+			ctx.huge_cache[i] = ctx.huge_cache[i+1];
+	}
+	ctx.huge_cache[ctx.huge_cached++] = mi;
+	return old;
+}
+
+static uint64_t now_ms()
+{
+	struct timespec ts;
+	__clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000ULL + ts.tv_nsec/1000000;
+}
+
+// parks a freed group's mapping for reuse, and returns what to unmap
+// instead: the mapping itself if too big, or the oldest one parked.
+static struct mapinfo retire(struct mapinfo mi)
+{
+	if (mi.len > RETIRE_LEN_MAX) return mi;
+	struct mapinfo old = { 0 };
+	if (ctx.retired_count == RETIRE_MAX) {
+		old = ctx.retired[0].mi;
+		ctx.retired_count--;
+		for (int i=0; i<ctx.retired_count; i++)
+			ctx.retired[i] = ctx.retired[i+1];
+	}
+	ctx.retired[ctx.retired_count++] = (struct retired){ mi, now_ms() };
+	return old;
+}
+
+// called with the lock held; takes up to max parked mappings, oldest
+// first, that have decayed or all of them if all is set.
+int expire_retired(struct mapinfo *mi, int max, int all)
+{
+	uint64_t now = all ? 0 : now_ms();
+	int n = 0;
+	while (n < max && n < ctx.retired_count
+	       && (all || now - ctx.retired[n].time >= ctx.decay)) {
+		mi[n] = ctx.retired[n].mi;
+		n++;
+	}
+	ctx.retired_count -= n;
+	for (int i=0; i<ctx.retired_count; i++)
+		ctx.retired[i] = ctx.retired[n+i];
+	return n;
+}
+
 static struct mapinfo free_group(struct meta *g)
 {
 	struct mapinfo mi = { 0 };
@@ -23,6 +75,8 @@ static struct mapinfo free_group(struct meta *g)
 		record_seq(sc);
 		mi.base = g->mem;
 		mi.len = g->maplen*4096UL;
+		if (g->huge) mi = cache_huge(mi);
+		else if (ctx.decay) mi = retire(mi);
 	} else {
 		void *p = g->mem;
 		struct meta *m = get_meta(p);
@@ -98,17 +152,154 @@ static struct mapinfo nontrivial_free(struct meta *g, int i)
 	return (struct mapinfo){ 0 };
 }
 
-void free(void *p)
+// atomic free without locking if this is neither first or last slot
+static int free_unlocked(struct meta *g, int idx)
+{
+	uint32_t self = 1u<<idx, all = (2u<<g->last_idx)-1;
+	for (;;) {
+		uint32_t freed = g->freed_mask;
+		uint32_t avail = g->avail_mask;
+		uint32_t mask = freed | avail;
+		assert(!(mask&self));
+		if (!freed || mask+self==all) return 0;
+		if (!MT)
+			g->freed_mask = freed+self;
+		else if (a_cas(&g->freed_mask, freed, freed+self)!=freed)
+			continue;
+		return 1;
+	}
+}
+
+static void push_pending(struct meta *g)
+{
+	struct meta *head;
+	do g->pending_next = head = ctx.pending;
+	while (a_cas_p(&ctx.pending, head, g) != head);
+}
+
+// lock-free stand-in for nontrivial_free while the lock is busy.
+static void defer_free(struct meta *g, int idx)
+{
+	uint32_t self = 1u<<idx;
+	int mask;
+	do mask = g->pending_mask;
+	while (a_cas(&g->pending_mask, mask, mask|self) != mask);
+	if (!mask) push_pending(g);
+	a_inc(&ctx.deferred_frees);
+}
+
+// called with the lock held. at most max released groups are handed
+// back for unmapping after unlock; groups past that are requeued.
+int drain_deferred(struct mapinfo *mi, int max)
+{
+	struct meta *g, *next;
+	int nmap = 0;
+	do g = ctx.pending;
+	while (g && a_cas_p(&ctx.pending, g, 0) != g);
+	for (; g; g = next) {
+		// a defer_free seeing the mask cleared below relinks g
+		next = g->pending_next;
+		if (nmap == max) {
+			push_pending(g);
+			continue;
+		}
+		uint32_t mask = a_swap(&g->pending_mask, 0);
+		while (mask) {
+			int idx = a_ctz_32(mask);
+			mask &= mask-1;
+			if (free_unlocked(g, idx)) continue;
+			// only the last slot can release g, so at most
+			// one mapping per group
+			mi[nmap] = nontrivial_free(g, idx);
+			if (mi[nmap].len) nmap++;
+		}
+	}
+	return nmap;
+}
+
+// return the oldest cached slots of class sc to their groups,
+// keeping the newest keep of them. the lock is tried once, at the
+// first slot that needs it, and those slots are deferred if busy.
+static void drain_tcache(struct tcache *tc, int sc, int keep)
+{
+	struct mapinfo mi[TCACHE_CAP+DRAIN_MAPS];
+	int cnt = tc->count[sc] - keep, nmap = 0, locked = -1;
+	for (int i=0; i<cnt; i++) {
+		struct meta *g = tc->meta[sc][i];
+		int idx = tc->idx[sc][i];
+		if (free_unlocked(g, idx)) continue;
+		if (locked < 0) locked = trywrlock();
+		if (!locked) {
+			defer_free(g, idx);
+			continue;
+		}
+		mi[nmap] = nontrivial_free(g, idx);
+		if (mi[nmap].len) nmap++;
+	}
+	if (locked > 0) {
+		nmap += drain_deferred(mi+nmap, DRAIN_MAPS);
+		unlock();
+	}
+	for (int i=0; i<keep; i++) {
+		tc->meta[sc][i] = tc->meta[sc][cnt+i];
+		tc->idx[sc][i] = tc->idx[sc][cnt+i];
+	}
+	tc->count[sc] = keep;
+	unmap_groups(mi, nmap);
+}
+
+static int put_tcache(struct meta *g, int idx)
+{
+	if (!USE_TCACHE || !THREADED) return 0;
+	struct tcache *tc = *tcache_ref();
+	if (tc == TCACHE_OFF) return 0;
+	if (!tc) {
+		// the cache comes from malloc itself; keep it from
+		// looking for one meanwhile.
+		*tcache_ref() = TCACHE_OFF;
+		tc = malloc(sizeof *tc);
+		if (tc) {
+			memset(tc->count, 0, sizeof tc->count);
+			tc->ctr = 0;
+		}
+		*tcache_ref() = tc;
+		if (!tc) return 0;
+	}
+	int sc = g->sizeclass;
+	if (tc->count[sc] == TCACHE_CAP)
+		drain_tcache(tc, sc, TCACHE_CAP/2);
+	int i = tc->count[sc]++;
+	tc->meta[sc][i] = g;
+	tc->idx[sc][i] = idx;
+	return 1;
+}
+
+// called on thread exit; later frees by the thread bypass the cache.
+void flush_tcache(void)
+{
+	if (!USE_TCACHE || !THREADED) return;
+	struct tcache *tc = *tcache_ref();
+	*tcache_ref() = TCACHE_OFF;
+	if (!tc || tc == TCACHE_OFF) return;
+	for (int sc=0; sc<TCACHE_CLASSES; sc++)
+		if (tc->count[sc]) drain_tcache(tc, sc, 0);
+	free(tc);
+}
+
+// n and align are what a sized free claims the slot was allocated
+// with, or -1 and 1 for plain free.
+static void free_slot(void *p, size_t n, size_t align)
 {
 	if (!p) return;
+	if (ctx.prof_rate) prof_free(p);
 
 	struct meta *g = get_meta(p);
 	int idx = get_slot_index(p);
 	size_t stride = get_stride(g);
 	unsigned char *start = g->mem->storage + stride*idx;
 	unsigned char *end = start + stride - IB;
-	get_nominal_size(p, end);
-	uint32_t self = 1u<<idx, all = (2u<<g->last_idx)-1;
+	size_t size = get_nominal_size(p, end);
+	if (n != -1) assert(size == n && !((uintptr_t)p & (align-1)));
 	((unsigned char *)p)[-3] = 255;
 	// invalidate offset to group header, and cycle offset of
 	// used region within slot if current offset is zero.
@@ -119,33 +310,39 @@ void free(void *p)
 	if (((uintptr_t)(start-1) ^ (uintptr_t)end) >= 2*PGSZ && g->last_idx) {
 		unsigned char *base = start + (-(uintptr_t)start & (PGSZ-1));
 		size_t len = (end-base) & -PGSZ;
-		if (len && USE_MADV_FREE) {
+		if (len && ctx.purge) {
 			int e = errno;
-			madvise(base, len, MADV_FREE);
+			madvise(base, len, ctx.purge);
 			errno = e;
 		}
 	}
 
-	// atomic free without locking if this is neither first or last slot
-	for (;;) {
-		uint32_t freed = g->freed_mask;
-		uint32_t avail = g->avail_mask;
-		uint32_t mask = freed | avail;
-		assert(!(mask&self));
-		if (!freed || mask+self==all) break;
-		if (!MT)
-			g->freed_mask = freed+self;
-		else if (a_cas(&g->freed_mask, freed, freed+self)!=freed)
-			continue;
+	if (g->sizeclass < TCACHE_CLASSES && g->last_idx && put_tcache(g, idx))
 		return;
-	}
 
-	wrlock();
-	struct mapinfo mi = nontrivial_free(g, idx);
-	unlock();
-	if (mi.len) {
-		int e = errno;
-		munmap(mi.base, mi.len);
-		errno = e;
+	if (free_unlocked(g, idx)) return;
+
+	// never wait for the lock; the next thread to take it finishes
+	// the free instead.
+	if (!trywrlock()) {
+		defer_free(g, idx);
+		return;
 	}
+	struct mapinfo mi[1+DRAIN_MAPS];
+	int nmap = 0;
+	mi[0] = nontrivial_free(g, idx);
+	if (mi[0].len) nmap++;
+	nmap += drain_deferred(mi+nmap, DRAIN_MAPS);
+	unlock();
+	unmap_groups(mi, nmap);
+}
+
+void free(void *p)
+{
+	free_slot(p, -1, 1);
+}
+
+void __libc_free_sized(void *p, size_t n, size_t align)
+{
+	free_slot(p, n, align ? align : 1);
 }
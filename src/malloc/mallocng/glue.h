@@ -2,6 +2,7 @@
 #define MALLOC_GLUE_H
 
 #include <stdint.h>
+#include <limits.h>
 #include <sys/mman.h>
 #include <pthread.h>
 #include <unistd.h>
@@ -12,6 +13,7 @@
 #include "libc.h"
 #include "lock.h"
 #include "dynlink.h"
+#include "pthread_impl.h"
 
 // use macros to appropriately namespace these.
 #define size_classes __malloc_size_classes
@@ -19,12 +21,23 @@
 #define alloc_meta __malloc_alloc_meta
 #define is_allzero __malloc_allzerop
 #define dump_heap __dump_heap
+#define flush_tcache __malloc_flush_tcache
+#define drain_deferred __malloc_drain_deferred
+#define init_options __malloc_init_options
+#define expire_retired __malloc_expire_retired
+#define collect_stats __malloc_collect_stats
+#define print_stats __malloc_print_stats
+#define prof_init __malloc_prof_init
+#define prof_interval __malloc_prof_interval
+#define prof_sample __malloc_prof_sample
+#define prof_free __malloc_prof_free
+#define prof_move __malloc_prof_move
 
 #define malloc __libc_malloc_impl
 #define realloc __libc_realloc
 #define free __libc_free
 
-#define USE_MADV_FREE 0
+#define USE_TCACHE 1
 
 #if USE_REAL_ASSERT
 #include <assert.h>
@@ -56,22 +69,51 @@ static inline uint64_t get_random_secret()
 
 #define MT (libc.need_locks)
 
+// the thread pointer can be used for per-thread caches once any
+// thread was created; single-threaded programs never need them.
+#define THREADED (libc.threaded)
+
+static inline void **tcache_ref()
+{
+	return &__pthread_self()->malloc_tcache;
+}
+
+// bytes the thread may still allocate before its next profile sample
+static inline size_t *sample_ref()
+{
+	return &__pthread_self()->malloc_sample;
+}
+
 #define RDLOCK_IS_EXCLUSIVE 1
 
 __attribute__((__visibility__("hidden")))
 extern int __malloc_lock[1];
 
+// times a thread found the lock held and had to wait for it
+__attribute__((__visibility__("hidden")))
+extern size_t __malloc_lock_waits;
+
 #define LOCK_OBJ_DEF \
 int __malloc_lock[1]; \
+size_t __malloc_lock_waits; \
 void __malloc_atfork(int who) { malloc_atfork(who); }
 
+// takes the lock only if that needs no waiting, using the same
+// encoding as __lock's uncontended path.
+static inline int trywrlock()
+{
+	return !MT || !a_cas(__malloc_lock, 0, INT_MIN+1);
+}
 static inline void rdlock()
 {
-	if (MT) LOCK(__malloc_lock);
+	if (!trywrlock()) {
+		LOCK(__malloc_lock);
+		__malloc_lock_waits++;
+	}
 }
 static inline void wrlock()
 {
-	if (MT) LOCK(__malloc_lock);
+	rdlock();
 }
 static inline void unlock()
 {
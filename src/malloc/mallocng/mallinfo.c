@@ -0,0 +1,20 @@
+#include <malloc.h>
+#include "meta.h"
+
+struct mallinfo2 mallinfo2(void)
+{
+	struct heap_stats st;
+	size_t nfree = 0;
+	collect_stats(&st);
+	for (int sc=0; sc<48; sc++)
+		nfree += st.cls[sc].free;
+	return (struct mallinfo2){
+		.arena = st.group_bytes,
+		.ordblks = nfree,
+		.hblks = st.mmap_count,
+		.hblkhd = st.mmap_bytes,
+		.uordblks = st.used_bytes,
+		.fordblks = st.free_bytes,
+		.keepcost = st.parked_bytes + st.cached_bytes,
+	};
+}
@@ -1,3 +1,4 @@
+#define _BSD_SOURCE
 #include <stdlib.h>
 #include <stdint.h>
 #include <limits.h>
@@ -39,6 +40,88 @@ static const uint8_t med_cnt_tab[4] = { 28, 24, 20, 32 };
 
 struct malloc_context ctx = { 0 };
 
+static int opt_is(const char *s, size_t n, const char *name)
+{
+	return n == strlen(name) && !memcmp(s, name, n);
+}
+
+static void dump_at_exit(void)
+{
+	dump_heap(2);
+}
+
+static unsigned opt_num(const char *s, size_t n)
+{
+	unsigned v = 0;
+	for (; n && *s-'0' < 10U; s++, n--)
+		v = v < UINT_MAX/10 ? 10*v + *s-'0' : UINT_MAX;
+	return v;
+}
+
+/*
+ * MUSL_MALLOC is a comma separated list of options:
+ *   hugepage    back allocations of HUGE_SIZE or more with transparent
+ *               huge pages
+ *   hugetlb     the same, but take pages from the hugetlbfs pool while
+ *               it lasts
+ *   purge=free|dontneed|none
+ *               how whole pages inside freed large slots are returned
+ *               to the kernel; none, the default, keeps them
+ *   decay=<ms>  keep freed mappings for reuse for that long before
+ *               unmapping them; see RETIRE_MAX
+ *   stats       write the malloc_info report to stderr at exit
+ *   profile=<bytes>
+ *               sample an allocation about every that many bytes for
+ *               the heap profiler, which writes its profile at exit
+ *   profile_prefix=<path>
+ *               where profiles go, as <path>.<pid>.<seq>.heap; the
+ *               default is musl-heap in the working directory
+ *   profile_signal=<signo>
+ *               also write a profile whenever that signal arrives
+ *   profile_frames
+ *               follow frame pointers for profile backtraces past the
+ *               caller of malloc; only for programs built with them,
+ *               and only on i386, x86_64 and aarch64
+ */
+void init_options(char **envp)
+{
+	const char *s = 0, *prefix = 0;
+	size_t rate = 0, prefix_len = 0;
+	int signo = 0, frames = 0;
+	for (; *envp; envp++)
+		if (!strncmp(*envp, "MUSL_MALLOC=", 12))
+			s = *envp + 12;
+	if (!s) return;
+	while (*s) {
+		size_t n = strcspn(s, ",");
+		if (opt_is(s, n, "hugepage"))
+			ctx.huge = HUGE_THP;
+		else if (opt_is(s, n, "hugetlb"))
+			ctx.huge = HUGE_TLB;
+		else if (opt_is(s, n, "purge=free"))
+			ctx.purge = MADV_FREE;
+		else if (opt_is(s, n, "purge=dontneed"))
+			ctx.purge = MADV_DONTNEED;
+		else if (opt_is(s, n, "purge=none"))
+			ctx.purge = 0;
+		else if (n > 6 && !memcmp(s, "decay=", 6))
+			ctx.decay = opt_num(s+6, n-6);
+		else if (opt_is(s, n, "stats"))
+			atexit(dump_at_exit);
+		else if (n > 8 && !memcmp(s, "profile=", 8))
+			rate = opt_num(s+8, n-8);
+		else if (n > 15 && !memcmp(s, "profile_prefix=", 15))
+			prefix = s+15, prefix_len = n-15;
+		else if (n > 15 && !memcmp(s, "profile_signal=", 15))
+			signo = opt_num(s+15, n-15);
+		else if (opt_is(s, n, "profile_frames"))
+			frames = 1;
+		s += n;
+		if (*s) s++;
+	}
+	if (rate) prof_init(rate, prefix, prefix_len, signo, frames);
+}
+
 struct meta *alloc_meta(void)
 {
 	struct meta *m;
@@ -171,6 +254,31 @@ static uint32_t try_avail(struct meta **pm)
 
 static int alloc_slot(int, size_t);
 
+// a group in reused memory needs the check bytes at its slot
+// boundaries cleared, which a fresh mapping has zero.
+static void clear_bounds(struct meta *g)
+{
+	size_t stride = get_stride(g);
+	unsigned char *b = g->mem->storage - IB;
+	for (int i=0; i<=g->last_idx+1; i++)
+		b[i*stride] = 0;
+}
+
+// called with the lock held; takes the newest parked mapping of
+// exactly len bytes, which still holds what its last group left.
+static void *take_retired(size_t len)
+{
+	for (int i=ctx.retired_count-1; i>=0; i--) {
+		if (ctx.retired[i].mi.len != len) continue;
+		void *p = ctx.retired[i].mi.base;
+		ctx.retired_count--;
+		for (; i<ctx.retired_count; i++)
+			ctx.retired[i] = ctx.retired[i+1];
+		return p;
+	}
+	return 0;
+}
+
 static struct meta *alloc_group(int sc, size_t req)
 {
 	size_t size = UNIT*size_classes[sc];
@@ -246,10 +354,15 @@ static struct meta *alloc_group(int sc, size_t req)
 			}
 		}
 
-		p = mmap(0, needed, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
-		if (p==MAP_FAILED) {
-			free_meta(m);
-			return 0;
+		m->dirty = 0;
+		if ((p = take_retired(needed))) {
+			m->dirty = 1;
+		} else {
+			p = mmap(0, needed, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+			if (p==MAP_FAILED) {
+				free_meta(m);
+				return 0;
+			}
 		}
 		m->maplen = needed>>12;
 		ctx.mmap_counter++;
@@ -266,6 +379,7 @@ static struct meta *alloc_group(int sc, size_t req)
 		struct meta *g = ctx.active[j];
 		p = enframe(g, idx, UNIT*size_classes[j]-IB, ctx.mmap_counter);
 		m->maplen = 0;
+		m->dirty = 0;
 		p[-3] = (p[-3]&31) | (6<<5);
 		for (int i=0; i<=cnt; i++)
 			p[UNIT+i*size-4] = 0;
@@ -280,6 +394,7 @@ static struct meta *alloc_group(int sc, size_t req)
 	m->last_idx = cnt-1;
 	m->freeable = 1;
 	m->sizeclass = sc;
+	if (m->dirty) clear_bounds(m);
 	return m;
 }
 
@@ -296,45 +411,147 @@ static int alloc_slot(int sc, size_t req)
 	return 0;
 }
 
-void *malloc(size_t n)
+// hand the slots already activated in g, beyond the one being
+// allocated, to the thread's cache so the next few allocations of
+// its class don't need the lock.
+static void fill_tcache(struct tcache *tc, struct meta *g, int ctr)
+{
+	int sc = g->sizeclass;
+	uint32_t mask = g->avail_mask;
+	tc->ctr = ctr;
+	while (mask && tc->count[sc] < TCACHE_CAP/2) {
+		uint32_t first = mask&-mask;
+		int i = tc->count[sc]++;
+		tc->meta[sc][i] = g;
+		tc->idx[sc][i] = a_ctz_32(first);
+		mask -= first;
+	}
+	g->avail_mask = mask;
+}
+
+// len is a multiple of HUGE_SIZE. hugetlb mappings are aligned by the
+// kernel; otherwise map a bit more and trim to an aligned range so that
+// khugepaged can collapse every part of it.
+static void *map_huge(size_t len)
+{
+	unsigned char *p;
+	if (ctx.huge == HUGE_TLB) {
+		p = mmap(0, len, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANON|MAP_HUGETLB|MAP_HUGE_2MB, -1, 0);
+		if (p != MAP_FAILED) return p;
+	}
+	size_t extra = HUGE_SIZE - PGSZ;
+	p = mmap(0, len + extra, PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANON, -1, 0);
+	if (p == MAP_FAILED) return 0;
+	size_t head = -(uintptr_t)p & (HUGE_SIZE-1);
+	if (head) munmap(p, head);
+	if (head < extra) munmap(p + head + len, extra - head);
+	p += head;
+	int e = errno;
+	madvise(p, len, MADV_HUGEPAGE);
+	errno = e;
+	return p;
+}
+
+static void *reuse_huge(size_t len)
+{
+	void *p = 0;
+	wrlock();
+	for (int i=0; i<ctx.huge_cached; i++) {
+		if (ctx.huge_cache[i].len != len) continue;
+		p = ctx.huge_cache[i].base;
+		ctx.huge_cached--;
+		for (; i<ctx.huge_cached; i++)
+			ctx.huge_cache[i] = ctx.huge_cache[i+1];
+		break;
+	}
+	unlock();
+	return p;
+}
+
+// a slot in a mapping of its own, which realloc can resize in place
+static void *alloc_mapped(size_t n)
+{
+	size_t needed = n + IB + UNIT;
+	void *p = 0;
+	struct mapinfo mi[DRAIN_MAPS];
+	int nmap = 0, dirty = 0;
+	int huge = ctx.huge && needed >= HUGE_SIZE
+		&& needed <= SIZE_MAX/2;
+	if (huge) {
+		size_t len = (needed + HUGE_SIZE-1) & -HUGE_SIZE;
+		if (!(p = reuse_huge(len)))
+			p = map_huge(len);
+		if (p) needed = len;
+		else huge = 0;
+	}
+	if (!p && ctx.retired_count && needed <= RETIRE_LEN_MAX) {
+		wrlock();
+		dirty = !!(p = take_retired((needed+4095) & -4096));
+		unlock();
+	}
+	if (!p) {
+		p = mmap(0, needed, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANON, -1, 0);
+		if (p==MAP_FAILED) return 0;
+	}
+	wrlock();
+	step_seq();
+	// this is an allocation slow path too
+	if (ctx.retired_count)
+		nmap = expire_retired(mi, DRAIN_MAPS, 0);
+	struct meta *g = alloc_meta();
+	if (!g) {
+		unlock();
+		unmap_groups(mi, nmap);
+		munmap(p, needed);
+		return 0;
+	}
+	g->mem = p;
+	g->mem->meta = g;
+	g->last_idx = 0;
+	g->freeable = 1;
+	g->sizeclass = 63;
+	g->maplen = (needed+4095)/4096;
+	g->huge = huge;
+	g->dirty = dirty;
+	if (dirty) clear_bounds(g);
+	g->avail_mask = g->freed_mask = 0;
+	// use a global counter to cycle offset in
+	// individually-mmapped allocations.
+	int ctr = ++ctx.mmap_counter;
+	unlock();
+	unmap_groups(mi, nmap);
+	return enframe(g, 0, n, ctr);
+}
+
+static __attribute__((__noinline__)) void *do_malloc(size_t n)
 {
 	if (size_overflows(n)) return 0;
 	struct meta *g;
+	struct tcache *tc = 0;
+	struct mapinfo mi[2*DRAIN_MAPS];
+	int nmap = 0;
 	uint32_t mask, first;
 	int sc;
 	int idx;
 	int ctr;
 
-	if (n >= MMAP_THRESHOLD) {
-		size_t needed = n + IB + UNIT;
-		void *p = mmap(0, needed, PROT_READ|PROT_WRITE,
-			MAP_PRIVATE|MAP_ANON, -1, 0);
-		if (p==MAP_FAILED) return 0;
-		wrlock();
-		step_seq();
-		g = alloc_meta();
-		if (!g) {
-			unlock();
-			munmap(p, needed);
-			return 0;
-		}
-		g->mem = p;
-		g->mem->meta = g;
-		g->last_idx = 0;
-		g->freeable = 1;
-		g->sizeclass = 63;
-		g->maplen = (needed+4095)/4096;
-		g->avail_mask = g->freed_mask = 0;
-		// use a global counter to cycle offset in
-		// individually-mmapped allocations.
-		ctx.mmap_counter++;
-		idx = 0;
-		goto success;
-	}
+	if (n >= MMAP_THRESHOLD) return alloc_mapped(n);
 
 	sc = size_to_class(n);
 
+	if (sc < TCACHE_CLASSES && (tc = get_tcache()) && tc->count[sc]) {
+		int i = --tc->count[sc];
+		return enframe(tc->meta[sc][i], tc->idx[sc][i], n, tc->ctr);
+	}
+
 	rdlock();
+	// finish frees deferred while the lock was busy first, so that
+	// their slots can serve this allocation.
+	if (RDLOCK_IS_EXCLUSIVE && ctx.pending)
+		nmap = drain_deferred(mi, DRAIN_MAPS);
 	g = ctx.active[sc];
 
 	// use coarse size classes initially when there are not yet
@@ -366,22 +583,53 @@ void *malloc(size_t n)
 	}
 	upgradelock();
 
+	// the slow path may have to map a group anyway, so it is where
+	// decayed mappings are unmapped rather than in free.
+	if (ctx.retired_count)
+		nmap += expire_retired(mi+nmap, DRAIN_MAPS, 0);
+
 	idx = alloc_slot(sc, n);
 	if (idx < 0) {
 		unlock();
+		unmap_groups(mi, nmap);
 		return 0;
 	}
 	g = ctx.active[sc];
 
 success:
 	ctr = ctx.mmap_counter;
+	// avail_mask can only be taken in bulk under an exclusive lock
+	if (tc && RDLOCK_IS_EXCLUSIVE) fill_tcache(tc, g, ctr);
 	unlock();
+	unmap_groups(mi, nmap);
 	return enframe(g, idx, n, ctr);
 }
 
+// out of line so that, since malloc reaches it by a tail call, its
+// return address and frame record are the ones of the caller of
+// malloc. prof_sample walks the stack from there.
+static __attribute__((__noinline__)) void *sampled_malloc(size_t n)
+{
+	void *p = do_malloc(n);
+	size_t *left = sample_ref();
+	if (!p) return 0;
+	// the count only reaches 0 before the thread's first interval
+	if (!*left) *left = prof_interval();
+	if (n < *left) *left -= n;
+	else prof_sample(p, n, __builtin_return_address(0), __builtin_frame_address(0));
+	return p;
+}
+
+void *malloc(size_t n)
+{
+	if (ctx.prof_rate) return sampled_malloc(n);
+	return do_malloc(n);
+}
+
 int is_allzero(void *p)
 {
 	struct meta *g = get_meta(p);
-	return g->sizeclass >= 48 ||
-		get_stride(g) < UNIT*size_classes[g->sizeclass];
+	// cached huge and parked mappings come back dirty
+	return !g->dirty && ((g->sizeclass >= 48 && !g->huge) ||
+		get_stride(g) < UNIT*size_classes[g->sizeclass]);
 }
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <malloc.h>
+#include <errno.h>
+#include "meta.h"
+
+/*
+ * Arenas hand out memory by bumping a pointer through chunks that are
+ * ordinary slots of the heap, and give it all back at once. A chunk is
+ * grown to the whole slot malloc picked for it, and destroying the
+ * arena frees its chunks back into their groups. Chunk sizes double
+ * from ARENA_MIN up to ARENA_MAX; requests over a quarter of the
+ * current chunk size get a chunk to themselves so as not to waste the
+ * rest of the current one.
+ *
+ * An arena is not locked; each one must only be used by one thread at
+ * a time. Memory from an arena must not be passed to free or realloc.
+ */
+
+#define ARENA_MIN 4096
+#define ARENA_MAX 65536
+
+// chunk header, a whole unit to keep the memory after it aligned
+struct chunk {
+	struct chunk *next;
+	char pad[UNIT - sizeof(struct chunk *)];
+};
+
+struct malloc_arena {
+	unsigned char *cur, *end;
+	struct chunk *chunks;
+	size_t size;
+};
+
+// links a chunk of at least len bytes into a and returns its memory,
+// with *end set to the end of the slot it got.
+static unsigned char *add_chunk(struct malloc_arena *a, size_t len, unsigned char **end)
+{
+	struct chunk *c = malloc(sizeof *c + len);
+	if (!c) return 0;
+	unsigned char *p = (void *)c;
+	struct meta *g = get_fresh_meta(p);
+	int idx = get_slot_index(p);
+	size_t stride = get_stride(g);
+	*end = g->mem->storage + stride*(idx+1) - IB;
+	set_size(p, *end, *end-p);
+	c->next = a->chunks;
+	a->chunks = c;
+	return (void *)(c+1);
+}
+
+struct malloc_arena *malloc_arena_create(void)
+{
+	struct malloc_arena a = { .size = ARENA_MIN }, *p;
+	if (!(a.cur = add_chunk(&a, ARENA_MIN, &a.end))) return 0;
+	// the arena lives at the start of its first chunk
+	p = (void *)a.cur;
+	a.cur += (sizeof a + UNIT-1) & -UNIT;
+	*p = a;
+	return p;
+}
+
+void *malloc_arena_alloc(struct malloc_arena *a, size_t n)
+{
+	// len is only 0 if n overflowed
+	size_t len = n ? (n + UNIT-1) & -UNIT : UNIT;
+	unsigned char *p, *end;
+	if (len - 1 < (size_t)(a->end - a->cur)) {
+		p = a->cur;
+		a->cur += len;
+		return p;
+	}
+	if (size_overflows(n)) return 0;
+	if (len > a->size/4)
+		return add_chunk(a, len, &end);
+	if (a->size < ARENA_MAX) a->size *= 2;
+	if (!(p = add_chunk(a, a->size, &end))) return 0;
+	a->cur = p + len;
+	a->end = end;
+	return p;
+}
+
+void malloc_arena_destroy(struct malloc_arena *a)
+{
+	// the first chunk, which holds the arena, is last in the list
+	for (struct chunk *c = a->chunks, *next; c; c = next) {
+		next = c->next;
+		free(c);
+	}
+}
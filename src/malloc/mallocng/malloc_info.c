@@ -0,0 +1,21 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <errno.h>
+#include "meta.h"
+
+static void out_file(void *f, const char *s, size_t n)
+{
+	fwrite(s, 1, n, f);
+}
+
+int malloc_info(int options, FILE *f)
+{
+	struct heap_stats st;
+	if (options) {
+		errno = EINVAL;
+		return -1;
+	}
+	collect_stats(&st);
+	print_stats(&st, out_file, f);
+	return 0;
+}
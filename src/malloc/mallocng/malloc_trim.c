@@ -0,0 +1,25 @@
+#include <malloc.h>
+#include "meta.h"
+
+// finishes the frees deferred while the lock was busy, and unmaps what
+// they release, what decay has parked and the cached huge mappings
+// now. there is no heap top in mallocng, so pad is only taken for
+// compatibility.
+int malloc_trim(size_t pad)
+{
+	struct mapinfo mi[DRAIN_MAPS+RETIRE_MAX+HUGE_CACHE];
+	int n, drained, total = 0;
+	do {
+		wrlock();
+		// a full batch means groups were left on ctx.pending
+		n = drained = drain_deferred(mi, DRAIN_MAPS);
+		n += expire_retired(mi+n, RETIRE_MAX, 1);
+		for (int i=0; i<ctx.huge_cached; i++)
+			mi[n++] = ctx.huge_cache[i];
+		ctx.huge_cached = 0;
+		unlock();
+		unmap_groups(mi, n);
+		total += n;
+	} while (drained == DRAIN_MAPS);
+	return total > 0;
+}
@@ -25,6 +25,13 @@ struct meta {
 	struct meta *prev, *next;
 	struct group *mem;
 	volatile int avail_mask, freed_mask;
+	// slots freed while the lock was busy, not yet in freed_mask
+	volatile int pending_mask;
+	// mapped 2MiB-aligned by map_huge; unmapped via the huge cache
+	unsigned char huge;
+	// mapped memory reused from a parked mapping, not zeroed
+	unsigned char dirty;
+	struct meta *pending_next;
 	uintptr_t last_idx:5;
 	uintptr_t freeable:1;
 	uintptr_t sizeclass:6;
@@ -38,6 +45,35 @@ struct meta_area {
 	struct meta slots[];
 };
 
+struct mapinfo {
+	void *base;
+	size_t len;
+};
+
+// with MUSL_MALLOC=hugepage or hugetlb, mmapped allocations of at
+// least HUGE_SIZE are rounded to and aligned on HUGE_SIZE, and kept
+// in a small cache when freed, for reuse by requests of equal size.
+#define HUGE_SIZE (2UL<<20)
+#define HUGE_THP 1
+#define HUGE_TLB 2
+#define HUGE_CACHE 8
+#define HUGE_CACHE_MAX (16*HUGE_SIZE)
+
+// with MUSL_MALLOC=decay=<ms>, freed mappings of up to RETIRE_LEN_MAX
+// are parked instead of unmapped, and reused by the next group or
+// mapped slot that needs the same length. the allocation slow path
+// unmaps the ones parked for longer, and malloc_trim all of them;
+// free only unmaps a parked mapping to make room when RETIRE_MAX are
+// parked already. nothing runs in the background, so an idle program
+// keeps up to RETIRE_MAX*RETIRE_LEN_MAX bytes parked until malloc_trim.
+#define RETIRE_MAX 32
+#define RETIRE_LEN_MAX (1UL<<20)
+
+struct retired {
+	struct mapinfo mi;
+	uint64_t time;
+};
+
 struct malloc_context {
 	uint64_t secret;
 #ifndef PAGESIZE
@@ -51,15 +87,48 @@ struct malloc_context {
 	struct meta_area *meta_area_head, *meta_area_tail;
 	unsigned char *avail_meta_areas;
 	struct meta *active[48];
+	struct meta *volatile pending;
 	size_t usage_by_class[48];
 	uint8_t unmap_seq[32], bounces[32];
 	uint8_t seq;
 	uintptr_t brk;
+	unsigned char huge;
+	int huge_cached;
+	struct mapinfo huge_cache[HUGE_CACHE];
+	int purge;
+	unsigned decay;
+	int retired_count;
+	struct retired retired[RETIRE_MAX];
+	// frees left to the next lock holder by defer_free
+	volatile int deferred_frees;
+	// mean bytes between heap profile samples, 0 if not profiling
+	size_t prof_rate;
 };
 
 __attribute__((__visibility__("hidden")))
 extern struct malloc_context ctx;
 
+// per-thread stacks of free slots for the small size classes, so
+// that most malloc/free pairs touch neither the lock nor ctx.
+// cached slots are freed in the slot header but still allocated
+// as far as their group is concerned.
+#define TCACHE_CLASSES 24
+#define TCACHE_CAP 16
+#define TCACHE_OFF ((struct tcache *)-1)
+
+struct tcache {
+	unsigned char count[TCACHE_CLASSES];
+	unsigned char idx[TCACHE_CLASSES][TCACHE_CAP];
+	int ctr;
+	struct meta *meta[TCACHE_CLASSES][TCACHE_CAP];
+};
+
+// a free that needs the lock while another thread holds it only sets
+// its bit in the group's pending_mask, pushing the group onto the
+// lock-free ctx.pending stack if the mask was empty. whoever takes
+// the lock next pops the whole stack and finishes those frees.
+#define DRAIN_MAPS 4
+
 #ifdef PAGESIZE
 #define PGSZ PAGESIZE
 #else
@@ -72,6 +141,52 @@ struct meta *alloc_meta(void);
 __attribute__((__visibility__("hidden")))
 int is_allzero(void *);
 
+__attribute__((__visibility__("hidden")))
+int drain_deferred(struct mapinfo *, int);
+
+__attribute__((__visibility__("hidden")))
+int expire_retired(struct mapinfo *, int, int);
+
+// a snapshot of the heap for malloc_info, mallinfo2 and dump_heap.
+// slots held in per-thread caches count as live.
+struct heap_stats {
+	struct {
+		size_t groups, slots, free, pending;
+	} cls[48];
+	size_t group_bytes, mmap_count, mmap_bytes;
+	size_t used_bytes, free_bytes;
+	size_t meta_areas, metas, metas_used;
+	size_t parked_bytes, cached_bytes;
+	size_t lock_waits, deferred_frees;
+};
+
+__attribute__((__visibility__("hidden")))
+void collect_stats(struct heap_stats *);
+
+__attribute__((__visibility__("hidden")))
+void print_stats(const struct heap_stats *, void (*)(void *, const char *, size_t), void *);
+
+__attribute__((__visibility__("hidden")))
+void dump_heap(int);
+
+// sampling heap profiler, see profile.c. malloc calls prof_sample
+// once the thread has allocated ctx.prof_rate bytes since its last
+// sample; free and realloc report what happens to sampled slots.
+__attribute__((__visibility__("hidden")))
+void prof_init(size_t, const char *, size_t, int, int);
+
+__attribute__((__visibility__("hidden")))
+size_t prof_interval(void);
+
+__attribute__((__visibility__("hidden")))
+void prof_sample(void *, size_t, void *, void *);
+
+__attribute__((__visibility__("hidden")))
+void prof_free(void *);
+
+__attribute__((__visibility__("hidden")))
+void prof_move(void *, void *, size_t);
+
 static inline void queue(struct meta **phead, struct meta *m)
 {
 	assert(!m->next);
@@ -112,6 +227,15 @@ static inline void free_meta(struct meta *m)
 	queue(&ctx.free_meta_head, m);
 }
 
+static inline void unmap_groups(struct mapinfo *mi, int n)
+{
+	if (!n) return;
+	int e = errno;
+	for (int i=0; i<n; i++)
+		munmap(mi[i].base, mi[i].len);
+	errno = e;
+}
+
 static inline uint32_t activate_group(struct meta *m)
 {
 	assert(!m->avail_mask);
@@ -142,6 +266,7 @@ static inline struct meta *get_meta(const unsigned char *p)
 	assert(index <= meta->last_idx);
 	assert(!(meta->avail_mask & (1u<<index)));
 	assert(!(meta->freed_mask & (1u<<index)));
+	assert(!(meta->pending_mask & (1u<<index)));
 	const struct meta_area *area = (void *)((uintptr_t)meta & -4096);
 	assert(area->check == ctx.secret);
 	if (meta->sizeclass < 48) {
@@ -156,6 +281,15 @@ static inline struct meta *get_meta(const unsigned char *p)
 	return (struct meta *)meta;
 }
 
+// the meta of a slot that malloc just returned, which needs none of
+// the checks get_meta makes against invalid pointers. enframe always
+// stores a 16-bit offset.
+static inline struct meta *get_fresh_meta(const unsigned char *p)
+{
+	int offset = *(const uint16_t *)(p - 2);
+	return ((const struct group *)(p - UNIT*offset - UNIT))->meta;
+}
+
 static inline size_t get_nominal_size(const unsigned char *p, const unsigned char *end)
 {
 	size_t reserved = p[-3] >> 5;
@@ -237,6 +371,16 @@ static inline int size_to_class(size_t n)
 	return i;
 }
 
+static inline struct tcache *get_tcache(void)
+{
+	if (!USE_TCACHE || !THREADED) return 0;
+	struct tcache *tc = *tcache_ref();
+	return tc == TCACHE_OFF ? 0 : tc;
+}
+
+__attribute__((__visibility__("hidden")))
+void flush_tcache(void);
+
 static inline int size_overflows(size_t n)
 {
 	if (n >= SIZE_MAX/2 - 4096) {
@@ -0,0 +1,420 @@
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include "meta.h"
+
+/*
+ * Sampling heap profiler. With profile=<bytes> in MUSL_MALLOC, every
+ * thread counts down the bytes it allocates, and the allocation that
+ * uses up its count is recorded with its backtrace in a table of live
+ * samples until it is freed. The count is then reset to a random
+ * value, exponentially distributed with the rate as its mean, so that
+ * sampling is a Poisson process over the bytes allocated.
+ *
+ * Profiles are written in the text format of the gperftools heap
+ * profiler ("heap_v2"), which pprof reads and scales back up by the
+ * rate in the header, assuming exactly that distribution.
+ *
+ * A backtrace is just the caller of malloc unless profile_frames is
+ * set. Then it goes on through the frame records that frame pointers
+ * leave on i386, x86_64 and aarch64, which the program must be built
+ * with; other archs lay their frames out differently and ignore it.
+ *
+ * All state lives in one mapping made at the first sample and is
+ * guarded by a lock of its own; nothing here calls malloc.
+ */
+
+#define PROF_DEPTH 32
+#define PROF_STACKS 4096
+#define PROF_LIVE 65536
+#define PROF_FILTER 65536
+
+// frame records are { caller's frame pointer, return address }
+#if (__x86_64__ && !__ILP32__) || __i386__ || __aarch64__
+#define PROF_FRAMES 1
+#endif
+
+struct prof_stack {
+	size_t hash;
+	size_t live_count, live_bytes;
+	size_t alloc_count, alloc_bytes;
+	int depth;
+	void *pc[PROF_DEPTH];
+};
+
+struct prof_live {
+	void *p;
+	size_t size;
+	int stack;
+};
+
+static struct {
+	volatile int lock[1], dump_pending;
+	int frames, nstacks, nlive, seq;
+	uint64_t rnd;
+	const char *prefix;
+	size_t prefix_len;
+	// both tables are open addressed with linear probing and kept at
+	// most 3/4 full; samples that do not fit are dropped.
+	struct prof_stack *stacks;
+	struct prof_live *live;
+	// live samples per bucket of pointer hashes, so that free only
+	// takes the lock for pointers that may have been sampled.
+	uint16_t *volatile filter;
+} prof;
+
+static void write_profile(void);
+
+static void prof_lock(void)
+{
+	while (a_swap(prof.lock, 1)) __syscall(SYS_sched_yield);
+}
+
+static void prof_unlock(void)
+{
+	// a signal that found the lock taken left its dump to us. check
+	// only after releasing it, or one arriving in between is lost;
+	// if someone else has taken the lock by then, the dump is theirs.
+	a_store(prof.lock, 0);
+	while (prof.dump_pending && !a_swap(prof.lock, 1)) {
+		prof.dump_pending = 0;
+		write_profile();
+		a_store(prof.lock, 0);
+	}
+}
+
+static size_t ptr_hash(void *p)
+{
+	return (uint64_t)(uintptr_t)p * 0x9e3779b97f4a7c15 >> 32;
+}
+
+static int map_tables(void)
+{
+	size_t len = PROF_STACKS * sizeof(struct prof_stack)
+		+ PROF_LIVE * sizeof(struct prof_live)
+		+ PROF_FILTER * sizeof(uint16_t);
+	unsigned char *p = mmap(0, len, PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANON, -1, 0);
+	if (p == MAP_FAILED) return 0;
+	prof.stacks = (void *)p;
+	p += PROF_STACKS * sizeof(struct prof_stack);
+	prof.live = (void *)p;
+	p += PROF_LIVE * sizeof(struct prof_live);
+	prof.filter = (void *)p;
+	return 1;
+}
+
+// -ln(u)*rate for u uniform in (0,1], as tcmalloc draws it. u is
+// r/2^53 with r = m*2^e, m in [1,2), and ln(m) comes from the atanh
+// series, good to about 1e-6 for m < 2, so libm is not needed.
+static size_t next_interval(void)
+{
+	uint64_t x = prof.rnd;
+	x ^= x<<13;
+	x ^= x>>7;
+	x ^= x<<17;
+	prof.rnd = x;
+	uint64_t r = (x>>11) + 1;
+	int e = 63 - a_clz_64(r);
+	double m = (double)(r << (63-e) >> 11) * 0x1p-52;
+	double t = (m-1)/(m+1), t2 = t*t;
+	double ln_m = 2*t*(1 + t2*(1/3.0 + t2*(1/5.0 + t2*(1/7.0 + t2/9))));
+	double d = ((53-e)*0.693147180559945309 - ln_m) * ctx.prof_rate;
+	return d < SIZE_MAX/2 ? (size_t)d + 1 : SIZE_MAX/2;
+}
+
+size_t prof_interval(void)
+{
+	prof_lock();
+	size_t n = next_interval();
+	prof_unlock();
+	return n;
+}
+
+static int find_stack(void **pc, int depth)
+{
+	size_t h = depth;
+	for (int i=0; i<depth; i++)
+		h = (h ^ (uintptr_t)pc[i]) * (size_t)0x100000001b3;
+	for (size_t i=h^h>>16; ; i++) {
+		struct prof_stack *s = &prof.stacks[i & (PROF_STACKS-1)];
+		if (!s->depth) {
+			if (prof.nstacks >= PROF_STACKS/4*3) return -1;
+			prof.nstacks++;
+			s->hash = h;
+			s->depth = depth;
+			memcpy(s->pc, pc, depth * sizeof *pc);
+			return s - prof.stacks;
+		}
+		if (s->hash == h && s->depth == depth
+		    && !memcmp(s->pc, pc, depth * sizeof *pc))
+			return s - prof.stacks;
+	}
+}
+
+// the entry for p, or the empty one where it would go
+static struct prof_live *find_live(void *p)
+{
+	for (size_t i=ptr_hash(p); ; i++) {
+		struct prof_live *l = &prof.live[i & (PROF_LIVE-1)];
+		if (!l->p || l->p == p) return l;
+	}
+}
+
+static void add_live(struct prof_live *l, void *p, size_t size, int stack)
+{
+	*l = (struct prof_live){ .p = p, .size = size, .stack = stack };
+	prof.nlive++;
+	prof.filter[ptr_hash(p) & (PROF_FILTER-1)]++;
+	prof.stacks[stack].live_count++;
+	prof.stacks[stack].live_bytes += size;
+}
+
+static void remove_live(struct prof_live *l)
+{
+	size_t i = l - prof.live, j = i, k;
+	prof.nlive--;
+	prof.filter[ptr_hash(l->p) & (PROF_FILTER-1)]--;
+	prof.stacks[l->stack].live_count--;
+	prof.stacks[l->stack].live_bytes -= l->size;
+	// close the gap: move back every later entry of the run whose
+	// home bucket does not lie between the gap and the entry.
+	for (;;) {
+		j = (j+1) & (PROF_LIVE-1);
+		if (!prof.live[j].p) break;
+		k = ptr_hash(prof.live[j].p) & (PROF_LIVE-1);
+		if ((j-k & (PROF_LIVE-1)) < (j-i & (PROF_LIVE-1))) continue;
+		prof.live[i] = prof.live[j];
+		i = j;
+	}
+	prof.live[i].p = 0;
+}
+
+// ret is the return address into the caller of malloc, and frame the
+// frame record holding it.
+void prof_sample(void *p, size_t n, void *ret, void *frame)
+{
+	void *pc[PROF_DEPTH];
+	int depth = 0;
+
+	pc[depth++] = ret;
+#ifdef PROF_FRAMES
+	struct pthread *self = __pthread_self();
+	uintptr_t top = self->stack ? (uintptr_t)self->stack : (uintptr_t)libc.auxv;
+	uintptr_t *fp = frame, *next;
+	// stop at anything that does not lead up the stack
+	while (prof.frames && depth < PROF_DEPTH) {
+		next = (uintptr_t *)fp[0];
+		if (next <= fp || (uintptr_t)(next+2) > top
+		    || (uintptr_t)next % sizeof *next || !next[1])
+			break;
+		pc[depth++] = (void *)next[1];
+		fp = next;
+	}
+#endif
+
+	prof_lock();
+	*sample_ref() = next_interval();
+	if (!prof.live && !map_tables()) {
+		ctx.prof_rate = 0;
+		prof_unlock();
+		return;
+	}
+	int s = find_stack(pc, depth);
+	if (s >= 0 && prof.nlive < PROF_LIVE/4*3) {
+		struct prof_live *l = find_live(p);
+		// only if a free escaped us
+		if (l->p) {
+			remove_live(l);
+			l = find_live(p);
+		}
+		add_live(l, p, n, s);
+		prof.stacks[s].alloc_count++;
+		prof.stacks[s].alloc_bytes += n;
+	}
+	prof_unlock();
+}
+
+void prof_free(void *p)
+{
+	uint16_t *filter = prof.filter;
+	if (!filter || !filter[ptr_hash(p) & (PROF_FILTER-1)]) return;
+	prof_lock();
+	struct prof_live *l = find_live(p);
+	if (l->p) remove_live(l);
+	prof_unlock();
+}
+
+// the slot at p now starts at q and holds n bytes
+void prof_move(void *p, void *q, size_t n)
+{
+	uint16_t *filter = prof.filter;
+	if (!filter || !filter[ptr_hash(p) & (PROF_FILTER-1)]) return;
+	prof_lock();
+	struct prof_live *l = find_live(p);
+	if (l->p) {
+		int stack = l->stack;
+		remove_live(l);
+		l = find_live(q);
+		if (!l->p) add_live(l, q, n, stack);
+	}
+	prof_unlock();
+}
+
+struct out {
+	int fd;
+	size_t n;
+	char buf[4096];
+};
+
+static void flush(struct out *o)
+{
+	for (char *s = o->buf; o->n; ) {
+		ssize_t r = __syscall(SYS_write, o->fd, s, o->n);
+		if (r <= 0) break;
+		s += r;
+		o->n -= r;
+	}
+	o->n = 0;
+}
+
+static void put(struct out *o, const char *s, size_t n)
+{
+	while (n) {
+		size_t k = sizeof o->buf - o->n;
+		if (k > n) k = n;
+		memcpy(o->buf + o->n, s, k);
+		o->n += k;
+		s += k;
+		n -= k;
+		if (o->n == sizeof o->buf) flush(o);
+	}
+}
+
+static void put_str(struct out *o, const char *s)
+{
+	put(o, s, strlen(s));
+}
+
+static void put_num(struct out *o, uintptr_t v, int base)
+{
+	char buf[3*sizeof v];
+	int i = sizeof buf;
+	do buf[--i] = "0123456789abcdef"[v%base]; while (v /= base);
+	put(o, buf+i, sizeof buf - i);
+}
+
+static void put_counts(struct out *o, size_t c1, size_t b1, size_t c2, size_t b2)
+{
+	put_num(o, c1, 10);
+	put_str(o, ": ");
+	put_num(o, b1, 10);
+	put_str(o, " [");
+	put_num(o, c2, 10);
+	put_str(o, ": ");
+	put_num(o, b2, 10);
+	put_str(o, "] @");
+}
+
+/*
+ * heap profile: 12: 49152 [340: 1392640] @ heap_v2/524288
+ * 3: 12288 [80: 327680] @ 0x401a2c 0x401b10 0x4021f7
+ * ...
+ *
+ * MAPPED_LIBRARIES:
+ * <contents of /proc/self/maps>
+ */
+static void write_profile(void)
+{
+	struct out o;
+	size_t lc = 0, lb = 0, ac = 0, ab = 0;
+	int pid = __syscall(SYS_getpid);
+	size_t plen = prof.prefix_len < 200 ? prof.prefix_len : 200;
+	char path[256], *p = path;
+
+	memcpy(p, prof.prefix, plen);
+	p += plen;
+	o.n = 0;
+	put(&o, ".", 1);
+	put_num(&o, pid, 10);
+	put(&o, ".", 1);
+	put_num(&o, prof.seq++, 10);
+	put_str(&o, ".heap");
+	memcpy(p, o.buf, o.n);
+	p[o.n] = 0;
+	o.fd = __sys_open(path, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+	if (o.fd < 0) return;
+	o.n = 0;
+
+	for (int i=0; prof.stacks && i<PROF_STACKS; i++) {
+		lc += prof.stacks[i].live_count;
+		lb += prof.stacks[i].live_bytes;
+		ac += prof.stacks[i].alloc_count;
+		ab += prof.stacks[i].alloc_bytes;
+	}
+	put_str(&o, "heap profile: ");
+	put_counts(&o, lc, lb, ac, ab);
+	put_str(&o, " heap_v2/");
+	put_num(&o, ctx.prof_rate, 10);
+	put_str(&o, "\n");
+	for (int i=0; prof.stacks && i<PROF_STACKS; i++) {
+		struct prof_stack *s = &prof.stacks[i];
+		if (!s->depth) continue;
+		put_counts(&o, s->live_count, s->live_bytes,
+			s->alloc_count, s->alloc_bytes);
+		for (int j=0; j<s->depth; j++) {
+			put_str(&o, " 0x");
+			put_num(&o, (uintptr_t)s->pc[j], 16);
+		}
+		put_str(&o, "\n");
+	}
+
+	// pprof needs the mappings to symbolize the addresses
+	put_str(&o, "\nMAPPED_LIBRARIES:\n");
+	flush(&o);
+	int fd = __sys_open("/proc/self/maps", O_RDONLY|O_CLOEXEC);
+	if (fd >= 0) {
+		ssize_t r;
+		while ((r = __syscall(SYS_read, fd, o.buf, sizeof o.buf)) > 0) {
+			o.n = r;
+			flush(&o);
+		}
+		__syscall(SYS_close, fd);
+	}
+	__syscall(SYS_close, o.fd);
+}
+
+static void dump_at_exit(void)
+{
+	prof_lock();
+	write_profile();
+	prof_unlock();
+}
+
+static void dump_on_signal(int sig)
+{
+	if (a_swap(prof.lock, 1)) {
+		prof.dump_pending = 1;
+		return;
+	}
+	write_profile();
+	prof_unlock();
+}
+
+void prof_init(size_t rate, const char *prefix, size_t len, int signo, int frames)
+{
+	prof.rnd = get_random_secret() | 1;
+	prof.prefix = prefix ? prefix : "musl-heap";
+	prof.prefix_len = prefix ? len : 9;
+	prof.frames = frames;
+	ctx.prof_rate = rate;
+	atexit(dump_at_exit);
+	if (signo) {
+		struct sigaction sa = {
+			.sa_handler = dump_on_signal,
+			.sa_flags = SA_RESTART,
+		};
+		__libc_sigaction(signo, &sa, 0);
+	}
+}
@@ -22,30 +22,43 @@ void *realloc(void *p, size_t n)
 	if (n <= avail_size && n<MMAP_THRESHOLD
 	    && size_to_class(n)+1 >= g->sizeclass) {
 		set_size(p, end, n);
+		if (ctx.prof_rate) prof_move(p, p, n);
 		return p;
 	}
 
 	// use mremap if old and new size are both mmap-worthy
-	if (g->sizeclass>=48 && n>=MMAP_THRESHOLD) {
-		assert(g->sizeclass==63);
+	if (g->sizeclass==63 && n>=MMAP_THRESHOLD) {
 		size_t base = (unsigned char *)p-start;
 		size_t needed = (n + base + UNIT + IB + 4095) & -4096;
+		// huge mappings keep their size and alignment, so they
+		// are only reused while the request rounds to the same.
+		if (g->huge) {
+			if (((needed + HUGE_SIZE-1) & -HUGE_SIZE) != g->maplen*4096UL)
+				goto copy;
+			set_size(p, end, n);
+			if (ctx.prof_rate) prof_move(p, p, n);
+			return p;
+		}
 		new = g->maplen*4096UL == needed ? g->mem :
 			mremap(g->mem, g->maplen*4096UL, needed, MREMAP_MAYMOVE);
 		if (new!=MAP_FAILED) {
+			void *old = p;
 			g->mem = new;
 			g->maplen = needed/4096;
 			p = g->mem->storage + base;
 			end = g->mem->storage + (needed - UNIT) - IB;
 			*end = 0;
 			set_size(p, end, n);
+			if (ctx.prof_rate) prof_move(old, p, n);
 			return p;
 		}
 	}
 
+copy:
 	new = malloc(n);
 	if (!new) return 0;
 	memcpy(new, p, n < old_size ? n : old_size);
+	if (ctx.prof_rate) prof_move(p, new, n);
 	free(p);
 	return new;
 }
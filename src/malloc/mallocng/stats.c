@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "meta.h"
+
+static int popcount(uint32_t x)
+{
+	int n = 0;
+	for (; x; x &= x-1) n++;
+	return n;
+}
+
+void collect_stats(struct heap_stats *st)
+{
+	memset(st, 0, sizeof *st);
+	wrlock();
+	for (struct meta_area *a = ctx.meta_area_head; a; a = a->next) {
+		st->meta_areas++;
+		st->metas += a->nslots;
+		for (int i=0; i<a->nslots; i++) {
+			struct meta *g = &a->slots[i];
+			// free and not yet handed out metas are zeroed
+			if (!g->mem) continue;
+			st->metas_used++;
+			size_t stride = get_stride(g);
+			size_t len = g->maplen*4096UL;
+			if (g->sizeclass == 63) {
+				st->mmap_count++;
+				st->mmap_bytes += len;
+				st->used_bytes += stride;
+				continue;
+			}
+			int sc = g->sizeclass;
+			size_t cnt = g->last_idx+1;
+			size_t nfree = popcount(g->avail_mask | g->freed_mask);
+			size_t npend = popcount(g->pending_mask);
+			st->cls[sc].groups++;
+			st->cls[sc].slots += cnt;
+			st->cls[sc].free += nfree;
+			st->cls[sc].pending += npend;
+			st->group_bytes += len;
+			st->used_bytes += (cnt-nfree-npend)*stride;
+			st->free_bytes += nfree*stride;
+			// a nested group lives in a slot of another group,
+			// which is already counted as used. the sums are
+			// modular, so the order of the groups is irrelevant.
+			if (!g->maplen && g->freeable)
+				st->used_bytes -= cnt*stride + UNIT;
+		}
+	}
+	for (int i=0; i<ctx.retired_count; i++)
+		st->parked_bytes += ctx.retired[i].mi.len;
+	for (int i=0; i<ctx.huge_cached; i++)
+		st->cached_bytes += ctx.huge_cache[i].len;
+	st->lock_waits = __malloc_lock_waits;
+	st->deferred_frees = (unsigned)ctx.deferred_frees;
+	unlock();
+}
+
+static char *put_str(char *p, const char *s)
+{
+	while (*s) *p++ = *s++;
+	return p;
+}
+
+static char *put_num(char *p, const char *name, size_t v)
+{
+	char buf[3*sizeof v];
+	int i = sizeof buf;
+	do buf[--i] = '0' + v%10; while (v /= 10);
+	p = put_str(p, " ");
+	p = put_str(p, name);
+	p = put_str(p, "=\"");
+	memcpy(p, buf+i, sizeof buf - i);
+	p += sizeof buf - i;
+	return put_str(p, "\"");
+}
+
+/*
+ * The format follows the XML of glibc's malloc_info where it has an
+ * equivalent, so existing tooling can read the totals:
+ *
+ * <malloc version="mallocng">
+ * <size class="0" slot="16" groups="1" slots="30" free="29" pending="0"/>
+ * ...
+ * <total type="mmap" count="2" size="2105344"/>
+ * ...
+ * </malloc>
+ */
+void print_stats(const struct heap_stats *st, void (*out)(void *, const char *, size_t), void *arg)
+{
+	char line[1024], *p;
+	size_t mapped = st->group_bytes + st->mmap_bytes + 4096*st->meta_areas
+		+ st->parked_bytes + st->cached_bytes;
+	size_t total = st->used_bytes + st->free_bytes;
+
+	p = put_str(line, "<malloc version=\"mallocng\">\n");
+	out(arg, line, p-line);
+	for (int sc=0; sc<48; sc++) {
+		if (!st->cls[sc].groups) continue;
+		p = put_str(line, "<size");
+		p = put_num(p, "class", sc);
+		p = put_num(p, "slot", UNIT*size_classes[sc]);
+		p = put_num(p, "groups", st->cls[sc].groups);
+		p = put_num(p, "slots", st->cls[sc].slots);
+		p = put_num(p, "free", st->cls[sc].free);
+		p = put_num(p, "pending", st->cls[sc].pending);
+		p = put_str(p, "/>\n");
+		out(arg, line, p-line);
+	}
+	p = put_str(line, "<total type=\"groups\"");
+	p = put_num(p, "size", st->group_bytes);
+	p = put_str(p, "/>\n<total type=\"mmap\"");
+	p = put_num(p, "count", st->mmap_count);
+	p = put_num(p, "size", st->mmap_bytes);
+	p = put_str(p, "/>\n<total type=\"used\"");
+	p = put_num(p, "size", st->used_bytes);
+	p = put_str(p, "/>\n<total type=\"free\"");
+	p = put_num(p, "size", st->free_bytes);
+	p = put_str(p, "/>\n");
+	out(arg, line, p-line);
+	p = put_str(line, "<fragmentation");
+	p = put_num(p, "percent", total ? 100*st->free_bytes/total : 0);
+	p = put_str(p, "/>\n<meta");
+	p = put_num(p, "areas", st->meta_areas);
+	p = put_num(p, "slots", st->metas);
+	p = put_num(p, "used", st->metas_used);
+	p = put_str(p, "/>\n<retained");
+	p = put_num(p, "parked", st->parked_bytes);
+	p = put_num(p, "huge", st->cached_bytes);
+	p = put_str(p, "/>\n<locks");
+	p = put_num(p, "waits", st->lock_waits);
+	p = put_num(p, "deferred", st->deferred_frees);
+	p = put_str(p, "/>\n<system type=\"current\"");
+	p = put_num(p, "size", mapped);
+	p = put_str(p, "/>\n</malloc>\n");
+	out(arg, line, p-line);
+}
+
+static void out_fd(void *arg, const char *s, size_t n)
+{
+	int fd = *(int *)arg;
+	while (n) {
+		ssize_t r = write(fd, s, n);
+		if (r <= 0) return;
+		s += r;
+		n -= r;
+	}
+}
+
+// the same report as malloc_info, but written without stdio so that it
+// can run at exit or from a debugger.
+void dump_heap(int fd)
+{
+	struct heap_stats st;
+	int e = errno;
+	collect_stats(&st);
+	print_stats(&st, out_fd, &fd);
+	errno = e;
+}
@@ -0,0 +1,6 @@
+#include <stdlib.h>
+
+void __libc_free_sized(void *p, size_t n, size_t align)
+{
+	__libc_free(p);
+}
@@ -0,0 +1,6 @@
+#include <malloc.h>
+
+struct mallinfo2 mallinfo2(void)
+{
+	return (struct mallinfo2){ 0 };
+}
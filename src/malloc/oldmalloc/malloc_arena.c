@@ -0,0 +1,41 @@
+#include <stdlib.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <errno.h>
+
+/* Without groups to carve from, an arena is just a list of the
+ * allocations made from it. */
+
+struct malloc_arena {
+	struct malloc_arena *next;
+	/* keeps what follows aligned as malloc's result is */
+	long double pad;
+};
+
+struct malloc_arena *malloc_arena_create(void)
+{
+	struct malloc_arena *a = malloc(sizeof *a);
+	if (a) a->next = 0;
+	return a;
+}
+
+void *malloc_arena_alloc(struct malloc_arena *a, size_t n)
+{
+	struct malloc_arena *b;
+	if (n > SIZE_MAX/2) {
+		errno = ENOMEM;
+		return 0;
+	}
+	if (!(b = malloc(sizeof *b + n))) return 0;
+	b->next = a->next;
+	a->next = b;
+	return b+1;
+}
+
+void malloc_arena_destroy(struct malloc_arena *a)
+{
+	for (struct malloc_arena *next; a; a = next) {
+		next = a->next;
+		free(a);
+	}
+}
@@ -0,0 +1,13 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <errno.h>
+
+int malloc_info(int options, FILE *f)
+{
+	if (options) {
+		errno = EINVAL;
+		return -1;
+	}
+	fputs("<malloc version=\"oldmalloc\">\n</malloc>\n", f);
+	return 0;
+}
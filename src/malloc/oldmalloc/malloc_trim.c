@@ -0,0 +1,6 @@
+#include <malloc.h>
+
+int malloc_trim(size_t pad)
+{
+	return 0;
+}
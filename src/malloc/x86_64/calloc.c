@@ -1,6 +1,62 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include "dynlink.h"
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#define PAGESZ 4096 /* arbitrary */
+
+/*
+ * As in the generic calloc, pages are cleared from the end and any page
+ * that already reads as zero is skipped. Reading a fresh anonymous page
+ * only maps the shared zero page, so untouched memory is never dirtied;
+ * only the part of a page up to its last nonzero byte goes to memset.
+ */
+
+/* bytes of the page at pp up to and including its last nonzero block */
+static size_t dirty_len(const char *pp)
+{
+	size_t i = PAGESZ;
+#ifdef __SSE2__
+	const __m128i zero = _mm_set1_epi8(0);
+	for (; i; i -= 64) {
+		const __m128i *q = (const __m128i *)(pp + i - 64);
+		__m128i x = _mm_or_si128(_mm_or_si128(q[0], q[1]), _mm_or_si128(q[2], q[3]));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xffff)
+			break;
+	}
+#else
+	typedef uint64_t __attribute__((__may_alias__)) T;
+	for (; i; i -= 2*sizeof(T))
+		if (((T *)(pp + i))[-1] | ((T *)(pp + i))[-2])
+			break;
+#endif
+	return i;
+}
+
+static size_t mal0_clear(char *p, size_t n)
+{
+	if (n < PAGESZ) return n;
+	char *pp = p + n;
+	size_t i = (uintptr_t)pp & (PAGESZ - 1);
+	for (;;) {
+		pp = memset(pp - i, 0, i);
+		if (pp - p < PAGESZ) return pp - p;
+		pp -= PAGESZ;
+		i = dirty_len(pp);
+		pp += i;
+	}
+}
+
+static int allzerop(void *p)
+{
+	return 0;
+}
+weak_alias(allzerop, __malloc_allzerop);
 
 void *calloc(size_t m, size_t n)
 {
@@ -10,7 +66,8 @@ void *calloc(size_t m, size_t n)
 	}
 	n *= m;
 	void *p = malloc(n);
-	if (!p)
+	if (!p || (!__malloc_replaced && __malloc_allzerop(p)))
 		return p;
+	n = mal0_clear(p, n);
 	return memset(p, 0, n);
 }
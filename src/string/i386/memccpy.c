@@ -29,6 +29,7 @@
 #include <immintrin.h>
 
 #include "cpu_features.h"
+#include "helpers.h"
 
 static void *memccpy_naive(void *restrict dest, const void *restrict src, int c, size_t n) {
 	char *d = dest;
@@ -56,15 +57,84 @@ static void *memccpy_sse2(void *restrict dest, const void *restrict src, int c,
 	return memccpy_naive(d, s, c, n);
 }
 
+__attribute__((__target__("avx2")))
+static void *memccpy_avx2(void *restrict dest, const void *restrict src, int c, size_t n) {
+	char *d = dest;
+	const char *s = src;
+	__m256i v = _mm256_set1_epi8(c);
+	while (n >= 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)s);
+		uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, v));
+		if (mask) {
+			size_t o = trailing_zeros(mask) + 1;
+			copy_small(d, s, o);
+			return d+o;
+		}
+		_mm256_storeu_si256((__m256i*)d, x);
+		s += 32;
+		d += 32;
+		n -= 32;
+	}
+	if (n >= 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)s);
+		uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(c)));
+		if (mask) {
+			size_t o = trailing_zeros(mask) + 1;
+			copy_small(d, s, o);
+			return d+o;
+		}
+		_mm_storeu_si128((__m128i*)d, x);
+		s += 16;
+		d += 16;
+		n -= 16;
+	}
+	return memccpy_naive(d, s, c, n);
+}
+
+/* the tail is loaded and stored under a mask, so it never faults past n */
+__attribute__((__target__("avx512bw,avx512vl")))
+static void *memccpy_avx512(void *restrict dest, const void *restrict src, int c, size_t n) {
+	char *d = dest;
+	const char *s = src;
+	__m512i v = _mm512_set1_epi8(c);
+	for (;;) {
+		__mmask64 k = n >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+		__m512i x = _mm512_maskz_loadu_epi8(k, s);
+		uint64_t mask = _mm512_mask_cmpeq_epi8_mask(k, x, v);
+		if (mask) {
+			size_t o = trailing_zeros64(mask) + 1;
+			_mm512_mask_storeu_epi8(d, ~(uint64_t)0 >> (64 - o), x);
+			return d+o;
+		}
+		if (n <= 64) {
+			_mm512_mask_storeu_epi8(d, k, x);
+			return NULL;
+		}
+		_mm512_storeu_si512(d, x);
+		s += 64;
+		d += 64;
+		n -= 64;
+	}
+}
+
 static void *memccpy_auto(void *restrict dest, const void *restrict src, int c, size_t n);
 
 static void *(*memccpy_impl)(void *restrict dest, const void *restrict src, int c, size_t n) = memccpy_auto;
 
-static void *memccpy_auto(void *restrict dest, const void *restrict src, int c, size_t n) {
-	if (has_sse2())
+__attribute__((visibility("hidden")))
+void __memccpy_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		memccpy_impl = memccpy_avx512;
+	else if (has_avx2())
+		memccpy_impl = memccpy_avx2;
+	else if (has_sse2())
 		memccpy_impl = memccpy_sse2;
 	else
 		memccpy_impl = memccpy_naive;
+}
+
+static void *memccpy_auto(void *restrict dest, const void *restrict src, int c, size_t n) {
+	__memccpy_resolve();
 	return memccpy_impl(dest, src, c, n);
 }
 
@@ -130,7 +130,7 @@ static int memcmp_sse2(const void *s1, const void *s2, size_t n)
 			else if ((o = _mm_movemask_epi8(n3)) != 0xffff)
 				o = trailing_zeros(~o) + 32;
 			else
-				o = trailing_zeros(~_mm_movemask_epi8(n2)) + 48;
+				o = trailing_zeros(~_mm_movemask_epi8(n4)) + 48;
 			return l[o]-r[o];
 		}
 		l += 64;
@@ -316,17 +316,72 @@ static int memcmp_avx2(const void *s1, const void *s2, size_t n)
 	return memcmp_naive(l, r, n);
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static int memcmp_avx512(const void *s1, const void *s2, size_t n)
+{
+	const unsigned char *l = s1;
+	const unsigned char *r = s2;
+	while (n >= 256) {
+		uint64_t m1 = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(l), _mm512_loadu_si512(r));
+		uint64_t m2 = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(l+64), _mm512_loadu_si512(r+64));
+		uint64_t m3 = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(l+128), _mm512_loadu_si512(r+128));
+		uint64_t m4 = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(l+192), _mm512_loadu_si512(r+192));
+		if (m1 | m2 | m3 | m4) {
+			int o;
+			if (m1)
+				o = trailing_zeros64(m1);
+			else if (m2)
+				o = trailing_zeros64(m2) + 64;
+			else if (m3)
+				o = trailing_zeros64(m3) + 128;
+			else
+				o = trailing_zeros64(m4) + 192;
+			return l[o]-r[o];
+		}
+		l += 256;
+		r += 256;
+		n -= 256;
+	}
+	while (n >= 64) {
+		uint64_t m = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(l), _mm512_loadu_si512(r));
+		if (m) {
+			int o = trailing_zeros64(m);
+			return l[o]-r[o];
+		}
+		l += 64;
+		r += 64;
+		n -= 64;
+	}
+	if (n) {
+		/* masked-off bytes are never accessed, so this cannot fault */
+		__mmask64 k = ((uint64_t)1 << n) - 1;
+		uint64_t m = _mm512_mask_cmpneq_epi8_mask(k, _mm512_maskz_loadu_epi8(k, l), _mm512_maskz_loadu_epi8(k, r));
+		if (m) {
+			int o = trailing_zeros64(m);
+			return l[o]-r[o];
+		}
+	}
+	return 0;
+}
+
 static int memcmp_auto(const void *s1, const void *s2, size_t n);
 
 static int (*memcmp_impl)(const void *s1, const void *s2, size_t n) = memcmp_auto;
 
-static int memcmp_auto(const void *s1, const void *s2, size_t n) {
-	if (has_avx2())
+__attribute__((visibility("hidden")))
+void __memcmp_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		memcmp_impl = memcmp_avx512;
+	else if (has_avx2())
 		memcmp_impl = memcmp_avx2;
 	else if (has_sse2())
 		memcmp_impl = memcmp_sse2;
 	else
 		memcmp_impl = memcmp_naive;
+}
+
+static int memcmp_auto(const void *s1, const void *s2, size_t n) {
+	__memcmp_resolve();
 	return memcmp_impl(s1, s2, n);
 }
 
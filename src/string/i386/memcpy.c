@@ -30,6 +30,7 @@
 #include <immintrin.h>
 
 #include "cpu_features.h"
+#include "helpers.h"
 
 static void *memcpy_naive(void *restrict dest, const void *restrict src, size_t n) {
 	char *d = dest;
@@ -75,7 +76,7 @@ static void *memcpy_sse2(void *restrict dest, const void *restrict src, size_t n
 		memcpy_naive(d + f, s + f, n);
 		return dest;
 	}
-	if (n >= 1 << 21) {
+	if (n >= non_temporal_threshold()) {
 		for (int i = 0; i < 8; i++) {
 #pragma omp simd
 			for (int j = 0; j < 16; j++)
@@ -156,15 +157,238 @@ static void *memcpy_sse2(void *restrict dest, const void *restrict src, size_t n
 	return dest;
 }
 
+__attribute__((__target__("avx2")))
+static void *memcpy_avx2(void *restrict dest, const void *restrict src, size_t n) {
+	char *d = dest;
+	const char *s = src;
+	if (n <= 32) {
+		if (n >= 16) {
+			__m128i chunk1 = _mm_loadu_si128((const __m128i*)s);
+			__m128i chunk2 = _mm_loadu_si128((const __m128i*)(s+n)-1);
+			_mm_storeu_si128((__m128i*)d, chunk1);
+			_mm_storeu_si128((__m128i*)(d+n)-1, chunk2);
+		}
+		else if (n >= 8) {
+			uint64_t chunk1 = load64(s);
+			uint64_t chunk2 = load64(s+n-8);
+			store64(d, chunk1);
+			store64(d+n-8, chunk2);
+		}
+		else if (n >= 4) {
+			uint32_t chunk1 = load32(s);
+			uint32_t chunk2 = load32(s+n-4);
+			store32(d, chunk1);
+			store32(d+n-4, chunk2);
+		}
+		else if (n) {
+			char c1 = s[0], c2 = s[n/2], c3 = s[n-1];
+			d[0] = c1;
+			d[n/2] = c2;
+			d[n-1] = c3;
+		}
+		return dest;
+	}
+	if (n <= 64) {
+		__m256i chunk1 = _mm256_loadu_si256((const __m256i*)s);
+		__m256i chunk2 = _mm256_loadu_si256((const __m256i*)(s+n)-1);
+		_mm256_storeu_si256((__m256i*)d, chunk1);
+		_mm256_storeu_si256((__m256i*)(d+n)-1, chunk2);
+		return dest;
+	}
+	if (n <= 128) {
+		__m256i chunk1 = _mm256_loadu_si256((const __m256i*)s+0);
+		__m256i chunk2 = _mm256_loadu_si256((const __m256i*)s+1);
+		__m256i chunk3 = _mm256_loadu_si256((const __m256i*)(s+n)-2);
+		__m256i chunk4 = _mm256_loadu_si256((const __m256i*)(s+n)-1);
+		_mm256_storeu_si256((__m256i*)d+0, chunk1);
+		_mm256_storeu_si256((__m256i*)d+1, chunk2);
+		_mm256_storeu_si256((__m256i*)(d+n)-2, chunk3);
+		_mm256_storeu_si256((__m256i*)(d+n)-1, chunk4);
+		return dest;
+	}
+	if (n <= 256) {
+		__m256i chunk1 = _mm256_loadu_si256((const __m256i*)s+0);
+		__m256i chunk2 = _mm256_loadu_si256((const __m256i*)s+1);
+		__m256i chunk3 = _mm256_loadu_si256((const __m256i*)s+2);
+		__m256i chunk4 = _mm256_loadu_si256((const __m256i*)s+3);
+		__m256i chunk5 = _mm256_loadu_si256((const __m256i*)(s+n)-4);
+		__m256i chunk6 = _mm256_loadu_si256((const __m256i*)(s+n)-3);
+		__m256i chunk7 = _mm256_loadu_si256((const __m256i*)(s+n)-2);
+		__m256i chunk8 = _mm256_loadu_si256((const __m256i*)(s+n)-1);
+		_mm256_storeu_si256((__m256i*)d+0, chunk1);
+		_mm256_storeu_si256((__m256i*)d+1, chunk2);
+		_mm256_storeu_si256((__m256i*)d+2, chunk3);
+		_mm256_storeu_si256((__m256i*)d+3, chunk4);
+		_mm256_storeu_si256((__m256i*)(d+n)-4, chunk5);
+		_mm256_storeu_si256((__m256i*)(d+n)-3, chunk6);
+		_mm256_storeu_si256((__m256i*)(d+n)-2, chunk7);
+		_mm256_storeu_si256((__m256i*)(d+n)-1, chunk8);
+		return dest;
+	}
+	int nt = n >= non_temporal_threshold();
+	if (!nt && n >= rep_movsb_threshold()) {
+		rep_movsb(d, s, n);
+		return dest;
+	}
+	/* the unaligned head and the last 128 bytes are copied separately */
+	__m256i head = _mm256_loadu_si256((const __m256i*)s);
+	__m256i tail1 = _mm256_loadu_si256((const __m256i*)(s+n)-4);
+	__m256i tail2 = _mm256_loadu_si256((const __m256i*)(s+n)-3);
+	__m256i tail3 = _mm256_loadu_si256((const __m256i*)(s+n)-2);
+	__m256i tail4 = _mm256_loadu_si256((const __m256i*)(s+n)-1);
+	size_t f = 32 - (uintptr_t)d % 32;
+	if (nt) {
+		while (n - f > 128) {
+			__m256i chunk1 = _mm256_loadu_si256((const __m256i*)(s+f)+0);
+			__m256i chunk2 = _mm256_loadu_si256((const __m256i*)(s+f)+1);
+			__m256i chunk3 = _mm256_loadu_si256((const __m256i*)(s+f)+2);
+			__m256i chunk4 = _mm256_loadu_si256((const __m256i*)(s+f)+3);
+			_mm_prefetch(s+f+512, _MM_HINT_NTA);
+			_mm256_stream_si256((__m256i*)(d+f)+0, chunk1);
+			_mm256_stream_si256((__m256i*)(d+f)+1, chunk2);
+			_mm256_stream_si256((__m256i*)(d+f)+2, chunk3);
+			_mm256_stream_si256((__m256i*)(d+f)+3, chunk4);
+			f += 128;
+		}
+		_mm_sfence();
+	}
+	else {
+		while (n - f > 128) {
+			__m256i chunk1 = _mm256_loadu_si256((const __m256i*)(s+f)+0);
+			__m256i chunk2 = _mm256_loadu_si256((const __m256i*)(s+f)+1);
+			__m256i chunk3 = _mm256_loadu_si256((const __m256i*)(s+f)+2);
+			__m256i chunk4 = _mm256_loadu_si256((const __m256i*)(s+f)+3);
+			_mm256_store_si256((__m256i*)(d+f)+0, chunk1);
+			_mm256_store_si256((__m256i*)(d+f)+1, chunk2);
+			_mm256_store_si256((__m256i*)(d+f)+2, chunk3);
+			_mm256_store_si256((__m256i*)(d+f)+3, chunk4);
+			f += 128;
+		}
+	}
+	_mm256_storeu_si256((__m256i*)(d+n)-4, tail1);
+	_mm256_storeu_si256((__m256i*)(d+n)-3, tail2);
+	_mm256_storeu_si256((__m256i*)(d+n)-2, tail3);
+	_mm256_storeu_si256((__m256i*)(d+n)-1, tail4);
+	_mm256_storeu_si256((__m256i*)d, head);
+	return dest;
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static void *memcpy_avx512(void *restrict dest, const void *restrict src, size_t n) {
+	char *d = dest;
+	const char *s = src;
+	if (n <= 64) {
+		if (n) {
+			__mmask64 mask = ~(uint64_t)0 >> (64 - n);
+			__m512i chunk = _mm512_maskz_loadu_epi8(mask, s);
+			_mm512_mask_storeu_epi8(d, mask, chunk);
+		}
+		return dest;
+	}
+	if (n <= 128) {
+		__m512i chunk1 = _mm512_loadu_si512((const __m512i*)s);
+		__m512i chunk2 = _mm512_loadu_si512((const __m512i*)(s+n)-1);
+		_mm512_storeu_si512((__m512i*)d, chunk1);
+		_mm512_storeu_si512((__m512i*)(d+n)-1, chunk2);
+		return dest;
+	}
+	if (n <= 256) {
+		__m512i chunk1 = _mm512_loadu_si512((const __m512i*)s+0);
+		__m512i chunk2 = _mm512_loadu_si512((const __m512i*)s+1);
+		__m512i chunk3 = _mm512_loadu_si512((const __m512i*)(s+n)-2);
+		__m512i chunk4 = _mm512_loadu_si512((const __m512i*)(s+n)-1);
+		_mm512_storeu_si512((__m512i*)d+0, chunk1);
+		_mm512_storeu_si512((__m512i*)d+1, chunk2);
+		_mm512_storeu_si512((__m512i*)(d+n)-2, chunk3);
+		_mm512_storeu_si512((__m512i*)(d+n)-1, chunk4);
+		return dest;
+	}
+	if (n <= 512) {
+		__m512i chunk1 = _mm512_loadu_si512((const __m512i*)s+0);
+		__m512i chunk2 = _mm512_loadu_si512((const __m512i*)s+1);
+		__m512i chunk3 = _mm512_loadu_si512((const __m512i*)s+2);
+		__m512i chunk4 = _mm512_loadu_si512((const __m512i*)s+3);
+		__m512i chunk5 = _mm512_loadu_si512((const __m512i*)(s+n)-4);
+		__m512i chunk6 = _mm512_loadu_si512((const __m512i*)(s+n)-3);
+		__m512i chunk7 = _mm512_loadu_si512((const __m512i*)(s+n)-2);
+		__m512i chunk8 = _mm512_loadu_si512((const __m512i*)(s+n)-1);
+		_mm512_storeu_si512((__m512i*)d+0, chunk1);
+		_mm512_storeu_si512((__m512i*)d+1, chunk2);
+		_mm512_storeu_si512((__m512i*)d+2, chunk3);
+		_mm512_storeu_si512((__m512i*)d+3, chunk4);
+		_mm512_storeu_si512((__m512i*)(d+n)-4, chunk5);
+		_mm512_storeu_si512((__m512i*)(d+n)-3, chunk6);
+		_mm512_storeu_si512((__m512i*)(d+n)-2, chunk7);
+		_mm512_storeu_si512((__m512i*)(d+n)-1, chunk8);
+		return dest;
+	}
+	int nt = n >= non_temporal_threshold();
+	if (!nt && n >= rep_movsb_threshold()) {
+		rep_movsb(d, s, n);
+		return dest;
+	}
+	/* the unaligned head and the last 256 bytes are copied separately */
+	__m512i head = _mm512_loadu_si512((const __m512i*)s);
+	__m512i tail1 = _mm512_loadu_si512((const __m512i*)(s+n)-4);
+	__m512i tail2 = _mm512_loadu_si512((const __m512i*)(s+n)-3);
+	__m512i tail3 = _mm512_loadu_si512((const __m512i*)(s+n)-2);
+	__m512i tail4 = _mm512_loadu_si512((const __m512i*)(s+n)-1);
+	size_t f = 64 - (uintptr_t)d % 64;
+	if (nt) {
+		while (n - f > 256) {
+			__m512i chunk1 = _mm512_loadu_si512((const __m512i*)(s+f)+0);
+			__m512i chunk2 = _mm512_loadu_si512((const __m512i*)(s+f)+1);
+			__m512i chunk3 = _mm512_loadu_si512((const __m512i*)(s+f)+2);
+			__m512i chunk4 = _mm512_loadu_si512((const __m512i*)(s+f)+3);
+			_mm_prefetch(s+f+1024, _MM_HINT_NTA);
+			_mm_prefetch(s+f+1088, _MM_HINT_NTA);
+			_mm512_stream_si512((__m512i*)(d+f)+0, chunk1);
+			_mm512_stream_si512((__m512i*)(d+f)+1, chunk2);
+			_mm512_stream_si512((__m512i*)(d+f)+2, chunk3);
+			_mm512_stream_si512((__m512i*)(d+f)+3, chunk4);
+			f += 256;
+		}
+		_mm_sfence();
+	}
+	else {
+		while (n - f > 256) {
+			__m512i chunk1 = _mm512_loadu_si512((const __m512i*)(s+f)+0);
+			__m512i chunk2 = _mm512_loadu_si512((const __m512i*)(s+f)+1);
+			__m512i chunk3 = _mm512_loadu_si512((const __m512i*)(s+f)+2);
+			__m512i chunk4 = _mm512_loadu_si512((const __m512i*)(s+f)+3);
+			_mm512_store_si512((__m512i*)(d+f)+0, chunk1);
+			_mm512_store_si512((__m512i*)(d+f)+1, chunk2);
+			_mm512_store_si512((__m512i*)(d+f)+2, chunk3);
+			_mm512_store_si512((__m512i*)(d+f)+3, chunk4);
+			f += 256;
+		}
+	}
+	_mm512_storeu_si512((__m512i*)(d+n)-4, tail1);
+	_mm512_storeu_si512((__m512i*)(d+n)-3, tail2);
+	_mm512_storeu_si512((__m512i*)(d+n)-2, tail3);
+	_mm512_storeu_si512((__m512i*)(d+n)-1, tail4);
+	_mm512_storeu_si512((__m512i*)d, head);
+	return dest;
+}
+
 static void *memcpy_auto(void *restrict dest, const void *restrict src, size_t n);
 
 static void *(*memcpy_impl)(void *restrict dest, const void *restrict src, size_t n) = memcpy_auto;
 
-static void *memcpy_auto(void *restrict dest, const void *restrict src, size_t n) {
-	if (has_sse2())
+__attribute__((visibility("hidden")))
+void __memcpy_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		memcpy_impl = memcpy_avx512;
+	else if (has_avx2())
+		memcpy_impl = memcpy_avx2;
+	else if (has_sse2())
 		memcpy_impl = memcpy_sse2;
 	else
 		memcpy_impl = memcpy_naive;
+}
+
+static void *memcpy_auto(void *restrict dest, const void *restrict src, size_t n) {
+	__memcpy_resolve();
 	return memcpy_impl(dest, src, n);
 }
 
@@ -0,0 +1,142 @@
+#include <string.h>
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "helpers.h"
+
+static void *memrchr_fallback(const void *m, int c, size_t n) {
+	const unsigned char *s = m;
+	while (n--)
+		if (s[n] == c)
+			return (void*)(s+n);
+	return NULL;
+}
+
+/*
+ * The kernels walk backwards from the end with unaligned loads that stay
+ * inside [m, m+n), and finish the head of the buffer one byte at a time,
+ * or with a masked load for AVX-512.
+ */
+
+__attribute__((__target__("sse2")))
+static void *memrchr_sse2(const void *m, int c, size_t n) {
+	const unsigned char *s = m;
+	__m128i v = _mm_set1_epi8(c);
+	while (n >= 64) {
+		__m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s+n-64)), v);
+		__m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s+n-48)), v);
+		__m128i x = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s+n-32)), v);
+		__m128i d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s+n-16)), v);
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(x, d)))) {
+			uint32_t mask;
+			if ((mask = _mm_movemask_epi8(d)))
+				return (void*)(s+n-16 + 31-leading_zeros(mask));
+			if ((mask = _mm_movemask_epi8(x)))
+				return (void*)(s+n-32 + 31-leading_zeros(mask));
+			if ((mask = _mm_movemask_epi8(b)))
+				return (void*)(s+n-48 + 31-leading_zeros(mask));
+			mask = _mm_movemask_epi8(a);
+			return (void*)(s+n-64 + 31-leading_zeros(mask));
+		}
+		n -= 64;
+	}
+	while (n >= 16) {
+		uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s+n-16)), v));
+		if (mask)
+			return (void*)(s+n-16 + 31-leading_zeros(mask));
+		n -= 16;
+	}
+	return memrchr_fallback(s, c, n);
+}
+
+__attribute__((__target__("avx2")))
+static void *memrchr_avx2(const void *m, int c, size_t n) {
+	const unsigned char *s = m;
+	__m256i v = _mm256_set1_epi8(c);
+	while (n >= 128) {
+		__m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(s+n-128)), v);
+		__m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(s+n-96)), v);
+		__m256i x = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(s+n-64)), v);
+		__m256i d = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(s+n-32)), v);
+		if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(x, d)))) {
+			uint32_t mask;
+			if ((mask = _mm256_movemask_epi8(d)))
+				return (void*)(s+n-32 + 31-leading_zeros(mask));
+			if ((mask = _mm256_movemask_epi8(x)))
+				return (void*)(s+n-64 + 31-leading_zeros(mask));
+			if ((mask = _mm256_movemask_epi8(b)))
+				return (void*)(s+n-96 + 31-leading_zeros(mask));
+			mask = _mm256_movemask_epi8(a);
+			return (void*)(s+n-128 + 31-leading_zeros(mask));
+		}
+		n -= 128;
+	}
+	while (n >= 32) {
+		uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(s+n-32)), v));
+		if (mask)
+			return (void*)(s+n-32 + 31-leading_zeros(mask));
+		n -= 32;
+	}
+	if (n >= 16) {
+		uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s+n-16)), _mm_set1_epi8(c)));
+		if (mask)
+			return (void*)(s+n-16 + 31-leading_zeros(mask));
+		n -= 16;
+	}
+	return memrchr_fallback(s, c, n);
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static void *memrchr_avx512(const void *m, int c, size_t n) {
+	const unsigned char *s = m;
+	__m512i v = _mm512_set1_epi8(c);
+	while (n >= 128) {
+		uint64_t m1 = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(s+n-128), v);
+		uint64_t m2 = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(s+n-64), v);
+		if (m2)
+			return (void*)(s+n-64 + 63-leading_zeros64(m2));
+		if (m1)
+			return (void*)(s+n-128 + 63-leading_zeros64(m1));
+		n -= 128;
+	}
+	if (n >= 64) {
+		uint64_t mask = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(s+n-64), v);
+		if (mask)
+			return (void*)(s+n-64 + 63-leading_zeros64(mask));
+		n -= 64;
+	}
+	if (n) {
+		__mmask64 k = ((uint64_t)1 << n) - 1;
+		uint64_t mask = _mm512_mask_cmpeq_epi8_mask(k, _mm512_maskz_loadu_epi8(k, s), v);
+		if (mask)
+			return (void*)(s + 63-leading_zeros64(mask));
+	}
+	return NULL;
+}
+
+static void *memrchr_auto(const void *m, int c, size_t n);
+
+static void *(*memrchr_impl)(const void *m, int c, size_t n) = memrchr_auto;
+
+__attribute__((visibility("hidden")))
+void __memrchr_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		memrchr_impl = memrchr_avx512;
+	else if (has_avx2())
+		memrchr_impl = memrchr_avx2;
+	else if (has_sse2())
+		memrchr_impl = memrchr_sse2;
+	else
+		memrchr_impl = memrchr_fallback;
+}
+
+static void *memrchr_auto(const void *m, int c, size_t n) {
+	__memrchr_resolve();
+	return memrchr_impl(m, c, n);
+}
+
+void *__memrchr(const void *m, int c, size_t n) {
+	return memrchr_impl(m, (unsigned char)c, n);
+}
+
+weak_alias(__memrchr, memrchr);
@@ -41,258 +41,230 @@ static char *stpncpy_internal_naive(char *dest, const char *src, size_t n) {
 	return dest + n;
 }
 
+/*
+ * The source is scanned with aligned loads, so no read crosses into a page
+ * past the terminator or past n. Nothing is stored beyond the copied bytes.
+ */
+
+__attribute__((__target__("sse2")))
 static char *stpncpy_internal_sse2(char *dest, const char *src, size_t n) {
+	if (!n)
+		return dest;
 	const __m128i zero = _mm_set1_epi8(0);
-	if (n < 128) {
-		if (n >= 64) {
-			__m128i chunk1 = _mm_loadu_si128((const __m128i*)(src)+0);
-			__m128i chunk2 = _mm_loadu_si128((const __m128i*)(src)+1);
-			__m128i chunk3 = _mm_loadu_si128((const __m128i*)(src)+2);
-			__m128i chunk4 = _mm_loadu_si128((const __m128i*)(src)+3);
-			_mm_storeu_si128((__m128i*)(dest)+0, chunk1);
-			_mm_storeu_si128((__m128i*)(dest)+1, chunk2);
-			_mm_storeu_si128((__m128i*)(dest)+2, chunk3);
-			_mm_storeu_si128((__m128i*)(dest)+3, chunk4);
-			__m128i z1 = _mm_cmpeq_epi8(chunk1, zero);
-			__m128i z2 = _mm_cmpeq_epi8(chunk2, zero);
-			__m128i z3 = _mm_cmpeq_epi8(chunk3, zero);
-			__m128i z4 = _mm_cmpeq_epi8(chunk4, zero);
-			__m128i z12 = _mm_or_si128(z1, z2);
-			__m128i z34 = _mm_or_si128(z3, z4);
-			if (_mm_movemask_epi8(_mm_or_si128(z12, z34))) {
-				unsigned o;
-				if (_mm_movemask_epi8(z12)) {
-					if ((o = _mm_movemask_epi8(z1))) {
-						o = trailing_zeros(o);
-						return dest + o;
-					}
-					else {
-						o = trailing_zeros(_mm_movemask_epi8(z2));
-						return dest + 16 + o;
-					}
-				}
-				else {
-					if ((o = _mm_movemask_epi8(z3))) {
-						o = trailing_zeros(o);
-						return dest + 32 + o;
-					}
-					else {
-						o = trailing_zeros(_mm_movemask_epi8(z4));
-						return dest + 48 + o;
-					}
-				}
-			}
-			src += 64;
-			dest += 64;
-			n -= 64;
-		}
-		if (n >= 32) {
-			__m128i chunk1 = _mm_loadu_si128((const __m128i*)(src)+0);
-			__m128i chunk2 = _mm_loadu_si128((const __m128i*)(src)+1);
-			_mm_storeu_si128((__m128i*)(dest)+0, chunk1);
-			_mm_storeu_si128((__m128i*)(dest)+1, chunk2);
-			__m128i z1 = _mm_cmpeq_epi8(chunk1, zero);
-			__m128i z2 = _mm_cmpeq_epi8(chunk2, zero);
-			if (_mm_movemask_epi8(_mm_or_si128(z1, z2))) {
-				unsigned o;
-				if ((o = _mm_movemask_epi8(z1))) {
-					o = trailing_zeros(o);
-					return dest + o;
-				}
-				else {
-					o = trailing_zeros(_mm_movemask_epi8(z2));
-					return dest + 16 + o;
-				}
-			}
-			src += 32;
-			dest += 32;
-			n -= 32;
-		}
-		if (n >= 16) {
-			__m128i chunk1 = _mm_loadu_si128((const __m128i*)(src)+0);
-			_mm_storeu_si128((__m128i*)(dest)+0, chunk1);
-			unsigned o = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk1, zero));
-			if (o) {
-				o = trailing_zeros(o);
-				return dest + o;
+	size_t off = (uintptr_t)src % 16;
+	const __m128i *ptr = (const __m128i*)(src - off);
+	uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(ptr), zero)) >> off;
+	size_t l = mask ? trailing_zeros(mask) : 16 - off;
+	if (mask || n <= l) {
+		if (l > n)
+			l = n;
+		copy_small(dest, src, l);
+		return dest + l;
+	}
+	const char *s = src;
+	char *d = dest;
+	for (;;) {
+		ptr++;
+		if ((uintptr_t)ptr % 64 == 0) {
+			while ((size_t)((const char*)(ptr+4) - src) < n) {
+				__m128i a = _mm_load_si128(ptr);
+				__m128i b = _mm_load_si128(ptr+1);
+				__m128i c = _mm_load_si128(ptr+2);
+				__m128i e = _mm_load_si128(ptr+3);
+				__m128i min = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, e));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(min, zero)))
+					break;
+				__m128i chunk1 = _mm_loadu_si128((const __m128i*)s+0);
+				__m128i chunk2 = _mm_loadu_si128((const __m128i*)s+1);
+				__m128i chunk3 = _mm_loadu_si128((const __m128i*)s+2);
+				__m128i chunk4 = _mm_loadu_si128((const __m128i*)s+3);
+				_mm_storeu_si128((__m128i*)d+0, chunk1);
+				_mm_storeu_si128((__m128i*)d+1, chunk2);
+				_mm_storeu_si128((__m128i*)d+2, chunk3);
+				_mm_storeu_si128((__m128i*)d+3, chunk4);
+				s += 64;
+				d += 64;
+				ptr += 4;
 			}
-			src += 16;
-			dest += 16;
-			n -= 16;
 		}
-		return stpncpy_internal_naive(dest, src, n);
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(ptr), zero));
+		if (mask)
+			l = (const char*)ptr + trailing_zeros(mask) - src;
+		else
+			l = (const char*)(ptr+1) - src;
+		if (mask || l >= n)
+			break;
+		_mm_storeu_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+		s += 16;
+		d += 16;
 	}
-	size_t padding = 15 - ((uintptr_t)(dest-1) % 16);
-	if (padding) {
-		__m128i chunk = _mm_loadu_si128((const __m128i*)src);
-		unsigned o = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
-		if (o) {
-			o = trailing_zeros(o);
-			_mm_storeu_si128((__m128i*)dest, chunk);
-			return dest + o;
-		}
-		_mm_storeu_si128((__m128i*)dest, chunk);
-		src += padding;
-		dest += padding;
-		n -= padding;
+	if (l > n)
+		l = n;
+	if (l <= 16) {
+		copy_small(dest, src, l);
+		return dest + l;
 	}
-	if (n >= 1 << 21) {
-		padding = 127 - ((uintptr_t)(dest-1) % 128);
-		for (size_t i = 0; i < padding/16; i++) {
-			__m128i chunk1 = _mm_loadu_si128((const __m128i*)src+i);
-			_mm_store_si128((__m128i*)dest+i, chunk1);
-		}
-		src += padding;
-		dest += padding;
-		n -= padding;
-		for (size_t i = 0; i < n/64; i++) {
-			__m128i chunk1 = _mm_loadu_si128((const __m128i*)(src+64*i)+0);
-			__m128i chunk2 = _mm_loadu_si128((const __m128i*)(src+64*i)+1);
-			__m128i chunk3 = _mm_loadu_si128((const __m128i*)(src+64*i)+2);
-			__m128i chunk4 = _mm_loadu_si128((const __m128i*)(src+64*i)+3);
-			_mm_prefetch(src+64*i+128, _MM_HINT_NTA);
-			_mm_stream_si128((__m128i*)(dest+64*i)+0, chunk1);
-			_mm_stream_si128((__m128i*)(dest+64*i)+1, chunk2);
-			_mm_stream_si128((__m128i*)(dest+64*i)+2, chunk3);
-			_mm_stream_si128((__m128i*)(dest+64*i)+3, chunk4);
-			__m128i z1 = _mm_cmpeq_epi8(chunk1, zero);
-			__m128i z2 = _mm_cmpeq_epi8(chunk2, zero);
-			__m128i z3 = _mm_cmpeq_epi8(chunk3, zero);
-			__m128i z4 = _mm_cmpeq_epi8(chunk4, zero);
-			__m128i z12 = _mm_or_si128(z1, z2);
-			__m128i z34 = _mm_or_si128(z3, z4);
-			if (_mm_movemask_epi8(_mm_or_si128(z12, z34))) {
-				dest += 64*i;
-				unsigned o;
-				if (_mm_movemask_epi8(z12)) {
-					if ((o = _mm_movemask_epi8(z1))) {
-						o = trailing_zeros(o);
-						return dest + o;
-					}
-					else {
-						o = trailing_zeros(_mm_movemask_epi8(z2));
-						return dest + 16 + o;
-					}
-				}
-				else {
-					if ((o = _mm_movemask_epi8(z3))) {
-						o = trailing_zeros(o);
-						return dest + 32 + o;
-					}
-					else {
-						o = trailing_zeros(_mm_movemask_epi8(z4));
-						return dest + 48 + o;
-					}
-				}
-			}
-		}
-		_mm_sfence();
-		src += n & ~63;
-		dest += n & ~63;
-		n %= 64;
+	if (src + l - s > 16)
+		_mm_storeu_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+	_mm_storeu_si128((__m128i*)(dest+l)-1, _mm_loadu_si128((const __m128i*)(src+l)-1));
+	return dest + l;
+}
+
+__attribute__((__target__("avx2")))
+static char *stpncpy_internal_avx2(char *dest, const char *src, size_t n) {
+	if (!n)
+		return dest;
+	const __m256i zero = _mm256_set1_epi8(0);
+	size_t off = (uintptr_t)src % 32;
+	const __m256i *ptr = (const __m256i*)(src - off);
+	uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(ptr), zero)) >> off;
+	size_t l = mask ? trailing_zeros(mask) : 32 - off;
+	if (mask || n <= l) {
+		if (l > n)
+			l = n;
+		copy_small(dest, src, l);
+		return dest + l;
 	}
-	else if (n >= 1 << 7) {
-		for (size_t i = 0; i < n/64; i++) {
-			__m128i chunk1 = _mm_loadu_si128((const __m128i*)(src+64*i)+0);
-			__m128i chunk2 = _mm_loadu_si128((const __m128i*)(src+64*i)+1);
-			__m128i chunk3 = _mm_loadu_si128((const __m128i*)(src+64*i)+2);
-			__m128i chunk4 = _mm_loadu_si128((const __m128i*)(src+64*i)+3);
-			_mm_prefetch(src+64*i+64, _MM_HINT_NTA);
-			_mm_store_si128((__m128i*)(dest+64*i)+0, chunk1);
-			_mm_store_si128((__m128i*)(dest+64*i)+1, chunk2);
-			_mm_store_si128((__m128i*)(dest+64*i)+2, chunk3);
-			_mm_store_si128((__m128i*)(dest+64*i)+3, chunk4);
-			__m128i z1 = _mm_cmpeq_epi8(chunk1, zero);
-			__m128i z2 = _mm_cmpeq_epi8(chunk2, zero);
-			__m128i z3 = _mm_cmpeq_epi8(chunk3, zero);
-			__m128i z4 = _mm_cmpeq_epi8(chunk4, zero);
-			__m128i z12 = _mm_or_si128(z1, z2);
-			__m128i z34 = _mm_or_si128(z3, z4);
-			if (_mm_movemask_epi8(_mm_or_si128(z12, z34))) {
-				dest += 64*i;
-				unsigned o;
-				if (_mm_movemask_epi8(z12)) {
-					if ((o = _mm_movemask_epi8(z1))) {
-						o = trailing_zeros(o);
-						return dest + o;
-					}
-					else {
-						o = trailing_zeros(_mm_movemask_epi8(z2));
-						return dest + 16 + o;
-					}
-				}
-				else {
-					if ((o = _mm_movemask_epi8(z3))) {
-						o = trailing_zeros(o);
-						return dest + 32 + o;
-					}
-					else {
-						o = trailing_zeros(_mm_movemask_epi8(z4));
-						return dest + 48 + o;
-					}
-				}
+	const char *s = src;
+	char *d = dest;
+	for (;;) {
+		ptr++;
+		if ((uintptr_t)ptr % 128 == 0) {
+			while ((size_t)((const char*)(ptr+4) - src) < n) {
+				__m256i a = _mm256_load_si256(ptr);
+				__m256i b = _mm256_load_si256(ptr+1);
+				__m256i c = _mm256_load_si256(ptr+2);
+				__m256i e = _mm256_load_si256(ptr+3);
+				__m256i min = _mm256_min_epu8(_mm256_min_epu8(a, b), _mm256_min_epu8(c, e));
+				if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(min, zero)))
+					break;
+				__m256i chunk1 = _mm256_loadu_si256((const __m256i*)s+0);
+				__m256i chunk2 = _mm256_loadu_si256((const __m256i*)s+1);
+				__m256i chunk3 = _mm256_loadu_si256((const __m256i*)s+2);
+				__m256i chunk4 = _mm256_loadu_si256((const __m256i*)s+3);
+				_mm256_storeu_si256((__m256i*)d+0, chunk1);
+				_mm256_storeu_si256((__m256i*)d+1, chunk2);
+				_mm256_storeu_si256((__m256i*)d+2, chunk3);
+				_mm256_storeu_si256((__m256i*)d+3, chunk4);
+				s += 128;
+				d += 128;
+				ptr += 4;
 			}
 		}
-		src += n & ~63;
-		dest += n & ~63;
-		n %= 64;
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(ptr), zero));
+		if (mask)
+			l = (const char*)ptr + trailing_zeros(mask) - src;
+		else
+			l = (const char*)(ptr+1) - src;
+		if (mask || l >= n)
+			break;
+		_mm256_storeu_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+		s += 32;
+		d += 32;
 	}
-	if (n >= 32) {
-		__m128i chunk1 = _mm_loadu_si128((const __m128i*)(src)+0);
-		__m128i chunk2 = _mm_loadu_si128((const __m128i*)(src)+1);
-		_mm_storeu_si128((__m128i*)(dest)+0, chunk1);
-		_mm_storeu_si128((__m128i*)(dest)+1, chunk2);
-		__m128i z1 = _mm_cmpeq_epi8(chunk1, zero);
-		__m128i z2 = _mm_cmpeq_epi8(chunk2, zero);
-		if (_mm_movemask_epi8(_mm_or_si128(z1, z2))) {
-			unsigned o;
-			if ((o = _mm_movemask_epi8(z1))) {
-				o = trailing_zeros(o);
-				return dest + o;
-			}
-			else {
-				o = trailing_zeros(_mm_movemask_epi8(z2));
-				return dest + 16 + o;
-			}
-		}
-		src += 32;
-		dest += 32;
-		n -= 32;
+	if (l > n)
+		l = n;
+	if (l <= 32) {
+		copy_small(dest, src, l);
+		return dest + l;
 	}
-	if (n >= 16) {
-		__m128i chunk1 = _mm_loadu_si128((const __m128i*)(src)+0);
-		_mm_storeu_si128((__m128i*)(dest)+0, chunk1);
-		unsigned o = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk1, zero));
-		if (o) {
-			o = trailing_zeros(o);
-			return dest + o;
-		}
-		src += 16;
-		dest += 16;
-		n -= 16;
+	if (src + l - s > 32)
+		_mm256_storeu_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+	_mm256_storeu_si256((__m256i*)(dest+l)-1, _mm256_loadu_si256((const __m256i*)(src+l)-1));
+	return dest + l;
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static char *stpncpy_internal_avx512(char *dest, const char *src, size_t n) {
+	if (!n)
+		return dest;
+	size_t off = (uintptr_t)src % 64;
+	const __m512i *ptr = (const __m512i*)(src - off);
+	__m512i x = _mm512_load_si512(ptr);
+	uint64_t mask = _mm512_testn_epi8_mask(x, x) >> off;
+	size_t l = mask ? trailing_zeros64(mask) : 64 - off;
+	if (mask || n <= l) {
+		if (l > n)
+			l = n;
+		uint64_t m = l ? (uint64_t)-1 >> (64 - l) : 0;
+		_mm512_mask_storeu_epi8(dest, m, _mm512_maskz_loadu_epi8(m, src));
+		return dest + l;
 	}
-	if (n) {
-		__m128i chunk = _mm_loadu_si128((__m128i*)(src+n)-1);
-		_mm_storeu_si128((__m128i*)(dest+n)-1, chunk);
-		unsigned o = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
-		if (o) {
-			o = trailing_zeros(o);
-			if (o < n)
-				return dest + o;
+	const char *s = src;
+	char *d = dest;
+	for (;;) {
+		ptr++;
+		if ((uintptr_t)ptr % 256 == 0) {
+			while ((size_t)((const char*)(ptr+4) - src) < n) {
+				__m512i a = _mm512_load_si512(ptr);
+				__m512i b = _mm512_load_si512(ptr+1);
+				__m512i c = _mm512_load_si512(ptr+2);
+				__m512i e = _mm512_load_si512(ptr+3);
+				__m512i min = _mm512_min_epu8(_mm512_min_epu8(a, b), _mm512_min_epu8(c, e));
+				if (_mm512_testn_epi8_mask(min, min))
+					break;
+				__m512i chunk1 = _mm512_loadu_si512(s);
+				__m512i chunk2 = _mm512_loadu_si512(s+64);
+				__m512i chunk3 = _mm512_loadu_si512(s+128);
+				__m512i chunk4 = _mm512_loadu_si512(s+192);
+				_mm512_storeu_si512(d, chunk1);
+				_mm512_storeu_si512(d+64, chunk2);
+				_mm512_storeu_si512(d+128, chunk3);
+				_mm512_storeu_si512(d+192, chunk4);
+				s += 256;
+				d += 256;
+				ptr += 4;
+			}
 		}
+		x = _mm512_load_si512(ptr);
+		mask = _mm512_testn_epi8_mask(x, x);
+		if (mask)
+			l = (const char*)ptr + trailing_zeros64(mask) - src;
+		else
+			l = (const char*)(ptr+1) - src;
+		if (mask || l >= n)
+			break;
+		_mm512_storeu_si512(d, _mm512_loadu_si512(s));
+		s += 64;
+		d += 64;
 	}
-	return dest + n;
+	if (l > n)
+		l = n;
+	size_t r = src + l - s;
+	if (r > 64) {
+		_mm512_storeu_si512(d, _mm512_loadu_si512(s));
+		s += 64;
+		d += 64;
+		r -= 64;
+	}
+	uint64_t m = r ? (uint64_t)-1 >> (64 - r) : 0;
+	_mm512_mask_storeu_epi8(d, m, _mm512_maskz_loadu_epi8(m, s));
+	return dest + l;
 }
 
 static char *stpncpy_internal_auto(char *dest, const char *src, size_t n);
 
 static char *(*stpncpy_internal)(char *dest, const char *src, size_t n) = stpncpy_internal_auto;
 
-static char *stpncpy_internal_auto(char *dest, const char *src, size_t n) {
-	if (has_sse2())
+__attribute__((visibility("hidden")))
+void __stpncpy_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		stpncpy_internal = stpncpy_internal_avx512;
+	else if (has_avx2())
+		stpncpy_internal = stpncpy_internal_avx2;
+	else if (has_sse2())
 		stpncpy_internal = stpncpy_internal_sse2;
 	else
 		stpncpy_internal = stpncpy_internal_naive;
+}
+
+static char *stpncpy_internal_auto(char *dest, const char *src, size_t n) {
+	__stpncpy_resolve();
+	return stpncpy_internal(dest, src, n);
+}
+
+__attribute__((visibility("hidden")))
+char *__stpncpy_nofill(char *dest, const char *src, size_t n) {
 	return stpncpy_internal(dest, src, n);
 }
 
@@ -175,17 +175,56 @@ static void* rawmemchr2_avx2(const void *haystack, int n1, int n2) {
 	}
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static void* rawmemchr2_avx512(const void *haystack, int n1, int n2) {
+	size_t off = (size_t)haystack % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)haystack - off);
+	__m512i vn1 = _mm512_set1_epi8(n1);
+	__m512i vn2 = _mm512_set1_epi8(n2);
+	__m512i x = _mm512_load_si512(ptr);
+	uint64_t mask = (_mm512_cmpeq_epi8_mask(x, vn1) | _mm512_cmpeq_epi8_mask(x, vn2)) >> off;
+	if (mask)
+		return (char*)haystack + trailing_zeros64(mask);
+	ptr++;
+	if ((size_t)ptr % 128) {
+		x = _mm512_load_si512(ptr);
+		mask = _mm512_cmpeq_epi8_mask(x, vn1) | _mm512_cmpeq_epi8_mask(x, vn2);
+		if (mask)
+			return (char*)ptr + trailing_zeros64(mask);
+		ptr++;
+	}
+	for (;;) {
+		__m512i a = _mm512_load_si512(ptr);
+		__m512i b = _mm512_load_si512(ptr+1);
+		uint64_t ma = _mm512_cmpeq_epi8_mask(a, vn1) | _mm512_cmpeq_epi8_mask(a, vn2);
+		uint64_t mb = _mm512_cmpeq_epi8_mask(b, vn1) | _mm512_cmpeq_epi8_mask(b, vn2);
+		if (ma | mb) {
+			if (ma)
+				return (char*)ptr + trailing_zeros64(ma);
+			return (char*)(ptr+1) + trailing_zeros64(mb);
+		}
+		ptr += 2;
+	}
+}
+
 static void *rawmemchr2_auto(const void *haystack, int n1, int n2);
 
 static void *(*rawmemchr2_impl)(const void *haystack, int n1, int n2) = rawmemchr2_auto;
 
-static void *rawmemchr2_auto(const void *haystack, int n1, int n2) {
-	if (has_avx2())
+__attribute__((visibility("hidden")))
+void __strchrnul_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		rawmemchr2_impl = rawmemchr2_avx512;
+	else if (has_avx2())
 		rawmemchr2_impl = rawmemchr2_avx2;
 	else if (has_sse2())
 		rawmemchr2_impl = rawmemchr2_sse2;
 	else
 		rawmemchr2_impl = rawmemchr2_fallback;
+}
+
+static void *rawmemchr2_auto(const void *haystack, int n1, int n2) {
+	__strchrnul_resolve();
 	return rawmemchr2_impl(haystack, n1, n2);
 }
 
@@ -33,16 +33,16 @@
 #include "cpu_features.h"
 #include "helpers.h"
 
-static size_t strdiff_naive(const char *s1, const char *s2, size_t n)
+static size_t casediff_naive(const char *s1, const char *s2, size_t n)
 {
 	for (size_t i = 0; i < n; i++)
-		if (!s1[i] || s1[i] != s2[i])
+		if (!s1[i] || fold_case(s1[i]) != fold_case(s2[i]))
 			return i;
 	return n-1;
 }
 
 __attribute__((__target__("sse2")))
-static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
+static size_t casediff_sse2(const char *s1, const char *s2, size_t n)
 {
 	const size_t padding1 = 127 - ((uintptr_t)(s1-1) % 128);
 	const size_t padding2 = 127 - ((uintptr_t)(s2-1) % 128);
@@ -59,10 +59,10 @@ static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
 		__m128i r3 = _mm_loadu_si128((const __m128i*)r+2);
 		__m128i l4 = _mm_loadu_si128((const __m128i*)l+3);
 		__m128i r4 = _mm_loadu_si128((const __m128i*)r+3);
-		__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1));
-		__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(l2, r2));
-		__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(l3, r3));
-		__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(l4, r4));
+		__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1)));
+		__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(fold_case_sse2(l2), fold_case_sse2(r2)));
+		__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(fold_case_sse2(l3), fold_case_sse2(r3)));
+		__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(fold_case_sse2(l4), fold_case_sse2(r4)));
 		if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(n1, n2), _mm_and_si128(n3, n4))) != 0xffff) {
 			int o;
 			if ((o = _mm_movemask_epi8(n1)) != 0xffff)
@@ -85,8 +85,8 @@ static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
 		__m128i r1 = _mm_loadu_si128((const __m128i*)r);
 		__m128i l2 = _mm_loadu_si128((const __m128i*)l+1);
 		__m128i r2 = _mm_loadu_si128((const __m128i*)r+1);
-		__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1));
-		__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(l2, r2));
+		__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1)));
+		__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(fold_case_sse2(l2), fold_case_sse2(r2)));
 		if (_mm_movemask_epi8(_mm_and_si128(n1, n2)) != 0xffff) {
 			int o;
 			if ((o = _mm_movemask_epi8(n1)) != 0xffff)
@@ -103,7 +103,7 @@ static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
 	if (padding >= 16 && n >= 16) {
 		__m128i l1 = _mm_loadu_si128((const __m128i*)l);
 		__m128i r1 = _mm_loadu_si128((const __m128i*)r);
-		int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1)));
+		int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1))));
 		if (o != 0xffff) {
 			o = trailing_zeros(~o);
 			return l-s1+o;
@@ -114,7 +114,7 @@ static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
 		padding -= 16;
 	}
 	while (padding && n) {
-		if (!*l || *l != *r)
+		if (!*l || fold_case(*l) != fold_case(*r))
 			return l-s1;
 		l++;
 		r++;
@@ -131,10 +131,10 @@ static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
 			__m128i r3 = _mm_load_si128((const __m128i*)r+2);
 			__m128i l4 = _mm_load_si128((const __m128i*)l+3);
 			__m128i r4 = _mm_load_si128((const __m128i*)r+3);
-			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1));
-			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(l2, r2));
-			__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(l3, r3));
-			__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(l4, r4));
+			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1)));
+			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(fold_case_sse2(l2), fold_case_sse2(r2)));
+			__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(fold_case_sse2(l3), fold_case_sse2(r3)));
+			__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(fold_case_sse2(l4), fold_case_sse2(r4)));
 			if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(n1, n2), _mm_and_si128(n3, n4))) != 0xffff) {
 				int o;
 				if ((o = _mm_movemask_epi8(n1)) != 0xffff)
@@ -166,10 +166,10 @@ static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
 			__m128i r3 = _mm_loadu_si128((const __m128i*)r+2);
 			__m128i l4 = _mm_loadu_si128((const __m128i*)l+3);
 			__m128i r4 = _mm_loadu_si128((const __m128i*)r+3);
-			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1));
-			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(l2, r2));
-			__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(l3, r3));
-			__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(l4, r4));
+			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1)));
+			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(fold_case_sse2(l2), fold_case_sse2(r2)));
+			__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(fold_case_sse2(l3), fold_case_sse2(r3)));
+			__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(fold_case_sse2(l4), fold_case_sse2(r4)));
 			if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(n1, n2), _mm_and_si128(n3, n4))) != 0xffff) {
 				int o;
 				if ((o = _mm_movemask_epi8(n1)) != 0xffff)
@@ -192,8 +192,8 @@ static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
 			__m128i r1 = _mm_loadu_si128((const __m128i*)r);
 			__m128i l2 = _mm_loadu_si128((const __m128i*)l+1);
 			__m128i r2 = _mm_loadu_si128((const __m128i*)r+1);
-			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1));
-			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(l2, r2));
+			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1)));
+			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(fold_case_sse2(l2), fold_case_sse2(r2)));
 			if (_mm_movemask_epi8(_mm_and_si128(n1, n2)) != 0xffff) {
 				int o;
 				if ((o = _mm_movemask_epi8(n1)) != 0xffff)
@@ -210,7 +210,7 @@ static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
 		if (padding >= 16 && n >= 16) {
 			__m128i l1 = _mm_loadu_si128((const __m128i*)l);
 			__m128i r1 = _mm_loadu_si128((const __m128i*)r);
-			int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1)));
+			int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1))));
 			if (o != 0xffff) {
 				o = trailing_zeros(~o);
 				return l-s1+o;
@@ -221,7 +221,7 @@ static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
 			padding -= 16;
 		}
 		while (padding && n) {
-			if (!*l || *l != *r)
+			if (!*l || fold_case(*l) != fold_case(*r))
 				return l-s1;
 			l++;
 			r++;
@@ -234,7 +234,7 @@ static size_t strdiff_sse2(const char *s1, const char *s2, size_t n)
 }
 
 __attribute__((__target__("avx2")))
-static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
+static size_t casediff_avx2(const char *s1, const char *s2, size_t n)
 {
 	const size_t padding1 = 127 - ((uintptr_t)(s1-1) % 128);
 	const size_t padding2 = 127 - ((uintptr_t)(s2-1) % 128);
@@ -248,8 +248,8 @@ static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
 		__m256i r1 = _mm256_loadu_si256((const __m256i*)r);
 		__m256i l2 = _mm256_loadu_si256((const __m256i*)l+1);
 		__m256i r2 = _mm256_loadu_si256((const __m256i*)r+1);
-		__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(l1, r1));
-		__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(l2, r2));
+		__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(fold_case_avx2(l1), fold_case_avx2(r1)));
+		__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(fold_case_avx2(l2), fold_case_avx2(r2)));
 		if (_mm256_movemask_epi8(_mm256_and_si256(n1, n2)) != -1) {
 			int o;
 			if ((o = _mm256_movemask_epi8(n1)) != -1)
@@ -266,7 +266,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
 	if (padding >= 32 && n >= 32) {
 		__m256i l1 = _mm256_loadu_si256((const __m256i*)l);
 		__m256i r1 = _mm256_loadu_si256((const __m256i*)r);
-		int o = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(l1, r1)));
+		int o = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(fold_case_avx2(l1), fold_case_avx2(r1))));
 		if (o != -1) {
 			o = trailing_zeros(~o);
 			return l-s1+o;
@@ -279,7 +279,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
 	if (padding >= 16 && n >= 16) {
 		__m128i l1 = _mm_loadu_si128((const __m128i*)l);
 		__m128i r1 = _mm_loadu_si128((const __m128i*)r);
-		int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero128), _mm_cmpeq_epi8(l1, r1)));
+		int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero128), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1))));
 		if (o != 0xffff) {
 			o = trailing_zeros(~o);
 			return l-s1+o;
@@ -290,7 +290,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
 		padding -= 16;
 	}
 	while (padding && n) {
-		if (!*l || *l != *r)
+		if (!*l || fold_case(*l) != fold_case(*r))
 			return l-s1;
 		l++;
 		r++;
@@ -309,10 +309,10 @@ static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
 			__m256i r4 = _mm256_load_si256((const __m256i*)r+3);
 			_mm_prefetch(l+256, _MM_HINT_NTA);
 			_mm_prefetch(r+256, _MM_HINT_NTA);
-			__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(l1, r1));
-			__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(l2, r2));
-			__m256i n3 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l3, zero), _mm256_cmpeq_epi8(l3, r3));
-			__m256i n4 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l4, zero), _mm256_cmpeq_epi8(l4, r4));
+			__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(fold_case_avx2(l1), fold_case_avx2(r1)));
+			__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(fold_case_avx2(l2), fold_case_avx2(r2)));
+			__m256i n3 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l3, zero), _mm256_cmpeq_epi8(fold_case_avx2(l3), fold_case_avx2(r3)));
+			__m256i n4 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l4, zero), _mm256_cmpeq_epi8(fold_case_avx2(l4), fold_case_avx2(r4)));
 			if (_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(n1, n2), _mm256_and_si256(n3, n4))) != -1) {
 				int o;
 				if ((o = _mm256_movemask_epi8(n1)) != -1)
@@ -340,8 +340,8 @@ static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
 			__m256i r1 = _mm256_loadu_si256((const __m256i*)r);
 			__m256i l2 = _mm256_loadu_si256((const __m256i*)l+1);
 			__m256i r2 = _mm256_loadu_si256((const __m256i*)r+1);
-			__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(l1, r1));
-			__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(l2, r2));
+			__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(fold_case_avx2(l1), fold_case_avx2(r1)));
+			__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(fold_case_avx2(l2), fold_case_avx2(r2)));
 			if (_mm256_movemask_epi8(_mm256_and_si256(n1, n2)) != -1) {
 				int o;
 				if ((o = _mm256_movemask_epi8(n1)) != -1)
@@ -358,7 +358,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
 		if (padding >= 32 && n >= 32) {
 			__m256i l1 = _mm256_loadu_si256((const __m256i*)l);
 			__m256i r1 = _mm256_loadu_si256((const __m256i*)r);
-			int o = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(l1, r1)));
+			int o = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(fold_case_avx2(l1), fold_case_avx2(r1))));
 			if (o != -1) {
 				o = trailing_zeros(~o);
 				return l-s1+o;
@@ -371,7 +371,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
 		if (padding >= 16 && n >= 16) {
 			__m128i l1 = _mm_loadu_si128((const __m128i*)l);
 			__m128i r1 = _mm_loadu_si128((const __m128i*)r);
-			int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero128), _mm_cmpeq_epi8(l1, r1)));
+			int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero128), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1))));
 			if (o != 0xffff) {
 				o = trailing_zeros(~o);
 				return l-s1+o;
@@ -382,7 +382,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
 			padding -= 16;
 		}
 		while (padding && n) {
-			if (!*l || *l != *r)
+			if (!*l || fold_case(*l) != fold_case(*r))
 				return l-s1;
 			l++;
 			r++;
@@ -394,55 +394,80 @@ static size_t strdiff_avx2(const char *s1, const char *s2, size_t n)
 	}
 }
 
-static size_t strdiff_auto(const char *s1, const char *s2, size_t n);
+__attribute__((__target__("avx512bw,avx512vl")))
+static size_t casediff_avx512(const char *s1, const char *s2, size_t n)
+{
+	const char *l = s1;
+	const char *r = s2;
+	while (n) {
+		/* bytes that can be read from both strings without crossing a page */
+		size_t padding1 = 4096 - (uintptr_t)l % 4096;
+		size_t padding2 = 4096 - (uintptr_t)r % 4096;
+		size_t padding = padding1 < padding2 ? padding1 : padding2;
+		if (padding > n)
+			padding = n;
+		n -= padding;
+		while (padding >= 128) {
+			__m512i l1 = _mm512_loadu_si512(l);
+			__m512i l2 = _mm512_loadu_si512(l+64);
+			__m512i r1 = _mm512_loadu_si512(r);
+			__m512i r2 = _mm512_loadu_si512(r+64);
+			uint64_t m1 = _mm512_cmpneq_epi8_mask(fold_case_avx512(l1), fold_case_avx512(r1)) | _mm512_testn_epi8_mask(l1, l1);
+			uint64_t m2 = _mm512_cmpneq_epi8_mask(fold_case_avx512(l2), fold_case_avx512(r2)) | _mm512_testn_epi8_mask(l2, l2);
+			if (m1 | m2)
+				return l-s1 + (m1 ? trailing_zeros64(m1) : trailing_zeros64(m2) + 64);
+			l += 128;
+			r += 128;
+			padding -= 128;
+		}
+		while (padding) {
+			size_t len = padding < 64 ? padding : 64;
+			__mmask64 k = len == 64 ? ~(uint64_t)0 : ((uint64_t)1 << len) - 1;
+			__m512i l1 = _mm512_maskz_loadu_epi8(k, l);
+			__m512i r1 = _mm512_maskz_loadu_epi8(k, r);
+			uint64_t m = (_mm512_cmpneq_epi8_mask(fold_case_avx512(l1), fold_case_avx512(r1)) | _mm512_testn_epi8_mask(l1, l1)) & k;
+			if (m)
+				return l-s1 + trailing_zeros64(m);
+			l += len;
+			r += len;
+			padding -= len;
+		}
+	}
+	return l-s1-1;
+}
 
-static size_t (*strdiff_impl)(const char *s1, const char *s2, size_t n) = strdiff_auto;
+static size_t casediff_auto(const char *s1, const char *s2, size_t n);
 
-static size_t strdiff_auto(const char *s1, const char *s2, size_t n) {
-	if (has_avx2())
-		strdiff_impl = strdiff_avx2;
+static size_t (*casediff_impl)(const char *s1, const char *s2, size_t n) = casediff_auto;
+
+__attribute__((visibility("hidden")))
+void __strncasecmp_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		casediff_impl = casediff_avx512;
+	else if (has_avx2())
+		casediff_impl = casediff_avx2;
 	else if (has_sse2())
-		strdiff_impl = strdiff_sse2;
+		casediff_impl = casediff_sse2;
 	else
-		strdiff_impl = strdiff_naive;
-	return strdiff_impl(s1, s2, n);
+		casediff_impl = casediff_naive;
+}
+
+static size_t casediff_auto(const char *s1, const char *s2, size_t n) {
+	__strncasecmp_resolve();
+	return casediff_impl(s1, s2, n);
 }
 
+/* the kernels return n-1 when the first n bytes match */
 int strncasecmp(const char *s1, const char *s2, size_t n) {
-	for (;;) {
-		if (!n)
-			return 0;
-		size_t o = strdiff_impl(s1, s2, n);
-		s1 += o;
-		s2 += o;
-		n -= o;
-		if (tolower(*s1) != tolower(*s2))
-			return tolower(*s1) - tolower(*s2);
-		if (*s1 == 0)
-			return 0;
-		s1++;
-		s2++;
-		n--;
-	}
+	if (!n)
+		return 0;
+	size_t o = casediff_impl(s1, s2, n);
+	return fold_case(s1[o]) - fold_case(s2[o]);
 }
 
 int __strncasecmp_l(const char *l, const char *r, size_t n, locale_t loc)
 {
-	for (;;) {
-		if (!n)
-			return 0;
-		size_t o = strdiff_impl(l, r, n);
-		l += o;
-		r += o;
-		n -= o;
-		if (tolower_l(*l, loc) != tolower_l(*r, loc))
-			return tolower_l(*l, loc) - tolower_l(*r, loc);
-		if (*l == 0)
-			return 0;
-		l++;
-		r++;
-		n--;
-	}
+	return strncasecmp(l, r, n);
 }
 
 weak_alias(__strncasecmp_l, strncasecmp_l);
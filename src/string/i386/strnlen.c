@@ -0,0 +1,170 @@
+#include <string.h>
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "helpers.h"
+
+static size_t strnlen_fallback(const char *s, size_t n) {
+	const char *p = memchr(s, 0, n);
+	return p ? p-s : n;
+}
+
+/* a terminator found in the last block may lie past the bound */
+static inline size_t clamp(size_t len, size_t n) {
+	return len < n ? len : n;
+}
+
+/*
+ * The kernels only use aligned loads, and every block they read starts
+ * before s+n, so each one holds at least one byte the caller vouched
+ * for. The unrolled loops first align to their full stride so that the
+ * four blocks never straddle a page.
+ */
+
+__attribute__((__target__("sse2")))
+static size_t strnlen_sse2(const char *s, size_t n) {
+	if (!n)
+		return 0;
+	size_t off = (size_t)s % 16;
+	const __m128i *ptr = (const __m128i*)(s - off);
+	__m128i zero = _mm_set1_epi8(0);
+	uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(ptr), zero)) >> off;
+	if (mask)
+		return clamp(trailing_zeros(mask), n);
+	/* bytes of s checked so far */
+	size_t len = 16 - off;
+	ptr++;
+	while (len < n && (size_t)ptr % 64) {
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(ptr), zero));
+		if (mask)
+			return clamp(len + trailing_zeros(mask), n);
+		ptr++;
+		len += 16;
+	}
+	while (len < n && n - len >= 64) {
+		__m128i a = _mm_load_si128(ptr);
+		__m128i b = _mm_load_si128(ptr+1);
+		__m128i c = _mm_load_si128(ptr+2);
+		__m128i d = _mm_load_si128(ptr+3);
+		__m128i min = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(min, zero)))
+			break;
+		ptr += 4;
+		len += 64;
+	}
+	while (len < n) {
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(ptr), zero));
+		if (mask)
+			return clamp(len + trailing_zeros(mask), n);
+		ptr++;
+		len += 16;
+	}
+	return n;
+}
+
+__attribute__((__target__("avx2")))
+static size_t strnlen_avx2(const char *s, size_t n) {
+	if (!n)
+		return 0;
+	size_t off = (size_t)s % 32;
+	const __m256i *ptr = (const __m256i*)(s - off);
+	__m256i zero = _mm256_set1_epi8(0);
+	uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(ptr), zero)) >> off;
+	if (mask)
+		return clamp(trailing_zeros(mask), n);
+	size_t len = 32 - off;
+	ptr++;
+	while (len < n && (size_t)ptr % 128) {
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(ptr), zero));
+		if (mask)
+			return clamp(len + trailing_zeros(mask), n);
+		ptr++;
+		len += 32;
+	}
+	while (len < n && n - len >= 128) {
+		__m256i a = _mm256_load_si256(ptr);
+		__m256i b = _mm256_load_si256(ptr+1);
+		__m256i c = _mm256_load_si256(ptr+2);
+		__m256i d = _mm256_load_si256(ptr+3);
+		__m256i min = _mm256_min_epu8(_mm256_min_epu8(a, b), _mm256_min_epu8(c, d));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(min, zero)))
+			break;
+		ptr += 4;
+		len += 128;
+	}
+	while (len < n) {
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(ptr), zero));
+		if (mask)
+			return clamp(len + trailing_zeros(mask), n);
+		ptr++;
+		len += 32;
+	}
+	return n;
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static size_t strnlen_avx512(const char *s, size_t n) {
+	if (!n)
+		return 0;
+	size_t off = (size_t)s % 64;
+	const __m512i *ptr = (const __m512i*)(s - off);
+	__m512i x = _mm512_load_si512(ptr);
+	uint64_t mask = _mm512_testn_epi8_mask(x, x) >> off;
+	if (mask)
+		return clamp(trailing_zeros64(mask), n);
+	size_t len = 64 - off;
+	ptr++;
+	while (len < n && (size_t)ptr % 256) {
+		x = _mm512_load_si512(ptr);
+		mask = _mm512_testn_epi8_mask(x, x);
+		if (mask)
+			return clamp(len + trailing_zeros64(mask), n);
+		ptr++;
+		len += 64;
+	}
+	while (len < n && n - len >= 256) {
+		__m512i a = _mm512_load_si512(ptr);
+		__m512i b = _mm512_load_si512(ptr+1);
+		__m512i c = _mm512_load_si512(ptr+2);
+		__m512i d = _mm512_load_si512(ptr+3);
+		__m512i min = _mm512_min_epu8(_mm512_min_epu8(a, b), _mm512_min_epu8(c, d));
+		if (_mm512_testn_epi8_mask(min, min))
+			break;
+		ptr += 4;
+		len += 256;
+	}
+	while (len < n) {
+		x = _mm512_load_si512(ptr);
+		mask = _mm512_testn_epi8_mask(x, x);
+		if (mask)
+			return clamp(len + trailing_zeros64(mask), n);
+		ptr++;
+		len += 64;
+	}
+	return n;
+}
+
+static size_t strnlen_auto(const char *s, size_t n);
+
+static size_t (*strnlen_impl)(const char *s, size_t n) = strnlen_auto;
+
+__attribute__((visibility("hidden")))
+void __strnlen_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		strnlen_impl = strnlen_avx512;
+	else if (has_avx2())
+		strnlen_impl = strnlen_avx2;
+	else if (has_sse2())
+		strnlen_impl = strnlen_sse2;
+	else
+		strnlen_impl = strnlen_fallback;
+}
+
+static size_t strnlen_auto(const char *s, size_t n) {
+	__strnlen_resolve();
+	return strnlen_impl(s, n);
+}
+
+size_t strnlen(const char *s, size_t n) {
+	return strnlen_impl(s, n);
+}
@@ -47,7 +47,7 @@ static void* strrchr_fallback(const void *haystack, int n) {
 		size_t m = *(const size_t*)haystack ^ repeated_n;
 		if ((((m-lowbits) & ~m) | ((*(const size_t*)haystack-lowbits) & ~*(const size_t*)haystack)) & highbits) {
 			for (size_t i = 0; i < sizeof(size_t); i++) {
-				if (*((char*)haystack+i) == n)
+				if (*((unsigned char*)haystack+i) == n)
 					pn = (char*)haystack+i;
 				if (*((char*)haystack+i) == 0)
 					return pn;
@@ -74,7 +74,7 @@ static void* strrchr_sse2(const void *haystack, int n) {
 		size_t m = *(const uint32_t*)haystack ^ repeated_n;
 		if ((((m-lowbits) & ~m) | ((*(const uint32_t*)haystack-lowbits) & ~*(const uint32_t*)haystack)) & highbits) {
 			for (int i = 0; i < 4; i++) {
-				if (*((char*)haystack+i) == n)
+				if (*((unsigned char*)haystack+i) == n)
 					pn = (char*)haystack+i;
 				if (*((char*)haystack+i) == 0)
 					return pn;
@@ -154,7 +154,7 @@ static void* strrchr_avx2(const void *haystack, int n) {
 		size_t m = *(const uint32_t*)haystack ^ repeated_n;
 		if ((((m-lowbits) & ~m) | ((*(const uint32_t*)haystack-lowbits) & ~*(const uint32_t*)haystack)) & highbits) {
 			for (int i = 0; i < 4; i++) {
-				if (*((char*)haystack+i) == n)
+				if (*((unsigned char*)haystack+i) == n)
 					pn = (char*)haystack+i;
 				if (*((char*)haystack+i) == 0)
 					return pn;
@@ -219,20 +219,57 @@ static void* strrchr_avx2(const void *haystack, int n) {
 	}
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static void* strrchr_avx512(const void *haystack, int n) {
+	char *pn = NULL;
+	size_t off = (size_t)haystack % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)haystack - off);
+	__m512i vn = _mm512_set1_epi8(n);
+	__m512i x = _mm512_load_si512(ptr);
+	uint64_t mask1 = _mm512_cmpeq_epi8_mask(x, vn) >> off << off;
+	uint64_t mask2 = _mm512_testn_epi8_mask(x, x) >> off << off;
+	for (;;) {
+		if (mask2) {
+			/* keep matches up to and including the terminator */
+			mask1 &= mask2 ^ (mask2 - 1);
+			if (mask1)
+				return (char*)ptr + 63 - leading_zeros64(mask1);
+			return pn;
+		}
+		if (mask1)
+			pn = (char*)ptr + 63 - leading_zeros64(mask1);
+		ptr++;
+		x = _mm512_load_si512(ptr);
+		mask1 = _mm512_cmpeq_epi8_mask(x, vn);
+		mask2 = _mm512_testn_epi8_mask(x, x);
+	}
+}
+
 static void *strrchr_auto(const void *s, int c);
 
 static void *(*strrchr_impl)(const void *s, int c) = strrchr_auto;
 
-static void *strrchr_auto(const void *s, int c) {
-	if (has_avx2())
+__attribute__((visibility("hidden")))
+void __strrchr_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		strrchr_impl = strrchr_avx512;
+	else if (has_avx2())
 		strrchr_impl = strrchr_avx2;
 	else if (has_sse2())
 		strrchr_impl = strrchr_sse2;
 	else
 		strrchr_impl = strrchr_fallback;
+}
+
+static void *strrchr_auto(const void *s, int c) {
+	__strrchr_resolve();
 	return strrchr_impl(s, c);
 }
 
 char *strrchr(const char *s, int c) {
+	c = (unsigned char)c;
+	/* the kernels only ever see the terminator as the end of the string */
+	if (!c)
+		return (char *)s + strlen(s);
 	return strrchr_impl(s, c);
 }
@@ -32,7 +32,8 @@
 #include "helpers.h"
 
 static char* strspn1_fallback(const void *haystack, int n) {
-	while ((size_t)haystack % sizeof(size_t)) {
+	/* the loop reads two words at a time, so align to the pair */
+	while ((size_t)haystack % (2*sizeof(size_t))) {
 		if (*(unsigned char*)haystack != n)
 			return (void*)haystack;
 		haystack = (char*)haystack + 1;
@@ -81,8 +82,8 @@ static char* strspn1_sse2(const void *haystack, int n) {
 		__m128i b = _mm_load_si128((__m128i*)haystack + 1);
 		__m128i eqa = _mm_cmpeq_epi8(a, vn);
 		__m128i eqb = _mm_cmpeq_epi8(b, vn);
-		__m128i or1 = _mm_or_si128(eqa, eqb);
-		if (_mm_movemask_epi8(or1) != 0xffff) {
+		__m128i and1 = _mm_and_si128(eqa, eqb);
+		if (_mm_movemask_epi8(and1) != 0xffff) {
 			int mask = _mm_movemask_epi8(eqa);
 			if (mask != 0xffff)
 				return (char*)haystack + trailing_zeros(~mask);
@@ -97,16 +98,16 @@ static char* strspn1_sse2(const void *haystack, int n) {
 		__m128i b = _mm_load_si128(ptr+1);
 		__m128i eqa = _mm_cmpeq_epi8(vn, a);
 		__m128i eqb = _mm_cmpeq_epi8(vn, b);
-		__m128i or1 = _mm_or_si128(eqa, eqb);
+		__m128i and1 = _mm_and_si128(eqa, eqb);
 
 		__m128i c = _mm_load_si128(ptr+2);
 		__m128i d = _mm_load_si128(ptr+3);
 		__m128i eqc = _mm_cmpeq_epi8(vn, c);
 		__m128i eqd = _mm_cmpeq_epi8(vn, d);
-		__m128i or2 = _mm_or_si128(eqc, eqd);
+		__m128i and2 = _mm_and_si128(eqc, eqd);
 
-		__m128i or3 = _mm_or_si128(or1, or2);
-		if (_mm_movemask_epi8(or3) != 0xffff) {
+		__m128i and3 = _mm_and_si128(and1, and2);
+		if (_mm_movemask_epi8(and3) != 0xffff) {
 			int mask;
 			if ((mask = _mm_movemask_epi8(eqa)) != 0xffff)
 				return (char*)ptr + trailing_zeros(~mask);
@@ -154,7 +155,7 @@ static char* strspn1_avx2(const void *haystack, int n) {
 		__m256i b = _mm256_load_si256((__m256i*)haystack + 1);
 		__m256i eqa = _mm256_cmpeq_epi8(a, vn);
 		__m256i eqb = _mm256_cmpeq_epi8(b, vn);
-		if (_mm256_movemask_epi8(_mm256_or_si256(eqa, eqb)) != -1) {
+		if (_mm256_movemask_epi8(_mm256_and_si256(eqa, eqb)) != -1) {
 			int mask = _mm256_movemask_epi8(eqa);
 			if (mask != -1)
 				return (char*)haystack + trailing_zeros(~mask);
@@ -170,16 +171,16 @@ static char* strspn1_avx2(const void *haystack, int n) {
 		__m256i b = _mm256_load_si256(ptr+1);
 		__m256i eqa = _mm256_cmpeq_epi8(vn, a);
 		__m256i eqb = _mm256_cmpeq_epi8(vn, b);
-		__m256i or1 = _mm256_or_si256(eqa, eqb);
+		__m256i and1 = _mm256_and_si256(eqa, eqb);
 
 		__m256i c = _mm256_load_si256(ptr+2);
 		__m256i d = _mm256_load_si256(ptr+3);
 		__m256i eqc = _mm256_cmpeq_epi8(vn, c);
 		__m256i eqd = _mm256_cmpeq_epi8(vn, d);
-		__m256i or2 = _mm256_or_si256(eqc, eqd);
+		__m256i and2 = _mm256_and_si256(eqc, eqd);
 
-		__m256i or3 = _mm256_or_si256(or1, or2);
-		if (_mm256_movemask_epi8(or3) != -1) {
+		__m256i and3 = _mm256_and_si256(and1, and2);
+		if (_mm256_movemask_epi8(and3) != -1) {
 			int mask;
 			if ((mask = _mm256_movemask_epi8(eqa)) != -1)
 				return (char*)ptr + trailing_zeros(~mask);
@@ -273,15 +274,15 @@ static char* strspn2_sse2(const void *haystack, int n1, int n2) {
 		__m128i eqb1 = _mm_cmpeq_epi8(vn1, b);
 		__m128i eqa2 = _mm_cmpeq_epi8(vn2, a);
 		__m128i eqb2 = _mm_cmpeq_epi8(vn2, b);
-		__m128i or1 = _mm_or_si128(eqa1, eqb1);
-		__m128i or2 = _mm_or_si128(eqa2, eqb2);
-		__m128i or3 = _mm_or_si128(or1, or2);
+		__m128i or1 = _mm_or_si128(eqa1, eqa2);
+		__m128i or2 = _mm_or_si128(eqb1, eqb2);
+		__m128i and3 = _mm_and_si128(or1, or2);
 
-		if (_mm_movemask_epi8(or3) != 0xffff) {
+		if (_mm_movemask_epi8(and3) != 0xffff) {
 			int mask1, mask2;
 			mask1 = _mm_movemask_epi8(eqa1);
 			mask2 = _mm_movemask_epi8(eqa2);
-			if (mask1 != 0xffff || mask2 != 0xffff)
+			if ((mask1 | mask2) != 0xffff)
 				return (char*)ptr + trailing_zeros(~mask1 & ~mask2);
 			mask1 = _mm_movemask_epi8(eqb1);
 			mask2 = _mm_movemask_epi8(eqb2);
@@ -344,13 +345,13 @@ static char* strspn2_avx2(const void *haystack, int n1, int n2) {
 		__m256i eqb2 = _mm256_cmpeq_epi8(vn2, b);
 		__m256i or1 = _mm256_or_si256(eqa1, eqa2);
 		__m256i or2 = _mm256_or_si256(eqb1, eqb2);
-		__m256i or3 = _mm256_and_si256(or1, or2);
+		__m256i and3 = _mm256_and_si256(or1, or2);
 
-		if (_mm256_movemask_epi8(or3) != -1) {
+		if (_mm256_movemask_epi8(and3) != -1) {
 			int mask1, mask2;
 			mask1 = _mm256_movemask_epi8(eqa1);
 			mask2 = _mm256_movemask_epi8(eqa2);
-			if (mask1 != -1 || mask2 != -1)
+			if ((mask1 | mask2) != -1)
 				return (char*)ptr + trailing_zeros(~mask1 & ~mask2);
 			mask1 = _mm256_movemask_epi8(eqb1);
 			mask2 = _mm256_movemask_epi8(eqb2);
@@ -360,35 +361,147 @@ static char* strspn2_avx2(const void *haystack, int n1, int n2) {
 	}
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static char* strspn1_avx512(const void *haystack, int n) {
+	size_t off = (size_t)haystack % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)haystack - off);
+	__m512i vn = _mm512_set1_epi8(n);
+	uint64_t mask = _mm512_cmpneq_epi8_mask(_mm512_load_si512(ptr), vn) >> off;
+	if (mask)
+		return (char*)haystack + trailing_zeros64(mask);
+	ptr++;
+	if ((size_t)ptr % 128) {
+		mask = _mm512_cmpneq_epi8_mask(_mm512_load_si512(ptr), vn);
+		if (mask)
+			return (char*)ptr + trailing_zeros64(mask);
+		ptr++;
+	}
+	for (;;) {
+		uint64_t ma = _mm512_cmpneq_epi8_mask(_mm512_load_si512(ptr), vn);
+		uint64_t mb = _mm512_cmpneq_epi8_mask(_mm512_load_si512(ptr+1), vn);
+		if (ma | mb) {
+			if (ma)
+				return (char*)ptr + trailing_zeros64(ma);
+			return (char*)(ptr+1) + trailing_zeros64(mb);
+		}
+		ptr += 2;
+	}
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static char* strspn2_avx512(const void *haystack, int n1, int n2) {
+	size_t off = (size_t)haystack % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)haystack - off);
+	__m512i vn1 = _mm512_set1_epi8(n1);
+	__m512i vn2 = _mm512_set1_epi8(n2);
+	__m512i x = _mm512_load_si512(ptr);
+	uint64_t mask = ~(_mm512_cmpeq_epi8_mask(x, vn1) | _mm512_cmpeq_epi8_mask(x, vn2)) >> off;
+	if (mask)
+		return (char*)haystack + trailing_zeros64(mask);
+	ptr++;
+	for (;;) {
+		x = _mm512_load_si512(ptr);
+		mask = ~(_mm512_cmpeq_epi8_mask(x, vn1) | _mm512_cmpeq_epi8_mask(x, vn2));
+		if (mask)
+			return (char*)ptr + trailing_zeros64(mask);
+		ptr++;
+	}
+}
+
+static size_t strspnN_fallback(const char *s, const char *accept) {
+	uint64_t byteset[4] = {0};
+	while (*accept) {
+		byteset[(unsigned char)*accept/64] |= (uint64_t)1 << (unsigned char)*accept%64;
+		accept++;
+	}
+	size_t i = 0;
+	while (byteset[(unsigned char)s[i]/64] & (uint64_t)1 << (unsigned char)s[i]%64)
+		i++;
+	return i;
+}
+
+__attribute__((__target__("avx2")))
+static size_t strspnN_avx2(const char *s, const char *accept) {
+	unsigned char table[32];
+	byteset_nibbles(table, accept);
+	__m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table));
+	__m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table+1));
+	size_t off = (size_t)s % 32;
+	const __m256i *ptr = (const __m256i*)(s - off);
+	uint32_t mask = ~byteset_match_avx2(_mm256_load_si256(ptr), lo, hi) >> off;
+	if (mask)
+		return trailing_zeros(mask);
+	for (;;) {
+		ptr++;
+		mask = ~byteset_match_avx2(_mm256_load_si256(ptr), lo, hi);
+		if (mask)
+			return (const char*)ptr + trailing_zeros(mask) - s;
+	}
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static size_t strspnN_avx512(const char *s, const char *accept) {
+	unsigned char table[32];
+	byteset_nibbles(table, accept);
+	__m512i lo = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)table));
+	__m512i hi = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)table+1));
+	size_t off = (size_t)s % 64;
+	const __m512i *ptr = (const __m512i*)(s - off);
+	uint64_t mask = ~byteset_match_avx512(_mm512_load_si512(ptr), lo, hi) >> off;
+	if (mask)
+		return trailing_zeros64(mask);
+	for (;;) {
+		ptr++;
+		mask = ~byteset_match_avx512(_mm512_load_si512(ptr), lo, hi);
+		if (mask)
+			return (const char*)ptr + trailing_zeros64(mask) - s;
+	}
+}
+
 static char *strspn1_auto(const void *, int);
 static char *strspn2_auto(const void *, int, int);
+static size_t strspnN_auto(const char *, const char *);
 
 static char *(*strspn1_impl)(const void *, int) = strspn1_auto;
 static char *(*strspn2_impl)(const void *, int, int) = strspn2_auto;
+static size_t (*strspnN_impl)(const char *, const char *) = strspnN_auto;
 
-static void strspn_init() {
-	if (has_avx2()) {
+__attribute__((visibility("hidden")))
+void __strspn_resolve(void) {
+	if (has_avx512bw() && has_avx512vl()) {
+		strspn1_impl = strspn1_avx512;
+		strspn2_impl = strspn2_avx512;
+		strspnN_impl = strspnN_avx512;
+	}
+	else if (has_avx2()) {
 		strspn1_impl = strspn1_avx2;
 		strspn2_impl = strspn2_avx2;
+		strspnN_impl = strspnN_avx2;
 	}
 	else if (has_sse2()) {
 		strspn1_impl = strspn1_sse2;
 		strspn2_impl = strspn2_sse2;
+		strspnN_impl = strspnN_fallback;
 	}
 	else {
 		strspn1_impl = strspn1_fallback;
 		strspn2_impl = strspn2_fallback;
+		strspnN_impl = strspnN_fallback;
 	}
 }
 
 static char *strspn1_auto(const void *haystack, int n1) {
-	strspn_init();
+	__strspn_resolve();
 	return strspn1_impl(haystack, n1);
 }
 static char *strspn2_auto(const void *haystack, int n1, int n2) {
-	strspn_init();
+	__strspn_resolve();
 	return strspn2_impl(haystack, n1, n2);
 }
+static size_t strspnN_auto(const char *s, const char *accept) {
+	__strspn_resolve();
+	return strspnN_impl(s, accept);
+}
 
 size_t strspn(const char *s, const char *accept) {
 	if (!accept[0])
@@ -397,13 +510,5 @@ size_t strspn(const char *s, const char *accept) {
 		return strspn1_impl(s, (unsigned char)accept[0]) - s;
 	else if (!accept[2])
 		return strspn2_impl(s, (unsigned char)accept[0], (unsigned char)accept[1]) - s;
-	uint64_t byteset[4] = {0};
-	while (*accept) {
-		byteset[(unsigned char)*accept/64] |= (uint64_t)1 << (unsigned char)*accept%64;
-		accept++;
-	}
-	size_t i = 0;
-	while (byteset[(unsigned char)s[i]/64] & (uint64_t)1 << (unsigned char)s[i]%64)
-		i++;
-	return i;
+	return strspnN_impl(s, accept);
 }
@@ -30,6 +30,7 @@
 #include <immintrin.h>
 
 #include "cpu_features.h"
+#include "helpers.h"
 
 static char *strstr2(const uint8_t *h, const uint8_t *n)
 {
@@ -319,84 +320,193 @@ static char *twoway_strstr(const unsigned char *h, const unsigned char *n)
 	}
 }
 
-char *strstr(const char *h, const char *n)
+static char *strstr_fallback(const uint8_t *h, const uint8_t *n)
 {
-	if (!n[0])
-		return (char*)h;
-	h = strchr(h, n[0]);
-	if (!h || !n[1])
-		return (char*)h;
 	if (!h[1])
 		return NULL;
 	if (!n[2])
-		return strstr2((void*)h, (void*)n);
+		return strstr2(h, n);
 	if (!h[2])
 		return NULL;
 	if (!n[3])
-		return strstr3((void*)h, (void*)n);
+		return strstr3(h, n);
 	if (!h[3])
 		return NULL;
 	if (!n[4])
-		return strstr4((void*)h, (void*)n);
+		return strstr4(h, n);
 	if (!h[4])
 		return NULL;
 	if (!n[5])
-		return strstr5((void*)h, (void*)n);
+		return strstr5(h, n);
 	if (!h[5])
 		return NULL;
 	if (!n[6])
-		return strstr6((void*)h, (void*)n);
+		return strstr6(h, n);
 	if (!h[6])
 		return NULL;
 	if (!n[7])
-		return strstr7((void*)h, (void*)n);
+		return strstr7(h, n);
 	if (!h[7])
 		return NULL;
 	if (!n[8])
-		return strstr8((void*)h, (void*)n);
+		return strstr8(h, n);
 	if (!h[8])
 		return NULL;
 	if (has_sse2()) {
 		if (!n[9])
-			return strstr9((void*)h, (void*)n);
+			return strstr9(h, n);
 		if (!h[9])
 			return NULL;
 		if (!n[10])
-			return strstr10((void*)h, (void*)n);
+			return strstr10(h, n);
 		if (!h[10])
 			return NULL;
 		if (!n[11])
-			return strstr11((void*)h, (void*)n);
+			return strstr11(h, n);
 		if (!h[11])
 			return NULL;
 		if (!n[12])
-			return strstr12((void*)h, (void*)n);
+			return strstr12(h, n);
 		if (!h[12])
 			return NULL;
 		if (!n[13])
-			return strstr13((void*)h, (void*)n);
+			return strstr13(h, n);
 		if (!h[13])
 			return NULL;
 		if (!n[14])
-			return strstr14((void*)h, (void*)n);
+			return strstr14(h, n);
 		if (!h[14])
 			return NULL;
 		if (!n[15])
-			return strstr15((void*)h, (void*)n);
+			return strstr15(h, n);
 		if (!h[15])
 			return NULL;
 		if (!n[16])
-			return strstr16((void*)h, (void*)n);
+			return strstr16(h, n);
 		if (!h[16])
 			return NULL;
 	}
-	size_t l = strnlen(n, 512);
+	size_t l = strnlen((const char*)n, 512);
 	if (l < 512) {
 		do
-			if (!strncmp(h, n, l))
+			if (!strncmp((const char*)h, (const char*)n, l))
 				return (char*)h;
 		while (*++h);
 		return NULL;
 	}
-	return twoway_strstr((void*)h, (void*)n);
+	return twoway_strstr(h, n);
+}
+
+/*
+ * Generic needles: candidates are positions where both the first and the
+ * last byte of the needle match. The last bytes are read with aligned loads
+ * so the scan never touches a page past the terminator; the first bytes lie
+ * at lower addresses and are already known to be valid. Candidates are
+ * verified with memcmp and the search falls back to two-way when
+ * verification dominates the scan, keeping the worst case linear.
+ */
+
+__attribute__((__target__("avx2")))
+static char *strstr_avx2(const uint8_t *h, const uint8_t *n)
+{
+	size_t l = strlen((const char*)n);
+	if (strnlen((const char*)h, l) < l)
+		return NULL;
+	const uint8_t *e = h + l - 1;
+	for (; (uintptr_t)e % 32; e++) {
+		if (!*e)
+			return NULL;
+		if (*e == n[l-1] && e[1-l] == n[0] && !memcmp(e + 2 - l, n + 1, l - 2))
+			return (char*)e + 1 - l;
+	}
+	__m256i first = _mm256_set1_epi8(n[0]);
+	__m256i last = _mm256_set1_epi8(n[l-1]);
+	__m256i zero = _mm256_set1_epi8(0);
+	size_t verified = 0;
+	for (;; e += 32) {
+		__m256i bl = _mm256_load_si256((const void*)e);
+		__m256i bf = _mm256_loadu_si256((const void*)(e + 1 - l));
+		__m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(bf, first), _mm256_cmpeq_epi8(bl, last));
+		uint32_t mask = _mm256_movemask_epi8(eq);
+		uint32_t zmask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(bl, zero));
+		if (zmask)
+			mask &= (zmask & -zmask) - 1;
+		while (mask) {
+			const uint8_t *c = e + 1 - l + trailing_zeros(mask);
+			if (!memcmp(c + 1, n + 1, l - 2))
+				return (char*)c;
+			verified += l;
+			mask &= mask - 1;
+		}
+		if (zmask)
+			return NULL;
+		if (verified > 4 * (size_t)(e - h) + 1024)
+			return twoway_strstr(e + 33 - l, n);
+	}
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static char *strstr_avx512(const uint8_t *h, const uint8_t *n)
+{
+	size_t l = strlen((const char*)n);
+	if (strnlen((const char*)h, l) < l)
+		return NULL;
+	const uint8_t *e = h + l - 1;
+	for (; (uintptr_t)e % 64; e++) {
+		if (!*e)
+			return NULL;
+		if (*e == n[l-1] && e[1-l] == n[0] && !memcmp(e + 2 - l, n + 1, l - 2))
+			return (char*)e + 1 - l;
+	}
+	__m512i first = _mm512_set1_epi8(n[0]);
+	__m512i last = _mm512_set1_epi8(n[l-1]);
+	size_t verified = 0;
+	for (;; e += 64) {
+		__m512i bl = _mm512_load_si512(e);
+		__m512i bf = _mm512_loadu_si512(e + 1 - l);
+		uint64_t mask = _mm512_mask_cmpeq_epi8_mask(_mm512_cmpeq_epi8_mask(bf, first), bl, last);
+		uint64_t zmask = _mm512_testn_epi8_mask(bl, bl);
+		if (zmask)
+			mask &= (zmask & -zmask) - 1;
+		while (mask) {
+			const uint8_t *c = e + 1 - l + trailing_zeros64(mask);
+			if (!memcmp(c + 1, n + 1, l - 2))
+				return (char*)c;
+			verified += l;
+			mask &= mask - 1;
+		}
+		if (zmask)
+			return NULL;
+		if (verified > 4 * (size_t)(e - h) + 1024)
+			return twoway_strstr(e + 65 - l, n);
+	}
+}
+
+static char *strstr_auto(const uint8_t *h, const uint8_t *n);
+
+static char *(*strstr_impl)(const uint8_t *h, const uint8_t *n) = strstr_auto;
+
+__attribute__((visibility("hidden")))
+void __strstr_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		strstr_impl = strstr_avx512;
+	else if (has_avx2())
+		strstr_impl = strstr_avx2;
+	else
+		strstr_impl = strstr_fallback;
+}
+
+static char *strstr_auto(const uint8_t *h, const uint8_t *n) {
+	__strstr_resolve();
+	return strstr_impl(h, n);
+}
+
+char *strstr(const char *h, const char *n)
+{
+	if (!n[0])
+		return (char*)h;
+	h = strchr(h, n[0]);
+	if (!h || !n[1])
+		return (char*)h;
+	return strstr_impl((void*)h, (void*)n);
 }
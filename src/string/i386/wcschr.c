@@ -0,0 +1,103 @@
+#include <wchar.h>
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "helpers.h"
+
+static wchar_t *wcschr_fallback(const wchar_t *s, wchar_t c) {
+	for (; *s && *s != c; s++);
+	return *s == c ? (wchar_t*)s : NULL;
+}
+
+__attribute__((__target__("sse2")))
+static wchar_t *wcschr_sse2(const wchar_t *s, wchar_t c) {
+	const __m128i vc = _mm_set1_epi32(c);
+	const __m128i zero = _mm_set1_epi32(0);
+	size_t off = (uintptr_t)s % 16;
+	const __m128i *ptr = (const __m128i*)((const char*)s - off);
+	__m128i x = _mm_load_si128(ptr);
+	uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi32(x, vc), _mm_cmpeq_epi32(x, zero))) >> off;
+	if (mask) {
+		s += trailing_zeros(mask) / 4;
+		return *s == c ? (wchar_t*)s : NULL;
+	}
+	for (;;) {
+		ptr++;
+		x = _mm_load_si128(ptr);
+		mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi32(x, vc), _mm_cmpeq_epi32(x, zero)));
+		if (mask) {
+			s = (const wchar_t*)ptr + trailing_zeros(mask) / 4;
+			return *s == c ? (wchar_t*)s : NULL;
+		}
+	}
+}
+
+__attribute__((__target__("avx2")))
+static wchar_t *wcschr_avx2(const wchar_t *s, wchar_t c) {
+	const __m256i vc = _mm256_set1_epi32(c);
+	const __m256i zero = _mm256_set1_epi32(0);
+	size_t off = (uintptr_t)s % 32;
+	const __m256i *ptr = (const __m256i*)((const char*)s - off);
+	__m256i x = _mm256_load_si256(ptr);
+	uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi32(x, vc), _mm256_cmpeq_epi32(x, zero))) >> off;
+	if (mask) {
+		s += trailing_zeros(mask) / 4;
+		return *s == c ? (wchar_t*)s : NULL;
+	}
+	for (;;) {
+		ptr++;
+		x = _mm256_load_si256(ptr);
+		mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi32(x, vc), _mm256_cmpeq_epi32(x, zero)));
+		if (mask) {
+			s = (const wchar_t*)ptr + trailing_zeros(mask) / 4;
+			return *s == c ? (wchar_t*)s : NULL;
+		}
+	}
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static wchar_t *wcschr_avx512(const wchar_t *s, wchar_t c) {
+	const __m512i vc = _mm512_set1_epi32(c);
+	size_t off = (uintptr_t)s % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)s - off);
+	__m512i x = _mm512_load_si512(ptr);
+	uint32_t mask = (_mm512_cmpeq_epi32_mask(x, vc) | _mm512_testn_epi32_mask(x, x)) >> off / 4;
+	if (mask) {
+		s += trailing_zeros(mask);
+		return *s == c ? (wchar_t*)s : NULL;
+	}
+	for (;;) {
+		ptr++;
+		x = _mm512_load_si512(ptr);
+		mask = _mm512_cmpeq_epi32_mask(x, vc) | _mm512_testn_epi32_mask(x, x);
+		if (mask) {
+			s = (const wchar_t*)ptr + trailing_zeros(mask);
+			return *s == c ? (wchar_t*)s : NULL;
+		}
+	}
+}
+
+static wchar_t *wcschr_auto(const wchar_t *s, wchar_t c);
+
+static wchar_t *(*wcschr_impl)(const wchar_t *s, wchar_t c) = wcschr_auto;
+
+__attribute__((visibility("hidden")))
+void __wcschr_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		wcschr_impl = wcschr_avx512;
+	else if (has_avx2())
+		wcschr_impl = wcschr_avx2;
+	else if (has_sse2())
+		wcschr_impl = wcschr_sse2;
+	else
+		wcschr_impl = wcschr_fallback;
+}
+
+static wchar_t *wcschr_auto(const wchar_t *s, wchar_t c) {
+	__wcschr_resolve();
+	return wcschr_impl(s, c);
+}
+
+wchar_t *wcschr(const wchar_t *s, wchar_t c) {
+	return wcschr_impl(s, c);
+}
@@ -30,6 +30,7 @@
 #include <immintrin.h>
 
 #include "cpu_features.h"
+#include "helpers.h"
 
 static wchar_t *wmemset_fallback(wchar_t *s, wchar_t c, size_t n) {
 	for (size_t i = 0; i < n; i++) {
@@ -48,6 +49,7 @@ static wchar_t *wmemset_sse2(wchar_t *s, wchar_t c, size_t n) {
 	s[1] = s[2] = s[n-3] = s[n-2] = c;
 	if (n < 7)
 		return s;
+	int nt = n * sizeof(wchar_t) >= non_temporal_fill_threshold();
 	size_t padding = (15 - ((uintptr_t)(s-1) % 16)) / sizeof(wchar_t);
 	n -= padding;
 	__m128i *s128 = (void*)(s+padding);
@@ -55,7 +57,7 @@ static wchar_t *wmemset_sse2(wchar_t *s, wchar_t c, size_t n) {
 	n /= 4;
 	for (size_t i = 0; i < n%4; i++)
 		_mm_store_si128(s128++, c64);
-	if (n >= 1 << 21) {
+	if (nt) {
 		for (size_t i = 0; i < n/4; i++) {
 			_mm_stream_si128(&s128[4*i], c64);
 			_mm_stream_si128(&s128[4*i+1], c64);
@@ -97,13 +99,14 @@ static wchar_t *wmemset_avx(wchar_t *s, wchar_t c, size_t n) {
 		__m256i c64 = _mm256_set1_epi32(c);
 		_mm256_storeu_si256((__m256i *)&s[0], c64);
 		_mm256_storeu_si256((__m256i *)&s[n-8], c64);
-		size_t padding = 31 - ((uintptr_t)(s-1) % 32) / sizeof(wchar_t);
+		int nt = n * sizeof(wchar_t) >= non_temporal_fill_threshold();
+		size_t padding = (31 - ((uintptr_t)(s-1) % 32)) / sizeof(wchar_t);
 		n -= padding;
 		__m256i *s256 = (void*)(s+padding);
 		n /= 8;
 		for (size_t i = 0; i < n%4; i++)
 			_mm256_store_si256(s256++, c64);
-		if (n >= 1 << 21) {
+		if (nt) {
 			for (size_t i = 0; i < n/4; i++) {
 				_mm256_stream_si256(&s256[4*i], c64);
 				_mm256_stream_si256(&s256[4*i+1], c64);
@@ -123,17 +126,78 @@ static wchar_t *wmemset_avx(wchar_t *s, wchar_t c, size_t n) {
 	return s;
 }
 
+__attribute__((__target__("avx512f")))
+static wchar_t *wmemset_avx512(wchar_t *s, wchar_t c, size_t n) {
+	__m512i c64 = _mm512_set1_epi32(c);
+	if (n <= 16) {
+		if (n)
+			_mm512_mask_storeu_epi32(s, ((uint32_t)1 << n) - 1, c64);
+		return s;
+	}
+	if (n <= 32) {
+		_mm512_storeu_si512(s, c64);
+		_mm512_storeu_si512(s + n - 16, c64);
+		return s;
+	}
+	if (n <= 64) {
+		_mm512_storeu_si512(s, c64);
+		_mm512_storeu_si512(s + 16, c64);
+		_mm512_storeu_si512(s + n - 32, c64);
+		_mm512_storeu_si512(s + n - 16, c64);
+		return s;
+	}
+	uint8_t *s8 = (void*)s;
+	n *= sizeof(wchar_t);
+	int nt = n >= non_temporal_fill_threshold();
+	/* rep stosb can only help when all bytes of c are equal */
+	if (!nt && n >= rep_stosb_threshold() && (uint32_t)c % 0x100 * 0x01010101 == (uint32_t)c) {
+		rep_stosb(s8, c, n);
+		return s;
+	}
+	_mm512_storeu_si512(s8, c64);
+	uint8_t *end = s8 + n - 256;
+	s8 += 64 - (uintptr_t)s8 % 64;
+	if (nt) {
+		for (; s8 < end; s8 += 256) {
+			_mm512_stream_si512((__m512i *)s8, c64);
+			_mm512_stream_si512((__m512i *)s8 + 1, c64);
+			_mm512_stream_si512((__m512i *)s8 + 2, c64);
+			_mm512_stream_si512((__m512i *)s8 + 3, c64);
+		}
+		_mm_sfence();
+	}
+	else
+		for (; s8 < end; s8 += 256) {
+			_mm512_store_si512(s8, c64);
+			_mm512_store_si512(s8 + 64, c64);
+			_mm512_store_si512(s8 + 128, c64);
+			_mm512_store_si512(s8 + 192, c64);
+		}
+	_mm512_storeu_si512(end, c64);
+	_mm512_storeu_si512(end + 64, c64);
+	_mm512_storeu_si512(end + 128, c64);
+	_mm512_storeu_si512(end + 192, c64);
+	return s;
+}
+
 static wchar_t *wmemset_auto(wchar_t *s, wchar_t c, size_t n);
 
 static wchar_t *(*wmemset_impl)(wchar_t *s, wchar_t c, size_t n) = wmemset_auto;
 
-static wchar_t *wmemset_auto(wchar_t *s, wchar_t c, size_t n) {
-	if (has_avx())
+__attribute__((visibility("hidden")))
+void __wmemset_resolve(void) {
+	if (has_avx512f())
+		wmemset_impl = wmemset_avx512;
+	else if (has_avx())
 		wmemset_impl = wmemset_avx;
 	else if (has_sse2())
 		wmemset_impl = wmemset_sse2;
 	else
 		wmemset_impl = wmemset_fallback;
+}
+
+static wchar_t *wmemset_auto(wchar_t *s, wchar_t c, size_t n) {
+	__wmemset_resolve();
 	return wmemset_impl(s, c, n);
 }
 
@@ -28,6 +28,7 @@
 #ifndef HELPERS_H
 #define HELPERS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 static inline int trailing_zeros(uint32_t x) {
@@ -54,4 +55,155 @@ static inline int leading_zeros(uint32_t x) {
 #endif
 }
 
+static inline int trailing_zeros64(uint64_t x) {
+#ifdef __GNUC__
+	return __builtin_ctzll(x);
+#else
+	return (uint32_t)x ? trailing_zeros(x) : 32 + trailing_zeros(x >> 32);
+#endif
+}
+
+static inline int leading_zeros64(uint64_t x) {
+#ifdef __GNUC__
+	return __builtin_clzll(x);
+#else
+	return x >> 32 ? leading_zeros(x >> 32) : 32 + leading_zeros(x);
+#endif
+}
+
+struct unaligned_u32 { uint32_t v; } __attribute__((__packed__, __may_alias__));
+struct unaligned_u64 { uint64_t v; } __attribute__((__packed__, __may_alias__));
+
+static inline uint32_t load32(const void *p) {
+	return ((const struct unaligned_u32*)p)->v;
+}
+
+static inline uint64_t load64(const void *p) {
+	return ((const struct unaligned_u64*)p)->v;
+}
+
+static inline void store32(void *p, uint32_t v) {
+	((struct unaligned_u32*)p)->v = v;
+}
+
+static inline void store64(void *p, uint64_t v) {
+	((struct unaligned_u64*)p)->v = v;
+}
+
+/* Copies at most 32 bytes with overlapping accesses from both ends. */
+static inline void copy_small(void *d, const void *s, size_t n) {
+	char *dc = d;
+	const char *sc = s;
+	if (n >= 16) {
+		uint64_t chunk1 = load64(sc);
+		uint64_t chunk2 = load64(sc+8);
+		uint64_t chunk3 = load64(sc+n-16);
+		uint64_t chunk4 = load64(sc+n-8);
+		store64(dc, chunk1);
+		store64(dc+8, chunk2);
+		store64(dc+n-16, chunk3);
+		store64(dc+n-8, chunk4);
+	}
+	else if (n >= 8) {
+		uint64_t chunk1 = load64(sc);
+		uint64_t chunk2 = load64(sc+n-8);
+		store64(dc, chunk1);
+		store64(dc+n-8, chunk2);
+	}
+	else if (n >= 4) {
+		uint32_t chunk1 = load32(sc);
+		uint32_t chunk2 = load32(sc+n-4);
+		store32(dc, chunk1);
+		store32(dc+n-4, chunk2);
+	}
+	else if (n) {
+		char c1 = sc[0], c2 = sc[n/2], c3 = sc[n-1];
+		dc[0] = c1;
+		dc[n/2] = c2;
+		dc[n-1] = c3;
+	}
+}
+
+/* rep movs/stos use all of rdi, rsi and rcx; widen the 32-bit operands so
+ * that their upper halves are known to be zero. */
+static inline void rep_movsb(void *d, const void *s, size_t n) {
+	uint64_t dd = (uintptr_t)d, ss = (uintptr_t)s, nn = n;
+	__asm__ __volatile__ ("rep movsb" : "+D"(dd), "+S"(ss), "+c"(nn) : : "memory");
+}
+
+static inline void rep_stosb(void *d, int c, size_t n) {
+	uint64_t dd = (uintptr_t)d, nn = n;
+	__asm__ __volatile__ ("rep stosb" : "+D"(dd), "+c"(nn) : "a"(c) : "memory");
+}
+
+/*
+ * ASCII case folding. For single bytes this is all tolower does in every
+ * locale musl supports, so the _l variants can use it too.
+ */
+static inline unsigned char fold_case(unsigned char c) {
+	return c - 'A' < 26u ? c | 32 : c;
+}
+
+/* 'A' <= x <= 'Z' is x - 'A' <= 25 unsigned, found with an unsigned min */
+__attribute__((__target__("sse2")))
+static inline __m128i fold_case_sse2(__m128i x) {
+	__m128i t = _mm_sub_epi8(x, _mm_set1_epi8('A'));
+	__m128i upper = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(25)), t);
+	return _mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(32)));
+}
+
+__attribute__((__target__("avx2")))
+static inline __m256i fold_case_avx2(__m256i x) {
+	__m256i t = _mm256_sub_epi8(x, _mm256_set1_epi8('A'));
+	__m256i upper = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(25)), t);
+	return _mm256_or_si256(x, _mm256_and_si256(upper, _mm256_set1_epi8(32)));
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static inline __m512i fold_case_avx512(__m512i x) {
+	__m512i t = _mm512_sub_epi8(x, _mm512_set1_epi8('A'));
+	__mmask64 upper = _mm512_cmpeq_epi8_mask(_mm512_min_epu8(t, _mm512_set1_epi8(25)), t);
+	return _mm512_mask_blend_epi8(upper, x, _mm512_or_si512(x, _mm512_set1_epi8(32)));
+}
+
+/*
+ * Splits a byte set into two 16-entry tables indexed by the low nibble.
+ * Byte b is in the set iff bit (b / 16) % 8 of table[b % 16] (b < 128)
+ * or table[16 + b % 16] (b >= 128) is set.
+ */
+static inline void byteset_nibbles(unsigned char table[32], const char *set) {
+	for (int i = 0; i < 32; i++)
+		table[i] = 0;
+	for (; *set; set++) {
+		unsigned char b = *set;
+		table[b / 128 * 16 + b % 16] |= 1 << (b / 16) % 8;
+	}
+}
+
+/*
+ * pshufb yields zero for an index with bit 7 set, so masking the index
+ * with 0x8f looks bytes < 128 up in lo only, and flipping bit 7 looks
+ * bytes >= 128 up in hi only.
+ */
+__attribute__((__target__("avx2")))
+static inline uint32_t byteset_match_avx2(__m256i x, __m256i lo, __m256i hi) {
+	const __m256i bits = _mm256_broadcastsi128_si256(_mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1));
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	__m256i l = _mm256_and_si256(x, _mm256_set1_epi8(0x8f));
+	__m256i h = _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble);
+	__m256i row = _mm256_or_si256(_mm256_shuffle_epi8(lo, l), _mm256_shuffle_epi8(hi, _mm256_xor_si256(l, _mm256_set1_epi8(0x80))));
+	__m256i hit = _mm256_and_si256(row, _mm256_shuffle_epi8(bits, h));
+	return ~_mm256_movemask_epi8(_mm256_cmpeq_epi8(hit, _mm256_set1_epi8(0)));
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static inline uint64_t byteset_match_avx512(__m512i x, __m512i lo, __m512i hi) {
+	const __m512i bits = _mm512_broadcast_i32x4(_mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1));
+	const __m512i nibble = _mm512_set1_epi8(0x0f);
+	__m512i l = _mm512_and_si512(x, nibble);
+	__m512i h = _mm512_and_si512(_mm512_srli_epi16(x, 4), nibble);
+	__m512i row = _mm512_mask_blend_epi8(_mm512_movepi8_mask(x), _mm512_shuffle_epi8(lo, l), _mm512_shuffle_epi8(hi, l));
+	return _mm512_test_epi8_mask(row, _mm512_shuffle_epi8(bits, h));
+}
+
 #endif // HELPERS_H
@@ -32,7 +32,8 @@
 #include "helpers.h"
 
 static void *memchr_fallback(const void *haystack, int needle, size_t size) {
-	while ((size_t)haystack % sizeof(size_t) && size > 0) {
+	/* the loop reads two words at a time, so align to the pair */
+	while ((size_t)haystack % (2*sizeof(size_t)) && size > 0) {
 		if (*(unsigned char*)haystack == needle)
 			return (void*)haystack;
 		haystack = (char*)haystack + 1;
@@ -251,17 +252,82 @@ static void *memchr_avx2(const void *haystack, int needle, size_t size) {
 	return NULL;
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static void *memchr_avx512(const void *haystack, int needle, size_t size) {
+	if (!size)
+		return NULL;
+	size_t off = (size_t)haystack % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)haystack - off);
+	__m512i vn = _mm512_set1_epi8(needle);
+	uint64_t mask = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr), vn) >> off;
+	if (mask) {
+		size_t i = trailing_zeros64(mask);
+		return i < size ? (char*)haystack + i : NULL;
+	}
+	if (size <= 64 - off)
+		return NULL;
+	size -= 64 - off;
+	ptr++;
+	/* the unrolled loop must not cross a page past the match */
+	while ((size_t)ptr % 256 && size >= 64) {
+		mask = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr), vn);
+		if (mask)
+			return (char*)ptr + trailing_zeros64(mask);
+		ptr++;
+		size -= 64;
+	}
+	while (size >= 256) {
+		uint64_t ma = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr), vn);
+		uint64_t mb = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr+1), vn);
+		uint64_t mc = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr+2), vn);
+		uint64_t md = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr+3), vn);
+		if (ma | mb | mc | md) {
+			if (ma)
+				return (char*)ptr + trailing_zeros64(ma);
+			if (mb)
+				return (char*)(ptr+1) + trailing_zeros64(mb);
+			if (mc)
+				return (char*)(ptr+2) + trailing_zeros64(mc);
+			return (char*)(ptr+3) + trailing_zeros64(md);
+		}
+		ptr += 4;
+		size -= 256;
+	}
+	while (size >= 64) {
+		mask = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr), vn);
+		if (mask)
+			return (char*)ptr + trailing_zeros64(mask);
+		ptr++;
+		size -= 64;
+	}
+	if (size) {
+		/* the aligned load cannot cross into the next page */
+		mask = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr), vn);
+		mask &= ((uint64_t)1 << size) - 1;
+		if (mask)
+			return (char*)ptr + trailing_zeros64(mask);
+	}
+	return NULL;
+}
+
 static void *memchr_auto(const void *haystack, int c, size_t n);
 
 static void *(*memchr_impl)(const void *haystack, int c, size_t n) = memchr_auto;
 
-static void *memchr_auto(const void *haystack, int c, size_t n) {
-	if (has_avx2())
+__attribute__((visibility("hidden")))
+void __memchr_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		memchr_impl = memchr_avx512;
+	else if (has_avx2())
 		memchr_impl = memchr_avx2;
 	else if (has_sse2())
 		memchr_impl = memchr_sse2;
 	else
 		memchr_impl = memchr_fallback;
+}
+
+static void *memchr_auto(const void *haystack, int c, size_t n) {
+	__memchr_resolve();
 	return memchr_impl(haystack, c, n);
 }
 
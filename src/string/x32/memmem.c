@@ -30,110 +30,111 @@
 #include <immintrin.h>
 
 #include "cpu_features.h"
+#include "helpers.h"
 
 static char *memmem2(const uint8_t *h, size_t k, const uint8_t *n)
 {
 	uint16_t nw = (uintmax_t)n[0] << 8 | n[1];
 	uint16_t hw = (uintmax_t)h[0] << 8 | h[1];
-	while (k >= 2) {
+	for (;;) {
 		if (hw == nw)
 			return (void*)h;
+		if (k-- == 2)
+			return NULL;
 		hw <<= 8;
 		hw |= h[2];
 		h++;
-		k--;
 	}
-	return NULL;
 }
 
 static char *memmem3(const uint8_t *h, size_t k, const uint8_t *n)
 {
 	uint32_t nw = (uintmax_t)n[0] << 24 | (uintmax_t)n[1] << 16 | (uintmax_t)n[2] << 8;
 	uint32_t hw = (uintmax_t)h[0] << 24 | (uintmax_t)h[1] << 16 | (uintmax_t)h[2] << 8;
-	while (k >= 3) {
+	for (;;) {
 		if (hw == nw)
 			return (void*)h;
+		if (k-- == 3)
+			return NULL;
 		hw <<= 8;
 		hw |= (uintmax_t)h[3] << 8;
 		h++;
-		k--;
 	}
-	return NULL;
 }
 
 static char *memmem4(const uint8_t *h, size_t k, const uint8_t *n)
 {
 	uint32_t nw = (uintmax_t)n[0] << 24 | (uintmax_t)n[1] << 16 | (uintmax_t)n[2] << 8 | n[3];
 	uint32_t hw = (uintmax_t)h[0] << 24 | (uintmax_t)h[1] << 16 | (uintmax_t)h[2] << 8 | h[3];
-	while (k >= 4) {
+	for (;;) {
 		if (hw == nw)
 			return (void*)h;
+		if (k-- == 4)
+			return NULL;
 		hw <<= 8;
 		hw |= h[4];
 		h++;
-		k--;
 	}
-	return NULL;
 }
 
 static char *memmem5(const uint8_t *h, size_t k, const uint8_t *n)
 {
 	uint64_t nw = (uintmax_t)n[0] << 56 | (uintmax_t)n[1] << 48 | (uintmax_t)n[2] << 40 | (uintmax_t)n[3] << 32 | (uintmax_t)n[4] << 24;
 	uint64_t hw = (uintmax_t)h[0] << 56 | (uintmax_t)h[1] << 48 | (uintmax_t)h[2] << 40 | (uintmax_t)h[3] << 32 | (uintmax_t)h[4] << 24;
-	while (k >= 5) {
+	for (;;) {
 		if (hw == nw)
 			return (void*)h;
+		if (k-- == 5)
+			return NULL;
 		hw <<= 8;
 		hw |= (uintmax_t)h[5] << 24;
 		h++;
-		k--;
 	}
-	return NULL;
 }
 
 static char *memmem6(const uint8_t *h, size_t k, const uint8_t *n)
 {
 	uint64_t nw = (uintmax_t)n[0] << 56 | (uintmax_t)n[1] << 48 | (uintmax_t)n[2] << 40 | (uintmax_t)n[3] << 32 | (uintmax_t)n[4] << 24 | (uintmax_t)n[5] << 16;
 	uint64_t hw = (uintmax_t)h[0] << 56 | (uintmax_t)h[1] << 48 | (uintmax_t)h[2] << 40 | (uintmax_t)h[3] << 32 | (uintmax_t)h[4] << 24 | (uintmax_t)h[5] << 16;
-	while (k >= 6) {
+	for (;;) {
 		if (hw == nw)
 			return (void*)h;
+		if (k-- == 6)
+			return NULL;
 		hw <<= 8;
 		hw |= (uintmax_t)h[6] << 16;
 		h++;
-		k--;
 	}
-	return NULL;
 }
 
 static char *memmem7(const uint8_t *h, size_t k, const uint8_t *n)
 {
 	uint64_t nw = (uintmax_t)n[0] << 56 | (uintmax_t)n[1] << 48 | (uintmax_t)n[2] << 40 | (uintmax_t)n[3] << 32 | (uintmax_t)n[4] << 24 | (uintmax_t)n[5] << 16 | (uintmax_t)n[6] << 8;
 	uint64_t hw = (uintmax_t)h[0] << 56 | (uintmax_t)h[1] << 48 | (uintmax_t)h[2] << 40 | (uintmax_t)h[3] << 32 | (uintmax_t)h[4] << 24 | (uintmax_t)h[5] << 16 | (uintmax_t)h[6] << 8;
-	while (k >= 7) {
+	for (;;) {
 		if (hw == nw)
 			return (void*)h;
+		if (k-- == 7)
+			return NULL;
 		hw <<= 8;
 		hw |= (uintmax_t)h[7] << 8;
 		h++;
-		k--;
 	}
-	return NULL;
 }
 
 static char *memmem8(const uint8_t *h, size_t k, const uint8_t *n)
 {
 	uint64_t nw = (uintmax_t)n[0] << 56 | (uintmax_t)n[1] << 48 | (uintmax_t)n[2] << 40 | (uintmax_t)n[3] << 32 | (uintmax_t)n[4] << 24 | (uintmax_t)n[5] << 16 | (uintmax_t)n[6] << 8 | n[7];
 	uint64_t hw = (uintmax_t)h[0] << 56 | (uintmax_t)h[1] << 48 | (uintmax_t)h[2] << 40 | (uintmax_t)h[3] << 32 | (uintmax_t)h[4] << 24 | (uintmax_t)h[5] << 16 | (uintmax_t)h[6] << 8 | h[7];
-	while (k >= 8) {
+	for (;;) {
 		if (hw == nw)
 			return (void*)h;
+		if (k-- == 8)
+			return NULL;
 		hw <<= 8;
 		hw |= h[8];
 		h++;
-		k--;
 	}
-	return NULL;
 }
 
 #define DEFINE_MEMMEM(L) \
@@ -142,14 +143,14 @@ static char *memmem##L(const uint8_t *h, size_t k, const uint8_t *n) \
 { \
 	__m128i nw = _mm_or_si128(_mm_bslli_si128(_mm_loadu_si64(n+(L)-8), (L)-8), _mm_loadu_si64((void*)n)); \
 	__m128i hw = _mm_or_si128(_mm_bslli_si128(_mm_loadu_si64(h+(L)-8), (L)-8), _mm_loadu_si64((void*)h)); \
-	while (k >= (L)) { \
+	for (;;) { \
 		if (_mm_movemask_epi8(_mm_cmpeq_epi8(hw, nw)) == 0xffff) \
 			return (void*)h; \
+		if (k-- == (L)) \
+			return NULL; \
 		hw = _mm_or_si128(_mm_bsrli_si128(hw, 1), _mm_bslli_si128(_mm_loadu_si64(h+(L)-7), (L)-8)); \
 		h++; \
-		k--; \
 	} \
-	return NULL; \
 }
 
 DEFINE_MEMMEM(9)
@@ -167,65 +168,14 @@ static char *memmem16(const uint8_t *h, size_t k, const uint8_t *n)
 {
 	__m128i nw = _mm_loadu_si128((void*)n);
 	__m128i hw = _mm_loadu_si128((void*)h);
-	while (k >= 16) {
+	for (;;) {
 		if (_mm_movemask_epi8(_mm_cmpeq_epi8(hw, nw)) == 0xffff)
 			return (void*)h;
+		if (k-- == 16)
+			return NULL;
 		hw = _mm_or_si128(_mm_bsrli_si128(hw, 1), _mm_bslli_si128(_mm_loadu_si64(h+9), 8));
 		h++;
-		k--;
 	}
-	return NULL;
-}
-
-#define DEFINE_MEMMEM(L) \
-__attribute__((__target__("avx2"))) \
-static char *memmem##L(const uint8_t *h, size_t k, const uint8_t *n) \
-{ \
-	__m256i nw = _mm256_bslli_epi128(_mm256_castsi128_si256(_mm_loadu_si128((void*)(n+(L)-16))), (L)-16); \
-	__m256i hw = _mm256_bslli_epi128(_mm256_castsi128_si256(_mm_loadu_si128((void*)(h+(L)-16))), (L)-16); \
-	nw = _mm256_insertf128_si256(nw, _mm_loadu_si128((void*)n), 0); \
-	hw = _mm256_insertf128_si256(hw, _mm_loadu_si128((void*)h), 0); \
-	while (k >= (L)) { \
-		if ((_mm256_movemask_epi8(_mm256_cmpeq_epi8(hw, nw)) & ((1ull << (L)) - 1)) == (1ull << (L)) - 1) \
-			return (void*)h; \
-		hw = _mm256_insert_epi8(_mm256_bsrli_epi128(hw, 1), h[L], (L)-1); \
-		h++; \
-		k--; \
-	} \
-	return NULL; \
-}
-
-DEFINE_MEMMEM(17)
-DEFINE_MEMMEM(18)
-DEFINE_MEMMEM(19)
-DEFINE_MEMMEM(20)
-DEFINE_MEMMEM(21)
-DEFINE_MEMMEM(22)
-DEFINE_MEMMEM(23)
-DEFINE_MEMMEM(24)
-DEFINE_MEMMEM(25)
-DEFINE_MEMMEM(26)
-DEFINE_MEMMEM(27)
-DEFINE_MEMMEM(28)
-DEFINE_MEMMEM(29)
-DEFINE_MEMMEM(30)
-DEFINE_MEMMEM(31)
-
-#undef DEFINE_MEMMEM
-
-__attribute__((__target__("avx2")))
-static char *memmem32(const uint8_t *h, size_t k, const uint8_t *n)
-{
-	__m256i nw = _mm256_loadu_si256((void*)n);
-	__m256i hw = _mm256_loadu_si256((void*)h);
-	while (k >= 32) {
-		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(hw, nw)) == -1)
-			return (void*)h;
-		hw = _mm256_insert_epi8(_mm256_bsrli_epi128(hw, 1), h[32], 31);
-		h++;
-		k--;
-	}
-	return NULL;
 }
 
 /*
@@ -364,22 +314,8 @@ static char *twoway_memmem(const unsigned char *h, const unsigned char *z, const
 	}
 }
 
-void *memmem(const void *h0, size_t k, const void *n0, size_t l)
+static char *memmem_fallback(const uint8_t *h, size_t k, const uint8_t *n, size_t l)
 {
-	const uint8_t *h;
-	const uint8_t *n = n0;
-
-	if (!l)
-		return (void*)h0;
-
-	if (k < l)
-		return NULL;
-	h = memchr(h0, *n, k);
-	if (!h || l == 1)
-		return (void*)h;
-	k -= h - (const unsigned char*)h0;
-	if (k < l)
-		return NULL;
 	switch (l) {
 		case 2:
 			return memmem2(h, k, n);
@@ -415,42 +351,6 @@ void *memmem(const void *h0, size_t k, const void *n0, size_t l)
 			case 16:
 				return memmem16(h, k, n);
 		}
-		if (has_avx2()) {
-			switch (l) {
-				case 17:
-					return memmem17(h, k, n);
-				case 18:
-					return memmem18(h, k, n);
-				case 19:
-					return memmem19(h, k, n);
-				case 20:
-					return memmem20(h, k, n);
-				case 21:
-					return memmem21(h, k, n);
-				case 22:
-					return memmem22(h, k, n);
-				case 23:
-					return memmem23(h, k, n);
-				case 24:
-					return memmem24(h, k, n);
-				case 25:
-					return memmem25(h, k, n);
-				case 26:
-					return memmem26(h, k, n);
-				case 27:
-					return memmem27(h, k, n);
-				case 28:
-					return memmem28(h, k, n);
-				case 29:
-					return memmem29(h, k, n);
-				case 30:
-					return memmem30(h, k, n);
-				case 31:
-					return memmem31(h, k, n);
-				case 32:
-					return memmem32(h, k, n);
-			}
-		}
 	}
 	if (l < 512) {
 		for (size_t i = 0; i <= k - l; i++)
@@ -460,3 +360,110 @@ void *memmem(const void *h0, size_t k, const void *n0, size_t l)
 	}
 	return twoway_memmem(h, h+k, n, l);
 }
+
+/*
+ * Generic needles: candidates are positions where both the first and the
+ * last byte of the needle match, tested a vector of positions at a time and
+ * verified with memcmp. If verification dominates the scan, the remaining
+ * haystack goes to two-way to keep the worst case linear.
+ */
+
+__attribute__((__target__("avx2")))
+static char *memmem_avx2(const uint8_t *h, size_t k, const uint8_t *n, size_t l)
+{
+	size_t end = k - l + 1;
+	if (end < 32)
+		return memmem_fallback(h, k, n, l);
+	__m256i first = _mm256_set1_epi8(n[0]);
+	__m256i last = _mm256_set1_epi8(n[l-1]);
+	size_t verified = 0;
+	size_t i = 0;
+	while (i < end) {
+		/* the last block overlaps the previous one */
+		size_t j = end - i < 32 ? end - 32 : i;
+		__m256i bf = _mm256_loadu_si256((const void*)(h + j));
+		__m256i bl = _mm256_loadu_si256((const void*)(h + j + l - 1));
+		__m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(bf, first), _mm256_cmpeq_epi8(bl, last));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(eq) >> (i - j) << (i - j);
+		while (mask) {
+			size_t c = j + trailing_zeros(mask);
+			if (!memcmp(h + c + 1, n + 1, l - 2))
+				return (void*)(h + c);
+			verified += l;
+			mask &= mask - 1;
+		}
+		i = j + 32;
+		if (verified > 4 * i + 1024)
+			return twoway_memmem(h + i, h + k, n, l);
+	}
+	return NULL;
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static char *memmem_avx512(const uint8_t *h, size_t k, const uint8_t *n, size_t l)
+{
+	size_t end = k - l + 1;
+	if (end < 64)
+		return memmem_fallback(h, k, n, l);
+	__m512i first = _mm512_set1_epi8(n[0]);
+	__m512i last = _mm512_set1_epi8(n[l-1]);
+	size_t verified = 0;
+	size_t i = 0;
+	while (i < end) {
+		/* the last block overlaps the previous one */
+		size_t j = end - i < 64 ? end - 64 : i;
+		__m512i bf = _mm512_loadu_si512(h + j);
+		__m512i bl = _mm512_loadu_si512(h + j + l - 1);
+		uint64_t mask = _mm512_mask_cmpeq_epi8_mask(_mm512_cmpeq_epi8_mask(bf, first), bl, last);
+		mask = mask >> (i - j) << (i - j);
+		while (mask) {
+			size_t c = j + trailing_zeros64(mask);
+			if (!memcmp(h + c + 1, n + 1, l - 2))
+				return (void*)(h + c);
+			verified += l;
+			mask &= mask - 1;
+		}
+		i = j + 64;
+		if (verified > 4 * i + 1024)
+			return twoway_memmem(h + i, h + k, n, l);
+	}
+	return NULL;
+}
+
+static char *memmem_auto(const uint8_t *h, size_t k, const uint8_t *n, size_t l);
+
+static char *(*memmem_impl)(const uint8_t *h, size_t k, const uint8_t *n, size_t l) = memmem_auto;
+
+__attribute__((visibility("hidden")))
+void __memmem_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		memmem_impl = memmem_avx512;
+	else if (has_avx2())
+		memmem_impl = memmem_avx2;
+	else
+		memmem_impl = memmem_fallback;
+}
+
+static char *memmem_auto(const uint8_t *h, size_t k, const uint8_t *n, size_t l) {
+	__memmem_resolve();
+	return memmem_impl(h, k, n, l);
+}
+
+void *memmem(const void *h0, size_t k, const void *n0, size_t l)
+{
+	const uint8_t *h;
+	const uint8_t *n = n0;
+
+	if (!l)
+		return (void*)h0;
+
+	if (k < l)
+		return NULL;
+	h = memchr(h0, *n, k);
+	if (!h || l == 1)
+		return (void*)h;
+	k -= h - (const unsigned char*)h0;
+	if (k < l)
+		return NULL;
+	return memmem_impl(h, k, n, l);
+}
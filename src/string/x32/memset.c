@@ -30,6 +30,7 @@
 #include <immintrin.h>
 
 #include "cpu_features.h"
+#include "helpers.h"
 
 static void *memset_fallback(void *s, int c, size_t n) {
 	uint8_t *s8 = s;
@@ -94,6 +95,11 @@ static void *memset_sse2(void *s, int c, size_t n) {
 		s32[1] = s32[2] = s32[n-3] = s32[n-2] = c32;
 	}
 	else {
+		int nt = n >= non_temporal_fill_threshold();
+		if (!nt && n >= rep_stosb_threshold()) {
+			rep_stosb(s8, c, n);
+			return s;
+		}
 		__m128i c64 = _mm_set1_epi8(c);
 		_mm_storeu_si128((__m128i *)&s8[0], c64);
 		_mm_storeu_si128((__m128i *)&s8[n-16], c64);
@@ -104,7 +110,7 @@ static void *memset_sse2(void *s, int c, size_t n) {
 		n /= 16;
 		for (size_t i = 0; i < n%4; i++)
 			_mm_store_si128(s128++, c64);
-		if (n >= 1 << 21) {
+		if (nt) {
 			for (size_t i = 0; i < n/4; i++) {
 				_mm_stream_si128(&s128[4*i], c64);
 				_mm_stream_si128(&s128[4*i+1], c64);
@@ -158,6 +164,11 @@ static void *memset_avx(void *s, int c, size_t n) {
 			_mm_storeu_si128((__m128i *)&s8[n-16], c64);
 	}
 	else {
+		int nt = n >= non_temporal_fill_threshold();
+		if (!nt && n >= rep_stosb_threshold()) {
+			rep_stosb(s8, c, n);
+			return s;
+		}
 		__m256i c64 = _mm256_set1_epi8(c);
 		_mm256_storeu_si256((__m256i *)&s8[0], c64);
 		_mm256_storeu_si256((__m256i *)&s8[n-32], c64);
@@ -168,7 +179,7 @@ static void *memset_avx(void *s, int c, size_t n) {
 		n /= 32;
 		for (size_t i = 0; i < n%4; i++)
 			_mm256_store_si256(s256++, c64);
-		if (n >= 1 << 21) {
+		if (nt) {
 			for (size_t i = 0; i < n/4; i++) {
 				_mm256_stream_si256(&s256[4*i], c64);
 				_mm256_stream_si256(&s256[4*i+1], c64);
@@ -188,17 +199,77 @@ static void *memset_avx(void *s, int c, size_t n) {
 	return s;
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static void *memset_avx512(void *s, int c, size_t n) {
+	uint8_t *s8 = s;
+	__m512i c64 = _mm512_set1_epi8(c);
+	if (n <= 64) {
+		if (n)
+			_mm512_mask_storeu_epi8(s8, ~(uint64_t)0 >> (64 - n), c64);
+		return s;
+	}
+	if (n <= 128) {
+		_mm512_storeu_si512(s8, c64);
+		_mm512_storeu_si512(s8 + n - 64, c64);
+		return s;
+	}
+	if (n <= 256) {
+		_mm512_storeu_si512(s8, c64);
+		_mm512_storeu_si512(s8 + 64, c64);
+		_mm512_storeu_si512(s8 + n - 128, c64);
+		_mm512_storeu_si512(s8 + n - 64, c64);
+		return s;
+	}
+	int nt = n >= non_temporal_fill_threshold();
+	if (!nt && n >= rep_stosb_threshold()) {
+		rep_stosb(s8, c, n);
+		return s;
+	}
+	/* the unaligned head and the last 256 bytes are stored separately */
+	_mm512_storeu_si512(s8, c64);
+	uint8_t *end = s8 + n - 256;
+	s8 += 64 - (uintptr_t)s8 % 64;
+	if (nt) {
+		for (; s8 < end; s8 += 256) {
+			_mm512_stream_si512((__m512i *)s8, c64);
+			_mm512_stream_si512((__m512i *)s8 + 1, c64);
+			_mm512_stream_si512((__m512i *)s8 + 2, c64);
+			_mm512_stream_si512((__m512i *)s8 + 3, c64);
+		}
+		_mm_sfence();
+	}
+	else
+		for (; s8 < end; s8 += 256) {
+			_mm512_store_si512(s8, c64);
+			_mm512_store_si512(s8 + 64, c64);
+			_mm512_store_si512(s8 + 128, c64);
+			_mm512_store_si512(s8 + 192, c64);
+		}
+	_mm512_storeu_si512(end, c64);
+	_mm512_storeu_si512(end + 64, c64);
+	_mm512_storeu_si512(end + 128, c64);
+	_mm512_storeu_si512(end + 192, c64);
+	return s;
+}
+
 static void *memset_auto(void *s, int c, size_t n);
 
 static void *(*memset_impl)(void *s, int c, size_t n) = memset_auto;
 
-static void *memset_auto(void *s, int c, size_t n) {
-	if (has_avx())
+__attribute__((visibility("hidden")))
+void __memset_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		memset_impl = memset_avx512;
+	else if (has_avx())
 		memset_impl = memset_avx;
 	else if (has_sse2())
 		memset_impl = memset_sse2;
 	else
 		memset_impl = memset_fallback;
+}
+
+static void *memset_auto(void *s, int c, size_t n) {
+	__memset_resolve();
 	return memset_impl(s, c, n);
 }
 
@@ -32,7 +32,8 @@
 #include "helpers.h"
 
 static void* rawmemchr_fallback(const void *haystack, int n) {
-	while ((size_t)haystack % sizeof(size_t)) {
+	/* the loop reads two words at a time, so align to the pair */
+	while ((size_t)haystack % (2*sizeof(size_t))) {
 		if (*(unsigned char*)haystack == n)
 			return (void*)haystack;
 		haystack = (char*)haystack + 1;
@@ -201,17 +202,51 @@ static void* rawmemchr_avx2(const void *haystack, int n) {
 	}
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static void* rawmemchr_avx512(const void *haystack, int n) {
+	size_t off = (size_t)haystack % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)haystack - off);
+	__m512i vn = _mm512_set1_epi8(n);
+	uint64_t mask = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr), vn) >> off;
+	if (mask)
+		return (char*)haystack + trailing_zeros64(mask);
+	ptr++;
+	if ((size_t)ptr % 128) {
+		mask = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr), vn);
+		if (mask)
+			return (char*)ptr + trailing_zeros64(mask);
+		ptr++;
+	}
+	for (;;) {
+		uint64_t ma = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr), vn);
+		uint64_t mb = _mm512_cmpeq_epi8_mask(_mm512_load_si512(ptr+1), vn);
+		if (ma | mb) {
+			if (ma)
+				return (char*)ptr + trailing_zeros64(ma);
+			return (char*)(ptr+1) + trailing_zeros64(mb);
+		}
+		ptr += 2;
+	}
+}
+
 static void *rawmemchr_auto(const void *s, int c);
 
 static void *(*rawmemchr_impl)(const void *s, int) = rawmemchr_auto;
 
-static void *rawmemchr_auto(const void *s, int c) {
-	if (has_avx2())
+__attribute__((visibility("hidden")))
+void __rawmemchr_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		rawmemchr_impl = rawmemchr_avx512;
+	else if (has_avx2())
 		rawmemchr_impl = rawmemchr_avx2;
 	else if (has_sse2())
 		rawmemchr_impl = rawmemchr_sse2;
 	else
 		rawmemchr_impl = rawmemchr_fallback;
+}
+
+static void *rawmemchr_auto(const void *s, int c) {
+	__rawmemchr_resolve();
 	return rawmemchr_impl(s, c);
 }
 
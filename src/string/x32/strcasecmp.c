@@ -33,15 +33,15 @@
 #include "cpu_features.h"
 #include "helpers.h"
 
-static size_t strdiff_naive(const char *s1, const char *s2)
+static size_t casediff_naive(const char *s1, const char *s2)
 {
 	for (size_t i = 0; ; i++)
-		if (!s1[i] || s1[i] != s2[i])
+		if (!s1[i] || fold_case(s1[i]) != fold_case(s2[i]))
 			return i;
 }
 
 __attribute__((__target__("sse2")))
-static size_t strdiff_sse2(const char *s1, const char *s2)
+static size_t casediff_sse2(const char *s1, const char *s2)
 {
 	const size_t padding1 = 127 - ((uintptr_t)(s1-1) % 128);
 	const size_t padding2 = 127 - ((uintptr_t)(s2-1) % 128);
@@ -58,10 +58,10 @@ static size_t strdiff_sse2(const char *s1, const char *s2)
 		__m128i r3 = _mm_loadu_si128((const __m128i*)r+2);
 		__m128i l4 = _mm_loadu_si128((const __m128i*)l+3);
 		__m128i r4 = _mm_loadu_si128((const __m128i*)r+3);
-		__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1));
-		__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(l2, r2));
-		__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(l3, r3));
-		__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(l4, r4));
+		__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1)));
+		__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(fold_case_sse2(l2), fold_case_sse2(r2)));
+		__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(fold_case_sse2(l3), fold_case_sse2(r3)));
+		__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(fold_case_sse2(l4), fold_case_sse2(r4)));
 		if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(n1, n2), _mm_and_si128(n3, n4))) != 0xffff) {
 			int o;
 			if ((o = _mm_movemask_epi8(n1)) != 0xffff)
@@ -83,8 +83,8 @@ static size_t strdiff_sse2(const char *s1, const char *s2)
 		__m128i r1 = _mm_loadu_si128((const __m128i*)r);
 		__m128i l2 = _mm_loadu_si128((const __m128i*)l+1);
 		__m128i r2 = _mm_loadu_si128((const __m128i*)r+1);
-		__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1));
-		__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(l2, r2));
+		__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1)));
+		__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(fold_case_sse2(l2), fold_case_sse2(r2)));
 		if (_mm_movemask_epi8(_mm_and_si128(n1, n2)) != 0xffff) {
 			int o;
 			if ((o = _mm_movemask_epi8(n1)) != 0xffff)
@@ -100,7 +100,7 @@ static size_t strdiff_sse2(const char *s1, const char *s2)
 	if (padding >= 16) {
 		__m128i l1 = _mm_loadu_si128((const __m128i*)l);
 		__m128i r1 = _mm_loadu_si128((const __m128i*)r);
-		int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1)));
+		int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1))));
 		if (o != 0xffff) {
 			o = trailing_zeros(~o);
 			return l-s1+o;
@@ -110,7 +110,7 @@ static size_t strdiff_sse2(const char *s1, const char *s2)
 		padding -= 16;
 	}
 	while (padding) {
-		if (!*l || *l != *r)
+		if (!*l || fold_case(*l) != fold_case(*r))
 			return l-s1;
 		l++;
 		r++;
@@ -126,10 +126,10 @@ static size_t strdiff_sse2(const char *s1, const char *s2)
 			__m128i r3 = _mm_load_si128((const __m128i*)r+2);
 			__m128i l4 = _mm_load_si128((const __m128i*)l+3);
 			__m128i r4 = _mm_load_si128((const __m128i*)r+3);
-			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1));
-			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(l2, r2));
-			__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(l3, r3));
-			__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(l4, r4));
+			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1)));
+			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(fold_case_sse2(l2), fold_case_sse2(r2)));
+			__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(fold_case_sse2(l3), fold_case_sse2(r3)));
+			__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(fold_case_sse2(l4), fold_case_sse2(r4)));
 			if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(n1, n2), _mm_and_si128(n3, n4))) != 0xffff) {
 				int o;
 				if ((o = _mm_movemask_epi8(n1)) != 0xffff)
@@ -160,10 +160,10 @@ static size_t strdiff_sse2(const char *s1, const char *s2)
 			__m128i r3 = _mm_loadu_si128((const __m128i*)r+2);
 			__m128i l4 = _mm_loadu_si128((const __m128i*)l+3);
 			__m128i r4 = _mm_loadu_si128((const __m128i*)r+3);
-			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1));
-			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(l2, r2));
-			__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(l3, r3));
-			__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(l4, r4));
+			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1)));
+			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(fold_case_sse2(l2), fold_case_sse2(r2)));
+			__m128i n3 = _mm_andnot_si128(_mm_cmpeq_epi8(l3, zero), _mm_cmpeq_epi8(fold_case_sse2(l3), fold_case_sse2(r3)));
+			__m128i n4 = _mm_andnot_si128(_mm_cmpeq_epi8(l4, zero), _mm_cmpeq_epi8(fold_case_sse2(l4), fold_case_sse2(r4)));
 			if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(n1, n2), _mm_and_si128(n3, n4))) != 0xffff) {
 				int o;
 				if ((o = _mm_movemask_epi8(n1)) != 0xffff)
@@ -185,8 +185,8 @@ static size_t strdiff_sse2(const char *s1, const char *s2)
 			__m128i r1 = _mm_loadu_si128((const __m128i*)r);
 			__m128i l2 = _mm_loadu_si128((const __m128i*)l+1);
 			__m128i r2 = _mm_loadu_si128((const __m128i*)r+1);
-			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1));
-			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(l2, r2));
+			__m128i n1 = _mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1)));
+			__m128i n2 = _mm_andnot_si128(_mm_cmpeq_epi8(l2, zero), _mm_cmpeq_epi8(fold_case_sse2(l2), fold_case_sse2(r2)));
 			if (_mm_movemask_epi8(_mm_and_si128(n1, n2)) != 0xffff) {
 				int o;
 				if ((o = _mm_movemask_epi8(n1)) != 0xffff)
@@ -202,7 +202,7 @@ static size_t strdiff_sse2(const char *s1, const char *s2)
 		if (padding >= 16) {
 			__m128i l1 = _mm_loadu_si128((const __m128i*)l);
 			__m128i r1 = _mm_loadu_si128((const __m128i*)r);
-			int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(l1, r1)));
+			int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1))));
 			if (o != 0xffff) {
 				o = trailing_zeros(~o);
 				return l-s1+o;
@@ -212,7 +212,7 @@ static size_t strdiff_sse2(const char *s1, const char *s2)
 			padding -= 16;
 		}
 		while (padding) {
-			if (!*l || *l != *r)
+			if (!*l || fold_case(*l) != fold_case(*r))
 				return l-s1;
 			l++;
 			r++;
@@ -222,7 +222,7 @@ static size_t strdiff_sse2(const char *s1, const char *s2)
 }
 
 __attribute__((__target__("avx2")))
-static size_t strdiff_avx2(const char *s1, const char *s2)
+static size_t casediff_avx2(const char *s1, const char *s2)
 {
 	const size_t padding1 = 127 - ((uintptr_t)(s1-1) % 128);
 	const size_t padding2 = 127 - ((uintptr_t)(s2-1) % 128);
@@ -236,8 +236,8 @@ static size_t strdiff_avx2(const char *s1, const char *s2)
 		__m256i r1 = _mm256_loadu_si256((const __m256i*)r);
 		__m256i l2 = _mm256_loadu_si256((const __m256i*)l+1);
 		__m256i r2 = _mm256_loadu_si256((const __m256i*)r+1);
-		__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(l1, r1));
-		__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(l2, r2));
+		__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(fold_case_avx2(l1), fold_case_avx2(r1)));
+		__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(fold_case_avx2(l2), fold_case_avx2(r2)));
 		if (_mm256_movemask_epi8(_mm256_and_si256(n1, n2)) != -1) {
 			int o;
 			if ((o = _mm256_movemask_epi8(n1)) != -1)
@@ -253,7 +253,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2)
 	if (padding >= 32) {
 		__m256i l1 = _mm256_loadu_si256((const __m256i*)l);
 		__m256i r1 = _mm256_loadu_si256((const __m256i*)r);
-		int o = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(l1, r1)));
+		int o = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(fold_case_avx2(l1), fold_case_avx2(r1))));
 		if (o != -1) {
 			o = trailing_zeros(~o);
 			return l-s1+o;
@@ -265,7 +265,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2)
 	if (padding >= 16) {
 		__m128i l1 = _mm_loadu_si128((const __m128i*)l);
 		__m128i r1 = _mm_loadu_si128((const __m128i*)r);
-		int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero128), _mm_cmpeq_epi8(l1, r1)));
+		int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero128), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1))));
 		if (o != 0xffff) {
 			o = trailing_zeros(~o);
 			return l-s1+o;
@@ -275,7 +275,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2)
 		padding -= 16;
 	}
 	while (padding) {
-		if (!*l || *l != *r)
+		if (!*l || fold_case(*l) != fold_case(*r))
 			return l-s1;
 		l++;
 		r++;
@@ -293,10 +293,10 @@ static size_t strdiff_avx2(const char *s1, const char *s2)
 			__m256i r4 = _mm256_load_si256((const __m256i*)r+3);
 			_mm_prefetch(l+256, _MM_HINT_NTA);
 			_mm_prefetch(r+256, _MM_HINT_NTA);
-			__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(l1, r1));
-			__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(l2, r2));
-			__m256i n3 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l3, zero), _mm256_cmpeq_epi8(l3, r3));
-			__m256i n4 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l4, zero), _mm256_cmpeq_epi8(l4, r4));
+			__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(fold_case_avx2(l1), fold_case_avx2(r1)));
+			__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(fold_case_avx2(l2), fold_case_avx2(r2)));
+			__m256i n3 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l3, zero), _mm256_cmpeq_epi8(fold_case_avx2(l3), fold_case_avx2(r3)));
+			__m256i n4 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l4, zero), _mm256_cmpeq_epi8(fold_case_avx2(l4), fold_case_avx2(r4)));
 			if (_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(n1, n2), _mm256_and_si256(n3, n4))) != -1) {
 				int o;
 				if ((o = _mm256_movemask_epi8(n1)) != -1)
@@ -323,8 +323,8 @@ static size_t strdiff_avx2(const char *s1, const char *s2)
 			__m256i r1 = _mm256_loadu_si256((const __m256i*)r);
 			__m256i l2 = _mm256_loadu_si256((const __m256i*)l+1);
 			__m256i r2 = _mm256_loadu_si256((const __m256i*)r+1);
-			__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(l1, r1));
-			__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(l2, r2));
+			__m256i n1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(fold_case_avx2(l1), fold_case_avx2(r1)));
+			__m256i n2 = _mm256_andnot_si256(_mm256_cmpeq_epi8(l2, zero), _mm256_cmpeq_epi8(fold_case_avx2(l2), fold_case_avx2(r2)));
 			if (_mm256_movemask_epi8(_mm256_and_si256(n1, n2)) != -1) {
 				int o;
 				if ((o = _mm256_movemask_epi8(n1)) != -1)
@@ -340,7 +340,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2)
 		if (padding >= 32) {
 			__m256i l1 = _mm256_loadu_si256((const __m256i*)l);
 			__m256i r1 = _mm256_loadu_si256((const __m256i*)r);
-			int o = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(l1, r1)));
+			int o = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi8(l1, zero), _mm256_cmpeq_epi8(fold_case_avx2(l1), fold_case_avx2(r1))));
 			if (o != -1) {
 				o = trailing_zeros(~o);
 				return l-s1+o;
@@ -352,7 +352,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2)
 		if (padding >= 16) {
 			__m128i l1 = _mm_loadu_si128((const __m128i*)l);
 			__m128i r1 = _mm_loadu_si128((const __m128i*)r);
-			int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero128), _mm_cmpeq_epi8(l1, r1)));
+			int o = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(l1, zero128), _mm_cmpeq_epi8(fold_case_sse2(l1), fold_case_sse2(r1))));
 			if (o != 0xffff) {
 				o = trailing_zeros(~o);
 				return l-s1+o;
@@ -362,7 +362,7 @@ static size_t strdiff_avx2(const char *s1, const char *s2)
 			padding -= 16;
 		}
 		while (padding) {
-			if (!*l || *l != *r)
+			if (!*l || fold_case(*l) != fold_case(*r))
 				return l-s1;
 			l++;
 			r++;
@@ -371,47 +371,73 @@ static size_t strdiff_avx2(const char *s1, const char *s2)
 	}
 }
 
-static size_t strdiff_auto(const char *s1, const char *s2);
+__attribute__((__target__("avx512bw,avx512vl")))
+static size_t casediff_avx512(const char *s1, const char *s2)
+{
+	const char *l = s1;
+	const char *r = s2;
+	for (;;) {
+		/* bytes that can be read from both strings without crossing a page */
+		size_t padding1 = 4096 - (uintptr_t)l % 4096;
+		size_t padding2 = 4096 - (uintptr_t)r % 4096;
+		size_t padding = padding1 < padding2 ? padding1 : padding2;
+		while (padding >= 128) {
+			__m512i l1 = _mm512_loadu_si512(l);
+			__m512i l2 = _mm512_loadu_si512(l+64);
+			__m512i r1 = _mm512_loadu_si512(r);
+			__m512i r2 = _mm512_loadu_si512(r+64);
+			uint64_t m1 = _mm512_cmpneq_epi8_mask(fold_case_avx512(l1), fold_case_avx512(r1)) | _mm512_testn_epi8_mask(l1, l1);
+			uint64_t m2 = _mm512_cmpneq_epi8_mask(fold_case_avx512(l2), fold_case_avx512(r2)) | _mm512_testn_epi8_mask(l2, l2);
+			if (m1 | m2)
+				return l-s1 + (m1 ? trailing_zeros64(m1) : trailing_zeros64(m2) + 64);
+			l += 128;
+			r += 128;
+			padding -= 128;
+		}
+		while (padding) {
+			size_t len = padding < 64 ? padding : 64;
+			__mmask64 k = len == 64 ? ~(uint64_t)0 : ((uint64_t)1 << len) - 1;
+			__m512i l1 = _mm512_maskz_loadu_epi8(k, l);
+			__m512i r1 = _mm512_maskz_loadu_epi8(k, r);
+			uint64_t m = (_mm512_cmpneq_epi8_mask(fold_case_avx512(l1), fold_case_avx512(r1)) | _mm512_testn_epi8_mask(l1, l1)) & k;
+			if (m)
+				return l-s1 + trailing_zeros64(m);
+			l += len;
+			r += len;
+			padding -= len;
+		}
+	}
+}
+
+static size_t casediff_auto(const char *s1, const char *s2);
 
-static size_t (*strdiff_impl)(const char *s1, const char *s2) = strdiff_auto;
+static size_t (*casediff_impl)(const char *s1, const char *s2) = casediff_auto;
 
-static size_t strdiff_auto(const char *s1, const char *s2) {
-	if (has_avx2())
-		strdiff_impl = strdiff_avx2;
+__attribute__((visibility("hidden")))
+void __strcasecmp_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		casediff_impl = casediff_avx512;
+	else if (has_avx2())
+		casediff_impl = casediff_avx2;
 	else if (has_sse2())
-		strdiff_impl = strdiff_sse2;
+		casediff_impl = casediff_sse2;
 	else
-		strdiff_impl = strdiff_naive;
-	return strdiff_impl(s1, s2);
+		casediff_impl = casediff_naive;
+}
+
+static size_t casediff_auto(const char *s1, const char *s2) {
+	__strcasecmp_resolve();
+	return casediff_impl(s1, s2);
 }
 
 int strcasecmp(const char *s1, const char *s2) {
-	for (;;) {
-		size_t o = strdiff_impl(s1, s2);
-		s1 += o;
-		s2 += o;
-		if (tolower(*s1) != tolower(*s2))
-			return tolower(*s1) - tolower(*s2);
-		if (*s1 == 0)
-			return 0;
-		s1++;
-		s2++;
-	}
+	size_t o = casediff_impl(s1, s2);
+	return fold_case(s1[o]) - fold_case(s2[o]);
 }
 
 int __strcasecmp_l(const char *l, const char *r, locale_t loc)
 {
-	for (;;) {
-		size_t o = strdiff_impl(l, r);
-		l += o;
-		r += o;
-		if (tolower_l(*l, loc) != tolower_l(*r, loc))
-			return tolower_l(*l, loc) - tolower_l(*r, loc);
-		if (*l == 0)
-			return 0;
-		l++;
-		r++;
-	}
+	return strcasecmp(l, r);
 }
 
 weak_alias(__strcasecmp_l, strcasecmp_l);
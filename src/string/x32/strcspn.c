@@ -198,19 +198,113 @@ static void* rawmemchr3_avx2(const void *haystack, int n1, int n2, int n3) {
 	}
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static void* rawmemchr3_avx512(const void *haystack, int n1, int n2, int n3) {
+	size_t off = (size_t)haystack % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)haystack - off);
+	__m512i vn1 = _mm512_set1_epi8(n1);
+	__m512i vn2 = _mm512_set1_epi8(n2);
+	__m512i vn3 = _mm512_set1_epi8(n3);
+	__m512i x = _mm512_load_si512(ptr);
+	uint64_t mask = (_mm512_cmpeq_epi8_mask(x, vn1) | _mm512_cmpeq_epi8_mask(x, vn2) | _mm512_cmpeq_epi8_mask(x, vn3)) >> off;
+	if (mask)
+		return (char*)haystack + trailing_zeros64(mask);
+	for (;;) {
+		ptr++;
+		x = _mm512_load_si512(ptr);
+		mask = _mm512_cmpeq_epi8_mask(x, vn1) | _mm512_cmpeq_epi8_mask(x, vn2) | _mm512_cmpeq_epi8_mask(x, vn3);
+		if (mask)
+			return (char*)ptr + trailing_zeros64(mask);
+	}
+}
+
+static size_t strcspnN_fallback(const char *s, const char *reject) {
+	uint64_t byteset[4] = {0};
+	byteset[0] |= 1;
+	while (*reject) {
+		byteset[(unsigned char)*reject/64] |= (uint64_t)1 << (unsigned char)*reject%64;
+		reject++;
+	}
+	size_t i = 0;
+	while (!(byteset[(unsigned char)s[i]/64] & (uint64_t)1 << (unsigned char)s[i]%64))
+		i++;
+	return i;
+}
+
+__attribute__((__target__("avx2")))
+static size_t strcspnN_avx2(const char *s, const char *reject) {
+	unsigned char table[32];
+	byteset_nibbles(table, reject);
+	table[0] |= 1;
+	__m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table));
+	__m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table+1));
+	size_t off = (size_t)s % 32;
+	const __m256i *ptr = (const __m256i*)(s - off);
+	uint32_t mask = byteset_match_avx2(_mm256_load_si256(ptr), lo, hi) >> off;
+	if (mask)
+		return trailing_zeros(mask);
+	for (;;) {
+		ptr++;
+		mask = byteset_match_avx2(_mm256_load_si256(ptr), lo, hi);
+		if (mask)
+			return (const char*)ptr + trailing_zeros(mask) - s;
+	}
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static size_t strcspnN_avx512(const char *s, const char *reject) {
+	unsigned char table[32];
+	byteset_nibbles(table, reject);
+	table[0] |= 1;
+	__m512i lo = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)table));
+	__m512i hi = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)table+1));
+	size_t off = (size_t)s % 64;
+	const __m512i *ptr = (const __m512i*)(s - off);
+	uint64_t mask = byteset_match_avx512(_mm512_load_si512(ptr), lo, hi) >> off;
+	if (mask)
+		return trailing_zeros64(mask);
+	for (;;) {
+		ptr++;
+		mask = byteset_match_avx512(_mm512_load_si512(ptr), lo, hi);
+		if (mask)
+			return (const char*)ptr + trailing_zeros64(mask) - s;
+	}
+}
+
 static void *rawmemchr3_auto(const void *haystack, int n1, int n2, int n3);
+static size_t strcspnN_auto(const char *s, const char *reject);
 
 static void *(*rawmemchr3_impl)(const void *haystack, int n1, int n2, int n3) = rawmemchr3_auto;
+static size_t (*strcspnN_impl)(const char *s, const char *reject) = strcspnN_auto;
 
-static void *rawmemchr3_auto(const void *haystack, int n1, int n2, int n3) {
-	if (has_avx2())
+__attribute__((visibility("hidden")))
+void __strcspn_resolve(void) {
+	if (has_avx512bw() && has_avx512vl()) {
+		rawmemchr3_impl = rawmemchr3_avx512;
+		strcspnN_impl = strcspnN_avx512;
+	}
+	else if (has_avx2()) {
 		rawmemchr3_impl = rawmemchr3_avx2;
-	else if (has_sse2())
+		strcspnN_impl = strcspnN_avx2;
+	}
+	else if (has_sse2()) {
 		rawmemchr3_impl = rawmemchr3_sse2;
-	else
+		strcspnN_impl = strcspnN_fallback;
+	}
+	else {
 		rawmemchr3_impl = rawmemchr3_fallback;
+		strcspnN_impl = strcspnN_fallback;
+	}
+}
+
+static void *rawmemchr3_auto(const void *haystack, int n1, int n2, int n3) {
+	__strcspn_resolve();
 	return rawmemchr3_impl(haystack, n1, n2, n3);
 }
+static size_t strcspnN_auto(const char *s, const char *reject) {
+	__strcspn_resolve();
+	return strcspnN_impl(s, reject);
+}
 
 size_t strcspn(const char *s, const char *reject) {
 	extern char *strchrnul(const char *s, int c);
@@ -220,14 +314,5 @@ size_t strcspn(const char *s, const char *reject) {
 		return strchrnul(s, (unsigned char)reject[0]) - s;
 	else if (!reject[2])
 		return (char*)rawmemchr3_impl(s, (unsigned char)reject[0], (unsigned char)reject[1], (unsigned char)reject[2]) - s;
-	uint64_t byteset[4] = {0};
-	byteset[0] |= 1;
-	while (*reject) {
-		byteset[(unsigned char)*reject/64] |= (uint64_t)1 << (unsigned char)*reject%64;
-		reject++;
-	}
-	size_t i = 0;
-	while (!(byteset[(unsigned char)s[i]/64] & (uint64_t)1 << (unsigned char)s[i]%64))
-		i++;
-	return i;
+	return strcspnN_impl(s, reject);
 }
@@ -0,0 +1,15 @@
+#define _BSD_SOURCE
+#include <string.h>
+
+hidden char *__stpncpy_nofill(char *, const char *, size_t);
+
+size_t strlcpy(char *d, const char *s, size_t n)
+{
+	if (!n)
+		return strlen(s);
+	char *e = __stpncpy_nofill(d, s, n - 1);
+	*e = 0;
+	if (e < d + n - 1)
+		return e - d;
+	return n - 1 + strlen(s + n - 1);
+}
@@ -408,17 +408,68 @@ static int strncmp_avx2(const char *s1, const char *s2, size_t n)
 	}
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static int strncmp_avx512(const char *s1, const char *s2, size_t n)
+{
+	const unsigned char *l = (const unsigned char *)s1;
+	const unsigned char *r = (const unsigned char *)s2;
+	while (n) {
+		/* bytes that can be read from both strings without crossing a page */
+		size_t padding1 = 4096 - (uintptr_t)l % 4096;
+		size_t padding2 = 4096 - (uintptr_t)r % 4096;
+		size_t padding = padding1 < padding2 ? padding1 : padding2;
+		if (padding > n)
+			padding = n;
+		n -= padding;
+		while (padding >= 128) {
+			__m512i l1 = _mm512_loadu_si512(l);
+			__m512i l2 = _mm512_loadu_si512(l+64);
+			uint64_t m1 = _mm512_cmpneq_epi8_mask(l1, _mm512_loadu_si512(r)) | _mm512_testn_epi8_mask(l1, l1);
+			uint64_t m2 = _mm512_cmpneq_epi8_mask(l2, _mm512_loadu_si512(r+64)) | _mm512_testn_epi8_mask(l2, l2);
+			if (m1 | m2) {
+				int o = m1 ? trailing_zeros64(m1) : trailing_zeros64(m2) + 64;
+				return l[o]-r[o];
+			}
+			l += 128;
+			r += 128;
+			padding -= 128;
+		}
+		while (padding) {
+			size_t len = padding < 64 ? padding : 64;
+			__mmask64 k = len == 64 ? ~(uint64_t)0 : ((uint64_t)1 << len) - 1;
+			__m512i l1 = _mm512_maskz_loadu_epi8(k, l);
+			__m512i r1 = _mm512_maskz_loadu_epi8(k, r);
+			uint64_t m = (_mm512_cmpneq_epi8_mask(l1, r1) | _mm512_testn_epi8_mask(l1, l1)) & k;
+			if (m) {
+				int o = trailing_zeros64(m);
+				return l[o]-r[o];
+			}
+			l += len;
+			r += len;
+			padding -= len;
+		}
+	}
+	return 0;
+}
+
 static int strncmp_auto(const char *s1, const char *s2, size_t n);
 
 static int (*strncmp_impl)(const char *s1, const char *s2, size_t n) = strncmp_auto;
 
-static int strncmp_auto(const char *s1, const char *s2, size_t n) {
-	if (has_avx2())
+__attribute__((visibility("hidden")))
+void __strncmp_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		strncmp_impl = strncmp_avx512;
+	else if (has_avx2())
 		strncmp_impl = strncmp_avx2;
 	else if (has_sse2())
 		strncmp_impl = strncmp_sse2;
 	else
 		strncmp_impl = strncmp_naive;
+}
+
+static int strncmp_auto(const char *s1, const char *s2, size_t n) {
+	__strncmp_resolve();
 	return strncmp_impl(s1, s2, n);
 }
 
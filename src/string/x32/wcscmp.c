@@ -0,0 +1,113 @@
+#include <wchar.h>
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "helpers.h"
+
+static int wcscmp_fallback(const wchar_t *l, const wchar_t *r) {
+	for (; *l == *r && *l && *r; l++, r++);
+	return *l < *r ? -1 : *l > *r;
+}
+
+/*
+ * Both strings are read with unaligned loads. When either load could cross
+ * into the next page, a single element is compared instead, so no read goes
+ * past the first difference or terminator into an unmapped page.
+ */
+
+__attribute__((__target__("sse2")))
+static int wcscmp_sse2(const wchar_t *l, const wchar_t *r) {
+	const __m128i zero = _mm_set1_epi32(0);
+	for (;;) {
+		if ((uintptr_t)l % 4096 > 4096 - 16 || (uintptr_t)r % 4096 > 4096 - 16) {
+			if (*l != *r || !*l)
+				return *l < *r ? -1 : *l > *r;
+			l++;
+			r++;
+			continue;
+		}
+		__m128i a = _mm_loadu_si128((const __m128i*)l);
+		__m128i b = _mm_loadu_si128((const __m128i*)r);
+		uint32_t eq = _mm_movemask_epi8(_mm_cmpeq_epi32(a, b));
+		uint32_t z = _mm_movemask_epi8(_mm_cmpeq_epi32(a, zero));
+		uint32_t mask = (eq ^ 0xffff) | z;
+		if (mask) {
+			size_t i = trailing_zeros(mask) / 4;
+			return l[i] < r[i] ? -1 : l[i] > r[i];
+		}
+		l += 4;
+		r += 4;
+	}
+}
+
+__attribute__((__target__("avx2")))
+static int wcscmp_avx2(const wchar_t *l, const wchar_t *r) {
+	const __m256i zero = _mm256_set1_epi32(0);
+	for (;;) {
+		if ((uintptr_t)l % 4096 > 4096 - 32 || (uintptr_t)r % 4096 > 4096 - 32) {
+			if (*l != *r || !*l)
+				return *l < *r ? -1 : *l > *r;
+			l++;
+			r++;
+			continue;
+		}
+		__m256i a = _mm256_loadu_si256((const __m256i*)l);
+		__m256i b = _mm256_loadu_si256((const __m256i*)r);
+		uint32_t eq = _mm256_movemask_epi8(_mm256_cmpeq_epi32(a, b));
+		uint32_t z = _mm256_movemask_epi8(_mm256_cmpeq_epi32(a, zero));
+		uint32_t mask = (eq ^ 0xffffffff) | z;
+		if (mask) {
+			size_t i = trailing_zeros(mask) / 4;
+			return l[i] < r[i] ? -1 : l[i] > r[i];
+		}
+		l += 8;
+		r += 8;
+	}
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static int wcscmp_avx512(const wchar_t *l, const wchar_t *r) {
+	for (;;) {
+		if ((uintptr_t)l % 4096 > 4096 - 64 || (uintptr_t)r % 4096 > 4096 - 64) {
+			if (*l != *r || !*l)
+				return *l < *r ? -1 : *l > *r;
+			l++;
+			r++;
+			continue;
+		}
+		__m512i a = _mm512_loadu_si512(l);
+		__m512i b = _mm512_loadu_si512(r);
+		uint32_t mask = _mm512_cmpneq_epi32_mask(a, b) | _mm512_testn_epi32_mask(a, a);
+		if (mask) {
+			size_t i = trailing_zeros(mask);
+			return l[i] < r[i] ? -1 : l[i] > r[i];
+		}
+		l += 16;
+		r += 16;
+	}
+}
+
+static int wcscmp_auto(const wchar_t *l, const wchar_t *r);
+
+static int (*wcscmp_impl)(const wchar_t *l, const wchar_t *r) = wcscmp_auto;
+
+__attribute__((visibility("hidden")))
+void __wcscmp_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		wcscmp_impl = wcscmp_avx512;
+	else if (has_avx2())
+		wcscmp_impl = wcscmp_avx2;
+	else if (has_sse2())
+		wcscmp_impl = wcscmp_sse2;
+	else
+		wcscmp_impl = wcscmp_fallback;
+}
+
+static int wcscmp_auto(const wchar_t *l, const wchar_t *r) {
+	__wcscmp_resolve();
+	return wcscmp_impl(l, r);
+}
+
+int wcscmp(const wchar_t *l, const wchar_t *r) {
+	return wcscmp_impl(l, r);
+}
@@ -0,0 +1,128 @@
+#include <wchar.h>
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "helpers.h"
+
+static wchar_t *wcsrchr_fallback(const wchar_t *s, wchar_t c) {
+	const wchar_t *p;
+	for (p = s + wcslen(s); p >= s && *p != c; p--);
+	return p >= s ? (wchar_t*)p : NULL;
+}
+
+__attribute__((__target__("sse2")))
+static wchar_t *wcsrchr_sse2(const wchar_t *s, wchar_t c) {
+	const __m128i vc = _mm_set1_epi32(c);
+	const __m128i zero = _mm_set1_epi32(0);
+	size_t off = (uintptr_t)s % 16;
+	const __m128i *ptr = (const __m128i*)((const char*)s - off);
+	__m128i x = _mm_load_si128(ptr);
+	uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi32(x, vc)) >> off << off;
+	uint32_t zmask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi32(x, zero)) >> off << off;
+	/* only the last block with a match is remembered */
+	const __m128i *found = ptr;
+	uint32_t fmask = 0;
+	while (!zmask) {
+		if (mask) {
+			found = ptr;
+			fmask = mask;
+		}
+		ptr++;
+		x = _mm_load_si128(ptr);
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi32(x, vc));
+		zmask = _mm_movemask_epi8(_mm_cmpeq_epi32(x, zero));
+	}
+	/* the terminator itself matches when c is zero */
+	mask &= zmask ^ (zmask - 1);
+	if (mask)
+		return (wchar_t*)ptr + (31 - leading_zeros(mask)) / 4;
+	if (fmask)
+		return (wchar_t*)found + (31 - leading_zeros(fmask)) / 4;
+	return NULL;
+}
+
+__attribute__((__target__("avx2")))
+static wchar_t *wcsrchr_avx2(const wchar_t *s, wchar_t c) {
+	const __m256i vc = _mm256_set1_epi32(c);
+	const __m256i zero = _mm256_set1_epi32(0);
+	size_t off = (uintptr_t)s % 32;
+	const __m256i *ptr = (const __m256i*)((const char*)s - off);
+	__m256i x = _mm256_load_si256(ptr);
+	uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(x, vc)) >> off << off;
+	uint32_t zmask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(x, zero)) >> off << off;
+	/* only the last block with a match is remembered */
+	const __m256i *found = ptr;
+	uint32_t fmask = 0;
+	while (!zmask) {
+		if (mask) {
+			found = ptr;
+			fmask = mask;
+		}
+		ptr++;
+		x = _mm256_load_si256(ptr);
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi32(x, vc));
+		zmask = _mm256_movemask_epi8(_mm256_cmpeq_epi32(x, zero));
+	}
+	/* the terminator itself matches when c is zero */
+	mask &= zmask ^ (zmask - 1);
+	if (mask)
+		return (wchar_t*)ptr + (31 - leading_zeros(mask)) / 4;
+	if (fmask)
+		return (wchar_t*)found + (31 - leading_zeros(fmask)) / 4;
+	return NULL;
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static wchar_t *wcsrchr_avx512(const wchar_t *s, wchar_t c) {
+	const __m512i vc = _mm512_set1_epi32(c);
+	size_t off = (uintptr_t)s % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)s - off);
+	__m512i x = _mm512_load_si512(ptr);
+	uint32_t mask = (uint32_t)_mm512_cmpeq_epi32_mask(x, vc) >> off / 4 << off / 4;
+	uint32_t zmask = (uint32_t)_mm512_testn_epi32_mask(x, x) >> off / 4 << off / 4;
+	/* only the last block with a match is remembered */
+	const __m512i *found = ptr;
+	uint32_t fmask = 0;
+	while (!zmask) {
+		if (mask) {
+			found = ptr;
+			fmask = mask;
+		}
+		ptr++;
+		x = _mm512_load_si512(ptr);
+		mask = _mm512_cmpeq_epi32_mask(x, vc);
+		zmask = _mm512_testn_epi32_mask(x, x);
+	}
+	/* the terminator itself matches when c is zero */
+	mask &= zmask ^ (zmask - 1);
+	if (mask)
+		return (wchar_t*)ptr + 31 - leading_zeros(mask);
+	if (fmask)
+		return (wchar_t*)found + 31 - leading_zeros(fmask);
+	return NULL;
+}
+
+static wchar_t *wcsrchr_auto(const wchar_t *s, wchar_t c);
+
+static wchar_t *(*wcsrchr_impl)(const wchar_t *s, wchar_t c) = wcsrchr_auto;
+
+__attribute__((visibility("hidden")))
+void __wcsrchr_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		wcsrchr_impl = wcsrchr_avx512;
+	else if (has_avx2())
+		wcsrchr_impl = wcsrchr_avx2;
+	else if (has_sse2())
+		wcsrchr_impl = wcsrchr_sse2;
+	else
+		wcsrchr_impl = wcsrchr_fallback;
+}
+
+static wchar_t *wcsrchr_auto(const wchar_t *s, wchar_t c) {
+	__wcsrchr_resolve();
+	return wcsrchr_impl(s, c);
+}
+
+wchar_t *wcsrchr(const wchar_t *s, wchar_t c) {
+	return wcsrchr_impl(s, c);
+}
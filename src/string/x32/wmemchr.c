@@ -0,0 +1,119 @@
+#include <wchar.h>
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "helpers.h"
+
+static wchar_t *wmemchr_fallback(const wchar_t *s, wchar_t c, size_t n) {
+	for (; n && *s != c; n--, s++);
+	return n ? (wchar_t*)s : NULL;
+}
+
+__attribute__((__target__("sse2")))
+static wchar_t *wmemchr_sse2(const wchar_t *s, wchar_t c, size_t n) {
+	if (!n)
+		return NULL;
+	const __m128i vc = _mm_set1_epi32(c);
+	size_t off = (uintptr_t)s % 16;
+	const __m128i *ptr = (const __m128i*)((const char*)s - off);
+	uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_load_si128(ptr), vc)) >> off;
+	if (mask) {
+		size_t i = trailing_zeros(mask) / 4;
+		return i < n ? (wchar_t*)s + i : NULL;
+	}
+	if (n <= (16 - off) / 4)
+		return NULL;
+	n -= (16 - off) / 4;
+	for (;;) {
+		ptr++;
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_load_si128(ptr), vc));
+		if (mask) {
+			size_t i = trailing_zeros(mask) / 4;
+			return i < n ? (wchar_t*)ptr + i : NULL;
+		}
+		if (n <= 4)
+			return NULL;
+		n -= 4;
+	}
+}
+
+__attribute__((__target__("avx2")))
+static wchar_t *wmemchr_avx2(const wchar_t *s, wchar_t c, size_t n) {
+	if (!n)
+		return NULL;
+	const __m256i vc = _mm256_set1_epi32(c);
+	size_t off = (uintptr_t)s % 32;
+	const __m256i *ptr = (const __m256i*)((const char*)s - off);
+	uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_load_si256(ptr), vc)) >> off;
+	if (mask) {
+		size_t i = trailing_zeros(mask) / 4;
+		return i < n ? (wchar_t*)s + i : NULL;
+	}
+	if (n <= (32 - off) / 4)
+		return NULL;
+	n -= (32 - off) / 4;
+	for (;;) {
+		ptr++;
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_load_si256(ptr), vc));
+		if (mask) {
+			size_t i = trailing_zeros(mask) / 4;
+			return i < n ? (wchar_t*)ptr + i : NULL;
+		}
+		if (n <= 8)
+			return NULL;
+		n -= 8;
+	}
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static wchar_t *wmemchr_avx512(const wchar_t *s, wchar_t c, size_t n) {
+	if (!n)
+		return NULL;
+	const __m512i vc = _mm512_set1_epi32(c);
+	size_t off = (uintptr_t)s % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)s - off);
+	uint32_t mask = _mm512_cmpeq_epi32_mask(_mm512_load_si512(ptr), vc) >> off / 4;
+	if (mask) {
+		size_t i = trailing_zeros(mask);
+		return i < n ? (wchar_t*)s + i : NULL;
+	}
+	if (n <= (64 - off) / 4)
+		return NULL;
+	n -= (64 - off) / 4;
+	for (;;) {
+		ptr++;
+		mask = _mm512_cmpeq_epi32_mask(_mm512_load_si512(ptr), vc);
+		if (mask) {
+			size_t i = trailing_zeros(mask);
+			return i < n ? (wchar_t*)ptr + i : NULL;
+		}
+		if (n <= 16)
+			return NULL;
+		n -= 16;
+	}
+}
+
+static wchar_t *wmemchr_auto(const wchar_t *s, wchar_t c, size_t n);
+
+static wchar_t *(*wmemchr_impl)(const wchar_t *s, wchar_t c, size_t n) = wmemchr_auto;
+
+__attribute__((visibility("hidden")))
+void __wmemchr_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		wmemchr_impl = wmemchr_avx512;
+	else if (has_avx2())
+		wmemchr_impl = wmemchr_avx2;
+	else if (has_sse2())
+		wmemchr_impl = wmemchr_sse2;
+	else
+		wmemchr_impl = wmemchr_fallback;
+}
+
+static wchar_t *wmemchr_auto(const wchar_t *s, wchar_t c, size_t n) {
+	__wmemchr_resolve();
+	return wmemchr_impl(s, c, n);
+}
+
+wchar_t *wmemchr(const wchar_t *s, wchar_t c, size_t n) {
+	return wmemchr_impl(s, c, n);
+}
@@ -35,7 +35,7 @@ static int wmemcmp_naive(const wchar_t *s1, const wchar_t *s2, size_t n)
 {
 	while (n) {
 		if (*s1 != *s2)
-			return *s1-*s2;
+			return *s1 < *s2 ? -1 : 1;
 		s1++;
 		s2++;
 		n--;
@@ -100,7 +100,7 @@ static int wmemcmp_sse2(const wchar_t *s1, const wchar_t *s2, size_t n)
 				l++;
 				r++;
 			}
-			return *l-*r;
+			return *l < *r ? -1 : 1;
 		}
 		l += 32;
 		r += 32;
@@ -128,8 +128,8 @@ static int wmemcmp_sse2(const wchar_t *s1, const wchar_t *s2, size_t n)
 			else if ((o = _mm_movemask_epi8(n3)) != 0xffff)
 				o = trailing_zeros(~o) / sizeof(wchar_t) + 8;
 			else
-				o = trailing_zeros(~_mm_movemask_epi8(n2)) / sizeof(wchar_t) + 12;
-			return l[o]-r[o];
+				o = trailing_zeros(~_mm_movemask_epi8(n4)) / sizeof(wchar_t) + 12;
+			return l[o] < r[o] ? -1 : 1;
 		}
 		l += 16;
 		r += 16;
@@ -148,7 +148,7 @@ static int wmemcmp_sse2(const wchar_t *s1, const wchar_t *s2, size_t n)
 				o = trailing_zeros(~o) / sizeof(wchar_t);
 			else
 				o = trailing_zeros(~_mm_movemask_epi8(n2)) / sizeof(wchar_t) + 4;
-			return l[o]-r[o];
+			return l[o] < r[o] ? -1 : 1;
 		}
 		l += 8;
 		r += 8;
@@ -160,7 +160,7 @@ static int wmemcmp_sse2(const wchar_t *s1, const wchar_t *s2, size_t n)
 		int o = _mm_movemask_epi8(_mm_cmpeq_epi8(l1, r1));
 		if (o != 0xffff) {
 			o = trailing_zeros(~o) / sizeof(wchar_t);
-			return l[o]-r[o];
+			return l[o] < r[o] ? -1 : 1;
 		}
 		l += 4;
 		r += 4;
@@ -230,7 +230,7 @@ static int wmemcmp_avx2(const wchar_t *s1, const wchar_t *s2, size_t n)
 				l++;
 				r++;
 			}
-			return *l-*r;
+			return *l < *r ? -1 : 1;
 		}
 		l += 64;
 		r += 64;
@@ -262,7 +262,7 @@ static int wmemcmp_avx2(const wchar_t *s1, const wchar_t *s2, size_t n)
 				o = trailing_zeros(~o) / sizeof(wchar_t) + 16;
 			else if ((o = _mm256_movemask_epi8(n4)) != -1)
 				o = trailing_zeros(~o) / sizeof(wchar_t) + 24;
-			return l[o]-r[o];
+			return l[o] < r[o] ? -1 : 1;
 		}
 		l += 32;
 		r += 32;
@@ -281,7 +281,7 @@ static int wmemcmp_avx2(const wchar_t *s1, const wchar_t *s2, size_t n)
 				o = trailing_zeros(~o) / sizeof(wchar_t);
 			else
 				o = trailing_zeros(~_mm256_movemask_epi8(n2)) / sizeof(wchar_t) + 8;
-			return l[o]-r[o];
+			return l[o] < r[o] ? -1 : 1;
 		}
 		l += 16;
 		r += 16;
@@ -293,7 +293,7 @@ static int wmemcmp_avx2(const wchar_t *s1, const wchar_t *s2, size_t n)
 		int o = _mm256_movemask_epi8(_mm256_cmpeq_epi8(l1, r1));
 		if (o != -1) {
 			o = trailing_zeros(~o) / sizeof(wchar_t);
-			return l[o]-r[o];
+			return l[o] < r[o] ? -1 : 1;
 		}
 		l += 8;
 		r += 8;
@@ -305,7 +305,7 @@ static int wmemcmp_avx2(const wchar_t *s1, const wchar_t *s2, size_t n)
 		int o = _mm_movemask_epi8(_mm_cmpeq_epi8(l1, r1));
 		if (o != 0xffff) {
 			o = trailing_zeros(~o) / sizeof(wchar_t);
-			return l[o]-r[o];
+			return l[o] < r[o] ? -1 : 1;
 		}
 		l += 4;
 		r += 4;
@@ -318,13 +318,18 @@ static int wmemcmp_auto(const wchar_t *s1, const wchar_t *s2, size_t n);
 
 static int (*wmemcmp_impl)(const wchar_t *s1, const wchar_t *s2, size_t n) = wmemcmp_auto;
 
-static int wmemcmp_auto(const wchar_t *s1, const wchar_t *s2, size_t n) {
+__attribute__((visibility("hidden")))
+void __wmemcmp_resolve(void) {
 	if (has_avx2())
 		wmemcmp_impl = wmemcmp_avx2;
 	else if (has_sse2())
 		wmemcmp_impl = wmemcmp_sse2;
 	else
 		wmemcmp_impl = wmemcmp_naive;
+}
+
+static int wmemcmp_auto(const wchar_t *s1, const wchar_t *s2, size_t n) {
+	__wmemcmp_resolve();
 	return wmemcmp_impl(s1, s2, n);
 }
 
@@ -91,15 +91,144 @@ static char *stpcpy_sse2(char *restrict dest, const char *restrict src) {
 	}
 }
 
+/*
+ * The source is scanned with aligned loads, so no read crosses into a page
+ * past the terminator. The copy trails the scan and only loads bytes that
+ * are already known to come before it.
+ */
+
+__attribute__((__target__("avx2")))
+static char *stpcpy_avx2(char *restrict dest, const char *restrict src) {
+	const __m256i zero = _mm256_set1_epi8(0);
+	size_t off = (uintptr_t)src % 32;
+	const __m256i *ptr = (const __m256i*)(src - off);
+	uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(ptr), zero)) >> off;
+	if (mask) {
+		size_t n = trailing_zeros(mask);
+		copy_small(dest, src, n + 1);
+		return dest + n;
+	}
+	const char *s = src;
+	char *d = dest;
+	for (;;) {
+		ptr++;
+		if ((uintptr_t)ptr % 128 == 0) {
+			for (;;) {
+				__m256i a = _mm256_load_si256(ptr);
+				__m256i b = _mm256_load_si256(ptr+1);
+				__m256i c = _mm256_load_si256(ptr+2);
+				__m256i e = _mm256_load_si256(ptr+3);
+				__m256i min = _mm256_min_epu8(_mm256_min_epu8(a, b), _mm256_min_epu8(c, e));
+				if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(min, zero)))
+					break;
+				__m256i chunk1 = _mm256_loadu_si256((const __m256i*)s+0);
+				__m256i chunk2 = _mm256_loadu_si256((const __m256i*)s+1);
+				__m256i chunk3 = _mm256_loadu_si256((const __m256i*)s+2);
+				__m256i chunk4 = _mm256_loadu_si256((const __m256i*)s+3);
+				_mm256_storeu_si256((__m256i*)d+0, chunk1);
+				_mm256_storeu_si256((__m256i*)d+1, chunk2);
+				_mm256_storeu_si256((__m256i*)d+2, chunk3);
+				_mm256_storeu_si256((__m256i*)d+3, chunk4);
+				s += 128;
+				d += 128;
+				ptr += 4;
+			}
+		}
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(ptr), zero));
+		if (mask)
+			break;
+		_mm256_storeu_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+		s += 32;
+		d += 32;
+	}
+	const char *end = (const char*)ptr + trailing_zeros(mask) + 1;
+	size_t n = end - src;
+	if (n <= 32) {
+		copy_small(dest, src, n);
+		return dest + n - 1;
+	}
+	if (end - s > 32)
+		_mm256_storeu_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+	_mm256_storeu_si256((__m256i*)(dest+n)-1, _mm256_loadu_si256((const __m256i*)end-1));
+	return dest + n - 1;
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static char *stpcpy_avx512(char *restrict dest, const char *restrict src) {
+	size_t off = (uintptr_t)src % 64;
+	const __m512i *ptr = (const __m512i*)(src - off);
+	__m512i x = _mm512_load_si512(ptr);
+	uint64_t mask = _mm512_testn_epi8_mask(x, x) >> off;
+	if (mask) {
+		size_t n = trailing_zeros64(mask);
+		uint64_t m = (uint64_t)-1 >> (63 - n);
+		_mm512_mask_storeu_epi8(dest, m, _mm512_maskz_loadu_epi8(m, src));
+		return dest + n;
+	}
+	const char *s = src;
+	char *d = dest;
+	for (;;) {
+		ptr++;
+		if ((uintptr_t)ptr % 256 == 0) {
+			for (;;) {
+				__m512i a = _mm512_load_si512(ptr);
+				__m512i b = _mm512_load_si512(ptr+1);
+				__m512i c = _mm512_load_si512(ptr+2);
+				__m512i e = _mm512_load_si512(ptr+3);
+				__m512i min = _mm512_min_epu8(_mm512_min_epu8(a, b), _mm512_min_epu8(c, e));
+				if (_mm512_testn_epi8_mask(min, min))
+					break;
+				__m512i chunk1 = _mm512_loadu_si512(s);
+				__m512i chunk2 = _mm512_loadu_si512(s+64);
+				__m512i chunk3 = _mm512_loadu_si512(s+128);
+				__m512i chunk4 = _mm512_loadu_si512(s+192);
+				_mm512_storeu_si512(d, chunk1);
+				_mm512_storeu_si512(d+64, chunk2);
+				_mm512_storeu_si512(d+128, chunk3);
+				_mm512_storeu_si512(d+192, chunk4);
+				s += 256;
+				d += 256;
+				ptr += 4;
+			}
+		}
+		x = _mm512_load_si512(ptr);
+		mask = _mm512_testn_epi8_mask(x, x);
+		if (mask)
+			break;
+		_mm512_storeu_si512(d, _mm512_loadu_si512(s));
+		s += 64;
+		d += 64;
+	}
+	size_t n = (const char*)ptr + trailing_zeros64(mask) + 1 - s;
+	if (n > 64) {
+		_mm512_storeu_si512(d, _mm512_loadu_si512(s));
+		s += 64;
+		d += 64;
+		n -= 64;
+	}
+	uint64_t m = (uint64_t)-1 >> (64 - n);
+	_mm512_mask_storeu_epi8(d, m, _mm512_maskz_loadu_epi8(m, s));
+	return d + n - 1;
+}
+
 static char *stpcpy_auto(char *restrict dest, const char *restrict src);
 
 static char *(*stpcpy_impl)(char *restrict dest, const char *restrict src) = stpcpy_auto;
 
-static char *stpcpy_auto(char *restrict dest, const char *restrict src) {
-	if (has_sse2())
+__attribute__((visibility("hidden")))
+void __stpcpy_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		stpcpy_impl = stpcpy_avx512;
+	else if (has_avx2())
+		stpcpy_impl = stpcpy_avx2;
+	else if (has_sse2())
 		stpcpy_impl = stpcpy_sse2;
 	else
 		stpcpy_impl = stpcpy_naive;
+}
+
+static char *stpcpy_auto(char *restrict dest, const char *restrict src) {
+	__stpcpy_resolve();
 	return stpcpy_impl(dest, src);
 }
 
@@ -0,0 +1,166 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "helpers.h"
+
+/* c[0] and c[l-1] are already known to match n case-insensitively */
+static int casematch(const char *c, const char *n, size_t l)
+{
+	return l < 3 || !strncasecmp(c + 1, n + 1, l - 2);
+}
+
+static char *strcasestr_naive(const char *h, const char *n)
+{
+	size_t l = strlen(n);
+	for (; *h; h++)
+		if (!strncasecmp(h, n, l))
+			return (char*)h;
+	return NULL;
+}
+
+/*
+ * Same scheme as strstr: candidates are positions where both the first
+ * and the last byte of the needle match after folding. The last bytes are
+ * read with aligned loads so the scan never touches a page past the
+ * terminator; the first bytes lie at lower addresses and are already
+ * known to be valid.
+ */
+
+__attribute__((__target__("sse2")))
+static char *strcasestr_sse2(const char *h, const char *n)
+{
+	size_t l = strlen(n);
+	if (strnlen(h, l) < l)
+		return NULL;
+	const char *e = h + l - 1;
+	unsigned char f0 = fold_case(n[0]), f1 = fold_case(n[l-1]);
+	for (; (uintptr_t)e % 16; e++) {
+		if (!*e)
+			return NULL;
+		if (fold_case(*e) == f1 && fold_case(e[1-l]) == f0 && casematch(e + 1 - l, n, l))
+			return (char*)e + 1 - l;
+	}
+	__m128i first = _mm_set1_epi8(f0);
+	__m128i last = _mm_set1_epi8(f1);
+	__m128i zero = _mm_set1_epi8(0);
+	for (;; e += 16) {
+		__m128i bl = _mm_load_si128((const void*)e);
+		__m128i bf = _mm_loadu_si128((const void*)(e + 1 - l));
+		__m128i eq = _mm_and_si128(_mm_cmpeq_epi8(fold_case_sse2(bf), first), _mm_cmpeq_epi8(fold_case_sse2(bl), last));
+		uint32_t mask = _mm_movemask_epi8(eq);
+		uint32_t zmask = _mm_movemask_epi8(_mm_cmpeq_epi8(bl, zero));
+		if (zmask)
+			mask &= (zmask & -zmask) - 1;
+		while (mask) {
+			const char *c = e + 1 - l + trailing_zeros(mask);
+			if (casematch(c, n, l))
+				return (char*)c;
+			mask &= mask - 1;
+		}
+		if (zmask)
+			return NULL;
+	}
+}
+
+__attribute__((__target__("avx2")))
+static char *strcasestr_avx2(const char *h, const char *n)
+{
+	size_t l = strlen(n);
+	if (strnlen(h, l) < l)
+		return NULL;
+	const char *e = h + l - 1;
+	unsigned char f0 = fold_case(n[0]), f1 = fold_case(n[l-1]);
+	for (; (uintptr_t)e % 32; e++) {
+		if (!*e)
+			return NULL;
+		if (fold_case(*e) == f1 && fold_case(e[1-l]) == f0 && casematch(e + 1 - l, n, l))
+			return (char*)e + 1 - l;
+	}
+	__m256i first = _mm256_set1_epi8(f0);
+	__m256i last = _mm256_set1_epi8(f1);
+	__m256i zero = _mm256_set1_epi8(0);
+	for (;; e += 32) {
+		__m256i bl = _mm256_load_si256((const void*)e);
+		__m256i bf = _mm256_loadu_si256((const void*)(e + 1 - l));
+		__m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(fold_case_avx2(bf), first), _mm256_cmpeq_epi8(fold_case_avx2(bl), last));
+		uint32_t mask = _mm256_movemask_epi8(eq);
+		uint32_t zmask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(bl, zero));
+		if (zmask)
+			mask &= (zmask & -zmask) - 1;
+		while (mask) {
+			const char *c = e + 1 - l + trailing_zeros(mask);
+			if (casematch(c, n, l))
+				return (char*)c;
+			mask &= mask - 1;
+		}
+		if (zmask)
+			return NULL;
+	}
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static char *strcasestr_avx512(const char *h, const char *n)
+{
+	size_t l = strlen(n);
+	if (strnlen(h, l) < l)
+		return NULL;
+	const char *e = h + l - 1;
+	unsigned char f0 = fold_case(n[0]), f1 = fold_case(n[l-1]);
+	for (; (uintptr_t)e % 64; e++) {
+		if (!*e)
+			return NULL;
+		if (fold_case(*e) == f1 && fold_case(e[1-l]) == f0 && casematch(e + 1 - l, n, l))
+			return (char*)e + 1 - l;
+	}
+	__m512i first = _mm512_set1_epi8(f0);
+	__m512i last = _mm512_set1_epi8(f1);
+	for (;; e += 64) {
+		__m512i bl = _mm512_load_si512(e);
+		__m512i bf = _mm512_loadu_si512(e + 1 - l);
+		uint64_t mask = _mm512_mask_cmpeq_epi8_mask(_mm512_cmpeq_epi8_mask(fold_case_avx512(bf), first), fold_case_avx512(bl), last);
+		uint64_t zmask = _mm512_testn_epi8_mask(bl, bl);
+		if (zmask)
+			mask &= (zmask & -zmask) - 1;
+		while (mask) {
+			const char *c = e + 1 - l + trailing_zeros64(mask);
+			if (casematch(c, n, l))
+				return (char*)c;
+			mask &= mask - 1;
+		}
+		if (zmask)
+			return NULL;
+	}
+}
+
+static char *strcasestr_auto(const char *h, const char *n);
+
+static char *(*strcasestr_impl)(const char *h, const char *n) = strcasestr_auto;
+
+__attribute__((visibility("hidden")))
+void __strcasestr_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		strcasestr_impl = strcasestr_avx512;
+	else if (has_avx2())
+		strcasestr_impl = strcasestr_avx2;
+	else if (has_sse2())
+		strcasestr_impl = strcasestr_sse2;
+	else
+		strcasestr_impl = strcasestr_naive;
+}
+
+static char *strcasestr_auto(const char *h, const char *n) {
+	__strcasestr_resolve();
+	return strcasestr_impl(h, n);
+}
+
+char *strcasestr(const char *h, const char *n)
+{
+	/* like the generic version, an empty needle only matches a non-empty h */
+	if (!n[0])
+		return *h ? (char*)h : NULL;
+	return strcasestr_impl(h, n);
+}
@@ -384,17 +384,64 @@ static int strcmp_avx2(const char *s1, const char *s2)
 	}
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static int strcmp_avx512(const char *s1, const char *s2)
+{
+	const unsigned char *l = (const unsigned char *)s1;
+	const unsigned char *r = (const unsigned char *)s2;
+	for (;;) {
+		/* bytes that can be read from both strings without crossing a page */
+		size_t padding1 = 4096 - (uintptr_t)l % 4096;
+		size_t padding2 = 4096 - (uintptr_t)r % 4096;
+		size_t padding = padding1 < padding2 ? padding1 : padding2;
+		while (padding >= 128) {
+			__m512i l1 = _mm512_loadu_si512(l);
+			__m512i l2 = _mm512_loadu_si512(l+64);
+			uint64_t m1 = _mm512_cmpneq_epi8_mask(l1, _mm512_loadu_si512(r)) | _mm512_testn_epi8_mask(l1, l1);
+			uint64_t m2 = _mm512_cmpneq_epi8_mask(l2, _mm512_loadu_si512(r+64)) | _mm512_testn_epi8_mask(l2, l2);
+			if (m1 | m2) {
+				int o = m1 ? trailing_zeros64(m1) : trailing_zeros64(m2) + 64;
+				return l[o]-r[o];
+			}
+			l += 128;
+			r += 128;
+			padding -= 128;
+		}
+		while (padding) {
+			size_t len = padding < 64 ? padding : 64;
+			__mmask64 k = len == 64 ? ~(uint64_t)0 : ((uint64_t)1 << len) - 1;
+			__m512i l1 = _mm512_maskz_loadu_epi8(k, l);
+			__m512i r1 = _mm512_maskz_loadu_epi8(k, r);
+			uint64_t m = (_mm512_cmpneq_epi8_mask(l1, r1) | _mm512_testn_epi8_mask(l1, l1)) & k;
+			if (m) {
+				int o = trailing_zeros64(m);
+				return l[o]-r[o];
+			}
+			l += len;
+			r += len;
+			padding -= len;
+		}
+	}
+}
+
 static int strcmp_auto(const char *s1, const char *s2);
 
 static int (*strcmp_impl)(const char *s1, const char *s2) = strcmp_auto;
 
-static int strcmp_auto(const char *s1, const char *s2) {
-	if (has_avx2())
+__attribute__((visibility("hidden")))
+void __strcmp_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		strcmp_impl = strcmp_avx512;
+	else if (has_avx2())
 		strcmp_impl = strcmp_avx2;
 	else if (has_sse2())
 		strcmp_impl = strcmp_sse2;
 	else
 		strcmp_impl = strcmp_naive;
+}
+
+static int strcmp_auto(const char *s1, const char *s2) {
+	__strcmp_resolve();
 	return strcmp_impl(s1, s2);
 }
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2020, Matija Skala <mskala@gmx.com>
+ * Copyright (c) 2020, 2021, Matija Skala <mskala@gmx.com>
  * All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
@@ -25,9 +25,157 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+
 #include <string.h>
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "helpers.h"
+
+static size_t strlen_fallback(const char *s) {
+	const char *a = s;
+	while ((size_t)s % sizeof(size_t)) {
+		if (!*s)
+			return s - a;
+		s++;
+	}
+	size_t lowbits = ~(size_t)0 / 0xff;
+	size_t highbits = lowbits * 0x80;
+	const size_t *w = (const size_t*)s;
+	while (!((*w - lowbits) & ~*w & highbits))
+		w++;
+	for (s = (const char*)w; *s; s++);
+	return s - a;
+}
+
+__attribute__((__target__("sse2")))
+static size_t strlen_sse2(const char *s) {
+	size_t off = (size_t)s % 16;
+	const __m128i *ptr = (const __m128i*)(s - off);
+	__m128i zero = _mm_set1_epi8(0);
+	/* an aligned load never crosses into the next page */
+	uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(ptr), zero)) >> off;
+	if (mask)
+		return trailing_zeros(mask);
+	ptr++;
+	while ((size_t)ptr % 64) {
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(ptr), zero));
+		if (mask)
+			return (const char*)ptr + trailing_zeros(mask) - s;
+		ptr++;
+	}
+	for (;;) {
+		__m128i a = _mm_load_si128(ptr);
+		__m128i b = _mm_load_si128(ptr+1);
+		__m128i c = _mm_load_si128(ptr+2);
+		__m128i d = _mm_load_si128(ptr+3);
+		__m128i min = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(min, zero))) {
+			if ((mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, zero))))
+				return (const char*)ptr + trailing_zeros(mask) - s;
+			if ((mask = _mm_movemask_epi8(_mm_cmpeq_epi8(b, zero))))
+				return (const char*)(ptr+1) + trailing_zeros(mask) - s;
+			if ((mask = _mm_movemask_epi8(_mm_cmpeq_epi8(c, zero))))
+				return (const char*)(ptr+2) + trailing_zeros(mask) - s;
+			mask = _mm_movemask_epi8(_mm_cmpeq_epi8(d, zero));
+			return (const char*)(ptr+3) + trailing_zeros(mask) - s;
+		}
+		ptr += 4;
+	}
+}
+
+__attribute__((__target__("avx2")))
+static size_t strlen_avx2(const char *s) {
+	size_t off = (size_t)s % 32;
+	const __m256i *ptr = (const __m256i*)(s - off);
+	__m256i zero = _mm256_set1_epi8(0);
+	uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(ptr), zero)) >> off;
+	if (mask)
+		return trailing_zeros(mask);
+	ptr++;
+	while ((size_t)ptr % 128) {
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(ptr), zero));
+		if (mask)
+			return (const char*)ptr + trailing_zeros(mask) - s;
+		ptr++;
+	}
+	for (;;) {
+		__m256i a = _mm256_load_si256(ptr);
+		__m256i b = _mm256_load_si256(ptr+1);
+		__m256i c = _mm256_load_si256(ptr+2);
+		__m256i d = _mm256_load_si256(ptr+3);
+		__m256i min = _mm256_min_epu8(_mm256_min_epu8(a, b), _mm256_min_epu8(c, d));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(min, zero))) {
+			if ((mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, zero))))
+				return (const char*)ptr + trailing_zeros(mask) - s;
+			if ((mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(b, zero))))
+				return (const char*)(ptr+1) + trailing_zeros(mask) - s;
+			if ((mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(c, zero))))
+				return (const char*)(ptr+2) + trailing_zeros(mask) - s;
+			mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(d, zero));
+			return (const char*)(ptr+3) + trailing_zeros(mask) - s;
+		}
+		ptr += 4;
+	}
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static size_t strlen_avx512(const char *s) {
+	size_t off = (size_t)s % 64;
+	const __m512i *ptr = (const __m512i*)(s - off);
+	__m512i x = _mm512_load_si512(ptr);
+	uint64_t mask = _mm512_testn_epi8_mask(x, x) >> off;
+	if (mask)
+		return trailing_zeros64(mask);
+	ptr++;
+	while ((size_t)ptr % 256) {
+		x = _mm512_load_si512(ptr);
+		mask = _mm512_testn_epi8_mask(x, x);
+		if (mask)
+			return (const char*)ptr + trailing_zeros64(mask) - s;
+		ptr++;
+	}
+	for (;;) {
+		__m512i a = _mm512_load_si512(ptr);
+		__m512i b = _mm512_load_si512(ptr+1);
+		__m512i c = _mm512_load_si512(ptr+2);
+		__m512i d = _mm512_load_si512(ptr+3);
+		__m512i min = _mm512_min_epu8(_mm512_min_epu8(a, b), _mm512_min_epu8(c, d));
+		if (_mm512_testn_epi8_mask(min, min)) {
+			if ((mask = _mm512_testn_epi8_mask(a, a)))
+				return (const char*)ptr + trailing_zeros64(mask) - s;
+			if ((mask = _mm512_testn_epi8_mask(b, b)))
+				return (const char*)(ptr+1) + trailing_zeros64(mask) - s;
+			if ((mask = _mm512_testn_epi8_mask(c, c)))
+				return (const char*)(ptr+2) + trailing_zeros64(mask) - s;
+			mask = _mm512_testn_epi8_mask(d, d);
+			return (const char*)(ptr+3) + trailing_zeros64(mask) - s;
+		}
+		ptr += 4;
+	}
+}
+
+static size_t strlen_auto(const char *s);
+
+static size_t (*strlen_impl)(const char *s) = strlen_auto;
+
+__attribute__((visibility("hidden")))
+void __strlen_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		strlen_impl = strlen_avx512;
+	else if (has_avx2())
+		strlen_impl = strlen_avx2;
+	else if (has_sse2())
+		strlen_impl = strlen_sse2;
+	else
+		strlen_impl = strlen_fallback;
+}
+
+static size_t strlen_auto(const char *s) {
+	__strlen_resolve();
+	return strlen_impl(s);
+}
 
 size_t strlen(const char *s) {
-	extern void *rawmemchr(const void *s, int c);
-	return (char*)rawmemchr(s, 0) - s;
+	return strlen_impl(s);
 }
@@ -95,11 +95,16 @@ static wchar_t *wcpcpy_auto(wchar_t *restrict dest, const wchar_t *restrict src)
 
 static wchar_t *(*wcpcpy_impl)(wchar_t *restrict dest, const wchar_t *restrict src) = wcpcpy_auto;
 
-static wchar_t *wcpcpy_auto(wchar_t *restrict dest, const wchar_t *restrict src) {
+__attribute__((visibility("hidden")))
+void __wcpcpy_resolve(void) {
 	if (has_sse2())
 		wcpcpy_impl = wcpcpy_sse2;
 	else
 		wcpcpy_impl = wcpcpy_naive;
+}
+
+static wchar_t *wcpcpy_auto(wchar_t *restrict dest, const wchar_t *restrict src) {
+	__wcpcpy_resolve();
 	return wcpcpy_impl(dest, src);
 }
 
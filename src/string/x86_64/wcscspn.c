@@ -0,0 +1,127 @@
+#include <wchar.h>
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "helpers.h"
+
+static size_t wcscspn_fallback(const wchar_t *s, const wchar_t *c) {
+	const wchar_t *a;
+	for (a = s; *s && !wcschr(c, *s); s++);
+	return s - a;
+}
+
+/*
+ * Wide sets are too large for a lookup table, so each block is compared
+ * against every member of the set in turn.
+ */
+
+__attribute__((__target__("sse2")))
+static inline __m128i wcsset_match_sse2(__m128i x, const wchar_t *c, size_t k) {
+	__m128i m = _mm_cmpeq_epi32(x, _mm_set1_epi32(c[0]));
+	for (size_t i = 1; i < k; i++)
+		m = _mm_or_si128(m, _mm_cmpeq_epi32(x, _mm_set1_epi32(c[i])));
+	return m;
+}
+
+__attribute__((__target__("sse2")))
+static size_t wcscspn_sse2(const wchar_t *s, const wchar_t *c) {
+	size_t k = wcslen(c);
+	if (!k)
+		return wcslen(s);
+	const __m128i zero = _mm_set1_epi32(0);
+	size_t off = (uintptr_t)s % 16;
+	const __m128i *ptr = (const __m128i*)((const char*)s - off);
+	__m128i x = _mm_load_si128(ptr);
+	uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_or_si128(wcsset_match_sse2(x, c, k), _mm_cmpeq_epi32(x, zero))) >> off;
+	if (mask)
+		return trailing_zeros(mask) / 4;
+	for (;;) {
+		ptr++;
+		x = _mm_load_si128(ptr);
+		mask = _mm_movemask_epi8(_mm_or_si128(wcsset_match_sse2(x, c, k), _mm_cmpeq_epi32(x, zero)));
+		if (mask)
+			return (const wchar_t*)ptr + trailing_zeros(mask) / 4 - s;
+	}
+}
+
+__attribute__((__target__("avx2")))
+static inline __m256i wcsset_match_avx2(__m256i x, const wchar_t *c, size_t k) {
+	__m256i m = _mm256_cmpeq_epi32(x, _mm256_set1_epi32(c[0]));
+	for (size_t i = 1; i < k; i++)
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi32(x, _mm256_set1_epi32(c[i])));
+	return m;
+}
+
+__attribute__((__target__("avx2")))
+static size_t wcscspn_avx2(const wchar_t *s, const wchar_t *c) {
+	size_t k = wcslen(c);
+	if (!k)
+		return wcslen(s);
+	const __m256i zero = _mm256_set1_epi32(0);
+	size_t off = (uintptr_t)s % 32;
+	const __m256i *ptr = (const __m256i*)((const char*)s - off);
+	__m256i x = _mm256_load_si256(ptr);
+	uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(wcsset_match_avx2(x, c, k), _mm256_cmpeq_epi32(x, zero))) >> off;
+	if (mask)
+		return trailing_zeros(mask) / 4;
+	for (;;) {
+		ptr++;
+		x = _mm256_load_si256(ptr);
+		mask = _mm256_movemask_epi8(_mm256_or_si256(wcsset_match_avx2(x, c, k), _mm256_cmpeq_epi32(x, zero)));
+		if (mask)
+			return (const wchar_t*)ptr + trailing_zeros(mask) / 4 - s;
+	}
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static inline uint32_t wcsset_match_avx512(__m512i x, const wchar_t *c, size_t k) {
+	uint32_t m = 0;
+	for (size_t i = 0; i < k; i++)
+		m |= _mm512_cmpeq_epi32_mask(x, _mm512_set1_epi32(c[i]));
+	return m;
+}
+
+__attribute__((__target__("avx512bw,avx512vl")))
+static size_t wcscspn_avx512(const wchar_t *s, const wchar_t *c) {
+	size_t k = wcslen(c);
+	if (!k)
+		return wcslen(s);
+	size_t off = (uintptr_t)s % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)s - off);
+	__m512i x = _mm512_load_si512(ptr);
+	uint32_t mask = (wcsset_match_avx512(x, c, k) | _mm512_testn_epi32_mask(x, x)) >> off / 4;
+	if (mask)
+		return trailing_zeros(mask);
+	for (;;) {
+		ptr++;
+		x = _mm512_load_si512(ptr);
+		mask = (wcsset_match_avx512(x, c, k) | _mm512_testn_epi32_mask(x, x));
+		if (mask)
+			return (const wchar_t*)ptr + trailing_zeros(mask) - s;
+	}
+}
+
+static size_t wcscspn_auto(const wchar_t *s, const wchar_t *c);
+
+static size_t (*wcscspn_impl)(const wchar_t *s, const wchar_t *c) = wcscspn_auto;
+
+__attribute__((visibility("hidden")))
+void __wcscspn_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		wcscspn_impl = wcscspn_avx512;
+	else if (has_avx2())
+		wcscspn_impl = wcscspn_avx2;
+	else if (has_sse2())
+		wcscspn_impl = wcscspn_sse2;
+	else
+		wcscspn_impl = wcscspn_fallback;
+}
+
+static size_t wcscspn_auto(const wchar_t *s, const wchar_t *c) {
+	__wcscspn_resolve();
+	return wcscspn_impl(s, c);
+}
+
+size_t wcscspn(const wchar_t *s, const wchar_t *c) {
+	return wcscspn_impl(s, c);
+}
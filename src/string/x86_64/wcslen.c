@@ -33,7 +33,8 @@
 
 static size_t wcslen_fallback(const wchar_t *haystack) {
 	const wchar_t *start = haystack;
-	while ((size_t)haystack % sizeof(size_t)) {
+	/* the loop reads two words at a time, so align to the pair */
+	while ((size_t)haystack % (2*sizeof(size_t))) {
 		if (!*haystack)
 			return haystack - start;
 		haystack++;
@@ -177,17 +178,54 @@ static size_t wcslen_avx2(const wchar_t *haystack) {
 	}
 }
 
+__attribute__((__target__("avx512bw,avx512vl")))
+static size_t wcslen_avx512(const wchar_t *haystack) {
+	size_t off = (size_t)haystack % 64;
+	const __m512i *ptr = (const __m512i*)((const char*)haystack - off);
+	__m512i x = _mm512_load_si512(ptr);
+	uint32_t mask = _mm512_testn_epi32_mask(x, x) >> off / sizeof(wchar_t);
+	if (mask)
+		return trailing_zeros(mask);
+	ptr++;
+	if ((size_t)ptr % 128) {
+		x = _mm512_load_si512(ptr);
+		mask = _mm512_testn_epi32_mask(x, x);
+		if (mask)
+			return (const wchar_t*)ptr + trailing_zeros(mask) - haystack;
+		ptr++;
+	}
+	for (;;) {
+		__m512i a = _mm512_load_si512(ptr);
+		__m512i b = _mm512_load_si512(ptr+1);
+		uint32_t ma = _mm512_testn_epi32_mask(a, a);
+		uint32_t mb = _mm512_testn_epi32_mask(b, b);
+		if (ma | mb) {
+			if (ma)
+				return (const wchar_t*)ptr + trailing_zeros(ma) - haystack;
+			return (const wchar_t*)(ptr+1) + trailing_zeros(mb) - haystack;
+		}
+		ptr += 2;
+	}
+}
+
 static size_t wcslen_auto(const wchar_t *s);
 
 static size_t (*wcslen_impl)(const wchar_t *s) = wcslen_auto;
 
-static size_t wcslen_auto(const wchar_t *s) {
-	if (has_avx2())
+__attribute__((visibility("hidden")))
+void __wcslen_resolve(void) {
+	if (has_avx512bw() && has_avx512vl())
+		wcslen_impl = wcslen_avx512;
+	else if (has_avx2())
 		wcslen_impl = wcslen_avx2;
 	else if (has_sse2())
 		wcslen_impl = wcslen_sse2;
 	else
 		wcslen_impl = wcslen_fallback;
+}
+
+static size_t wcslen_auto(const wchar_t *s) {
+	__wcslen_resolve();
 	return wcslen_impl(s);
 }
 
@@ -15,6 +15,7 @@ weak_alias(dummy_0, __release_ptc);
 weak_alias(dummy_0, __pthread_tsd_run_dtors);
 weak_alias(dummy_0, __do_orphaned_stdio_locks);
 weak_alias(dummy_0, __dl_thread_cleanup);
+weak_alias(dummy_0, __malloc_flush_tcache);
 weak_alias(dummy_0, __membarrier_init);
 
 static int tl_lock_count;
@@ -69,6 +70,10 @@ _Noreturn void __pthread_exit(void *result)
 
 	__pthread_tsd_run_dtors();
 
+	/* Return slots cached by this thread's malloc to their groups.
+	 * Frees after this point bypass the cache. */
+	__malloc_flush_tcache();
+
 	__block_app_sigs(&set);
 
 	/* This atomic potentially competes with a concurrent pthread_detach
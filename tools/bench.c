@@ -0,0 +1,320 @@
+/*
+ * Micro-benchmark for the dispatched string and memory functions.
+ *
+ * Dispatch picks one variant per process, so the harness measures
+ * whatever the current MUSL_HWCAP_MASK leaves enabled; "make bench"
+ * runs it once for each mask in BENCH_MASKS. Every function is timed
+ * over size buckets, alignments and, for searches and comparisons,
+ * with the target found at the end ("end") or absent ("miss").
+ * Results are in TSC cycles per call and per byte processed.
+ *
+ * usage: bench [-f function] [-m max_size] [-b bytes_per_row]
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <strings.h>
+#include <wchar.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define PAGE 4096
+#define BATCH 64
+#define NEEDLE "qjxzvkwp"
+
+enum { SEARCH, REVERSE, COMPARE, CASECMP, COPY, OVERLAP, FILL };
+
+/* the function has distinct "end" and "miss" cases */
+#define MODES 1
+/* the function works on wchar_t, sizes are still counted in bytes */
+#define WIDE 2
+
+/*
+ * Each wrapper processes n characters of s (and d), after which the
+ * harness has placed either the target or the terminator. memrchr
+ * scans backwards and finds its target just before s instead.
+ */
+typedef uintptr_t (*call_fn)(void *d, const void *s, size_t n);
+
+#define W(x) ((wchar_t *)(x))
+#define CW(x) ((const wchar_t *)(x))
+
+static uintptr_t b_memchr(void *d, const void *s, size_t n) { return (uintptr_t)memchr(s, '#', n + 1); }
+static uintptr_t b_rawmemchr(void *d, const void *s, size_t n) { return (uintptr_t)rawmemchr(s, 0); }
+static uintptr_t b_memrchr(void *d, const void *s, size_t n) { return (uintptr_t)memrchr((const char *)s - 1, '#', n + 1); }
+static uintptr_t b_strlen(void *d, const void *s, size_t n) { return strlen(s); }
+static uintptr_t b_strnlen(void *d, const void *s, size_t n) { return strnlen(s, n + 1); }
+static uintptr_t b_strchr(void *d, const void *s, size_t n) { return (uintptr_t)strchr(s, '#'); }
+static uintptr_t b_strchrnul(void *d, const void *s, size_t n) { return (uintptr_t)strchrnul(s, '#'); }
+static uintptr_t b_strrchr(void *d, const void *s, size_t n) { return (uintptr_t)strrchr(s, '#'); }
+static uintptr_t b_strspn(void *d, const void *s, size_t n) { return strspn(s, "abcdefghijklmnopqrstuvwxyz"); }
+static uintptr_t b_strcspn(void *d, const void *s, size_t n) { return strcspn(s, "#$%&"); }
+static uintptr_t b_strpbrk(void *d, const void *s, size_t n) { return (uintptr_t)strpbrk(s, "#$%&"); }
+static uintptr_t b_strstr(void *d, const void *s, size_t n) { return (uintptr_t)strstr(s, NEEDLE); }
+static uintptr_t b_strcasestr(void *d, const void *s, size_t n) { return (uintptr_t)strcasestr(s, NEEDLE); }
+static uintptr_t b_memmem(void *d, const void *s, size_t n) { return (uintptr_t)memmem(s, n + 8, NEEDLE, 8); }
+static uintptr_t b_wcslen(void *d, const void *s, size_t n) { return wcslen(CW(s)); }
+static uintptr_t b_wcschr(void *d, const void *s, size_t n) { return (uintptr_t)wcschr(CW(s), '#'); }
+static uintptr_t b_wcsrchr(void *d, const void *s, size_t n) { return (uintptr_t)wcsrchr(CW(s), '#'); }
+static uintptr_t b_wmemchr(void *d, const void *s, size_t n) { return (uintptr_t)wmemchr(CW(s), '#', n + 1); }
+static uintptr_t b_wcsspn(void *d, const void *s, size_t n) { return wcsspn(CW(s), L"abcdefghijklmnopqrstuvwxyz"); }
+static uintptr_t b_wcscspn(void *d, const void *s, size_t n) { return wcscspn(CW(s), L"#$%&"); }
+
+static uintptr_t b_memcmp(void *d, const void *s, size_t n) { return memcmp(d, s, n + 1); }
+static uintptr_t b_strcmp(void *d, const void *s, size_t n) { return strcmp(d, s); }
+static uintptr_t b_strncmp(void *d, const void *s, size_t n) { return strncmp(d, s, n + 1); }
+static uintptr_t b_strcasecmp(void *d, const void *s, size_t n) { return strcasecmp(d, s); }
+static uintptr_t b_strncasecmp(void *d, const void *s, size_t n) { return strncasecmp(d, s, n + 1); }
+static uintptr_t b_wmemcmp(void *d, const void *s, size_t n) { return wmemcmp(CW(d), CW(s), n + 1); }
+static uintptr_t b_wcscmp(void *d, const void *s, size_t n) { return wcscmp(CW(d), CW(s)); }
+static uintptr_t b_wcsncmp(void *d, const void *s, size_t n) { return wcsncmp(CW(d), CW(s), n + 1); }
+
+static uintptr_t b_memcpy(void *d, const void *s, size_t n) { return (uintptr_t)memcpy(d, s, n); }
+static uintptr_t b_memmove(void *d, const void *s, size_t n) { return (uintptr_t)memmove(d, s, n); }
+static uintptr_t b_memccpy(void *d, const void *s, size_t n) { return (uintptr_t)memccpy(d, s, '#', n + 1); }
+static uintptr_t b_strcpy(void *d, const void *s, size_t n) { return (uintptr_t)strcpy(d, s); }
+static uintptr_t b_stpcpy(void *d, const void *s, size_t n) { return (uintptr_t)stpcpy(d, s); }
+static uintptr_t b_strncpy(void *d, const void *s, size_t n) { return (uintptr_t)strncpy(d, s, n); }
+static uintptr_t b_stpncpy(void *d, const void *s, size_t n) { return (uintptr_t)stpncpy(d, s, n); }
+static uintptr_t b_strlcpy(void *d, const void *s, size_t n) { return strlcpy(d, s, n + 1); }
+static uintptr_t b_wcscpy(void *d, const void *s, size_t n) { return (uintptr_t)wcscpy(W(d), CW(s)); }
+static uintptr_t b_wcpcpy(void *d, const void *s, size_t n) { return (uintptr_t)wcpcpy(W(d), CW(s)); }
+static uintptr_t b_wmemcpy(void *d, const void *s, size_t n) { return (uintptr_t)wmemcpy(W(d), CW(s), n); }
+
+static uintptr_t b_memset(void *d, const void *s, size_t n) { return (uintptr_t)memset(d, 0, n); }
+static uintptr_t b_wmemset(void *d, const void *s, size_t n) { return (uintptr_t)wmemset(W(d), 0x12345678, n); }
+
+static const struct func {
+	const char *name;
+	call_fn call;
+	int kind, flags;
+} funcs[] = {
+	{ "memchr", b_memchr, SEARCH, MODES },
+	{ "rawmemchr", b_rawmemchr, SEARCH, 0 },
+	{ "memrchr", b_memrchr, REVERSE, MODES },
+	{ "strlen", b_strlen, SEARCH, 0 },
+	{ "strnlen", b_strnlen, SEARCH, 0 },
+	{ "strchr", b_strchr, SEARCH, MODES },
+	{ "strchrnul", b_strchrnul, SEARCH, MODES },
+	{ "strrchr", b_strrchr, SEARCH, MODES },
+	{ "strspn", b_strspn, SEARCH, 0 },
+	{ "strcspn", b_strcspn, SEARCH, MODES },
+	{ "strpbrk", b_strpbrk, SEARCH, MODES },
+	{ "strstr", b_strstr, SEARCH, MODES },
+	{ "strcasestr", b_strcasestr, SEARCH, MODES },
+	{ "memmem", b_memmem, SEARCH, MODES },
+	{ "wcslen", b_wcslen, SEARCH, WIDE },
+	{ "wcschr", b_wcschr, SEARCH, MODES | WIDE },
+	{ "wcsrchr", b_wcsrchr, SEARCH, MODES | WIDE },
+	{ "wmemchr", b_wmemchr, SEARCH, MODES | WIDE },
+	{ "wcsspn", b_wcsspn, SEARCH, WIDE },
+	{ "wcscspn", b_wcscspn, SEARCH, MODES | WIDE },
+	{ "memcmp", b_memcmp, COMPARE, MODES },
+	{ "strcmp", b_strcmp, COMPARE, MODES },
+	{ "strncmp", b_strncmp, COMPARE, MODES },
+	{ "strcasecmp", b_strcasecmp, CASECMP, MODES },
+	{ "strncasecmp", b_strncasecmp, CASECMP, MODES },
+	{ "wmemcmp", b_wmemcmp, COMPARE, MODES | WIDE },
+	{ "wcscmp", b_wcscmp, COMPARE, MODES | WIDE },
+	{ "wcsncmp", b_wcsncmp, COMPARE, MODES | WIDE },
+	{ "memcpy", b_memcpy, COPY, 0 },
+	{ "memmove", b_memmove, COPY, 0 },
+	{ "memmove(overlap)", b_memmove, OVERLAP, 0 },
+	{ "memccpy", b_memccpy, COPY, MODES },
+	{ "strcpy", b_strcpy, COPY, 0 },
+	{ "stpcpy", b_stpcpy, COPY, 0 },
+	{ "strncpy", b_strncpy, COPY, 0 },
+	{ "stpncpy", b_stpncpy, COPY, 0 },
+	{ "strlcpy", b_strlcpy, COPY, 0 },
+	{ "wcscpy", b_wcscpy, COPY, WIDE },
+	{ "wcpcpy", b_wcpcpy, COPY, WIDE },
+	{ "wmemcpy", b_wmemcpy, COPY, WIDE },
+	{ "memset", b_memset, FILL, 0 },
+	{ "wmemset", b_wmemset, FILL, WIDE },
+};
+
+enum { ALIGNED, UNALIGNED, PAGECROSS };
+static const char *const align_names[] = { "aligned", "unaligned", "pagecross" };
+
+static uint64_t rng = 0x9e3779b97f4a7c15;
+
+static uint64_t rand64(void) {
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+static inline uint64_t rdtsc(void) {
+	uint32_t lo, hi;
+	__asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+	return (uint64_t)hi << 32 | lo;
+}
+
+static char *sbuf, *dbuf;
+static size_t max_size = 64 << 20;
+static size_t budget = 16 << 20;
+
+static void fill(char *p, size_t n, int kind, int wide, int upper) {
+	for (size_t i = 0; i < n; i++) {
+		int c = kind == SEARCH ? 'a' + rand64() % 26 : 'a';
+		if (upper)
+			c -= 'a' - 'A';
+		if (wide)
+			W(p)[i] = c;
+		else
+			p[i] = c;
+	}
+}
+
+/*
+ * Places the string str (including its terminator) at character n of
+ * p, saving the old contents so they can be put back after the call.
+ */
+static void put(char *p, size_t n, int wide, const char *str, wchar_t *save) {
+	for (size_t i = 0; i == 0 || str[i-1]; i++) {
+		if (wide) {
+			save[i] = W(p)[n+i];
+			W(p)[n+i] = str[i];
+		}
+		else {
+			save[i] = p[n+i];
+			p[n+i] = str[i];
+		}
+	}
+}
+
+static void restore(char *p, size_t n, int wide, const char *str, const wchar_t *save) {
+	for (size_t i = 0; i == 0 || str[i-1]; i++) {
+		if (wide)
+			W(p)[n+i] = save[i];
+		else
+			p[n+i] = save[i];
+	}
+}
+
+static uint64_t overhead = -1;
+
+static void run(const struct func *f, size_t lo, size_t hi, int align, int miss) {
+	int wide = f->flags & WIDE;
+	int cmp = f->kind == COMPARE || f->kind == CASECMP;
+	size_t cs = wide ? sizeof(wchar_t) : 1;
+	size_t len[BATCH], soff[BATCH], doff[BATCH];
+	size_t calls = budget / hi;
+	calls = calls < 1 ? 1 : calls > BATCH ? BATCH : calls;
+
+	/* what goes at the end of the operand, always followed by a null */
+	const char *mark = "";
+	if (f->flags & MODES && !miss)
+		mark = cmp ? "!" : f->call == b_strstr || f->call == b_strcasestr || f->call == b_memmem ? NEEDLE : "#";
+
+	size_t bytes = 0;
+	for (size_t i = 0; i < calls; i++) {
+		size_t n = lo + rand64() % (hi - lo + 1);
+		len[i] = n / cs;
+		bytes += len[i] * cs;
+		if (align == ALIGNED)
+			soff[i] = doff[i] = 0;
+		else if (align == UNALIGNED) {
+			soff[i] = cs * (1 + rand64() % (64 / cs - 1));
+			doff[i] = cs * (1 + rand64() % (64 / cs - 1));
+		}
+		else {
+			/* start within 64 bytes of a page end */
+			soff[i] = PAGE - cs * (1 + rand64() % (64 / cs));
+			doff[i] = PAGE - cs * (1 + rand64() % (64 / cs));
+		}
+	}
+
+	uint64_t best = -1;
+	size_t reps = budget / (bytes + calls * 64);
+	reps = reps < 3 ? 3 : reps > 200 ? 200 : reps;
+	uintptr_t sink = 0;
+	for (size_t r = 0; r < reps; r++) {
+		uint64_t t = 0;
+		for (size_t i = 0; i < calls; i++) {
+			char *s = sbuf + PAGE + soff[i];
+			char *d = f->kind == OVERLAP ? s + 64 + doff[i] - soff[i] : dbuf + PAGE + doff[i];
+			size_t n = len[i];
+			char *p = cmp ? d : f->kind == REVERSE ? s - 1 : s;
+			size_t pn = f->kind == REVERSE ? 0 : n;
+			wchar_t save[16], save_s[1];
+			put(p, pn, wide, mark, save);
+			/* equal strings need both terminators */
+			if (cmp && miss)
+				put(s, n, wide, "", save_s);
+			uint64_t t0 = rdtsc();
+			sink += f->call(d, s, n);
+			uint64_t t1 = rdtsc();
+			t += t1 - t0 > overhead ? t1 - t0 - overhead : 0;
+			if (cmp && miss)
+				restore(s, n, wide, "", save_s);
+			restore(p, pn, wide, mark, save);
+		}
+		if (t < best)
+			best = t;
+	}
+	*(volatile uintptr_t *)&sink = sink;
+
+	char range[32];
+	snprintf(range, sizeof range, "%zu-%zu", lo, hi);
+	printf("%-18s %-5s %-17s %-10s %12.1f %9.3f\n", f->name,
+		f->flags & MODES ? miss ? "miss" : "end" : "-",
+		range, align_names[align], (double)best / calls,
+		bytes ? (double)best / bytes : 0.0);
+}
+
+int main(int argc, char **argv) {
+	const char *only = 0;
+	int opt;
+	while ((opt = getopt(argc, argv, "f:m:b:")) != -1) {
+		switch (opt) {
+		case 'f': only = optarg; break;
+		case 'm': max_size = strtoull(optarg, 0, 0); break;
+		case 'b': budget = strtoull(optarg, 0, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-f function] [-m max_size] [-b bytes_per_row]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	size_t region = max_size + 4 * PAGE;
+	sbuf = mmap(0, region, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	dbuf = mmap(0, region, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (sbuf == MAP_FAILED || dbuf == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	for (int i = 0; i < 1000; i++) {
+		uint64_t t0 = rdtsc();
+		uint64_t t1 = rdtsc();
+		if (t1 - t0 < overhead)
+			overhead = t1 - t0;
+	}
+
+	const char *mask = getenv("MUSL_HWCAP_MASK");
+	printf("# MUSL_HWCAP_MASK=%s\n", mask ? mask : "");
+	printf("# %-16s %-5s %-17s %-10s %12s %9s\n", "function", "case", "bytes", "alignment", "cycles/call", "cyc/byte");
+	for (size_t i = 0; i < sizeof funcs / sizeof *funcs; i++) {
+		const struct func *f = &funcs[i];
+		if (only && strcmp(only, f->name))
+			continue;
+		int wide = f->flags & WIDE;
+		size_t cs = wide ? sizeof(wchar_t) : 1;
+		fill(sbuf, region / cs, f->kind, wide, 0);
+		fill(dbuf, region / cs, f->kind, wide, f->kind == CASECMP);
+		for (size_t lo = 0, hi = 16; hi <= max_size; lo = hi + 1, hi *= 4)
+			for (int align = ALIGNED; align <= PAGECROSS; align++) {
+				if (align == PAGECROSS && hi > PAGE)
+					continue;
+				for (int miss = 0; miss <= !!(f->flags & MODES); miss++)
+					run(f, lo, hi, align, miss);
+			}
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Included ahead of the portable src/string/*.c files when they are
+ * built as references for strtest, so they neither clash with nor call
+ * into the dispatched versions in libc.a.
+ */
+
+#include <features.h>
+
+/* alias the renamed symbol, not the original spelling */
+#undef weak_alias
+#define weak_alias(old, new) \
+	extern __typeof(old) new __attribute__((__weak__, __alias__(ref_str(old))))
+#define ref_str(x) ref_str1(x)
+#define ref_str1(x) #x
+
+#define memccpy ref_memccpy
+#define memchr ref_memchr
+#define memcmp ref_memcmp
+#define memcpy ref_memcpy
+#define memmem ref_memmem
+#define memmove ref_memmove
+#define memrchr ref_memrchr
+#define memset ref_memset
+#define rawmemchr ref_rawmemchr
+#define stpcpy ref_stpcpy
+#define stpncpy ref_stpncpy
+#define strcasecmp ref_strcasecmp
+#define strcasecmp_l ref_strcasecmp_l
+#define strcasestr ref_strcasestr
+#define strchr ref_strchr
+#define strchrnul ref_strchrnul
+#define strcmp ref_strcmp
+#define strcpy ref_strcpy
+#define strcspn ref_strcspn
+#define strlcpy ref_strlcpy
+#define strlen ref_strlen
+#define strncasecmp ref_strncasecmp
+#define strncasecmp_l ref_strncasecmp_l
+#define strncmp ref_strncmp
+#define strncpy ref_strncpy
+#define strnlen ref_strnlen
+#define strpbrk ref_strpbrk
+#define strrchr ref_strrchr
+#define strspn ref_strspn
+#define strstr ref_strstr
+#define wcpcpy ref_wcpcpy
+#define wcschr ref_wcschr
+#define wcscmp ref_wcscmp
+#define wcscpy ref_wcscpy
+#define wcscspn ref_wcscspn
+#define wcslen ref_wcslen
+#define wcsncmp ref_wcsncmp
+#define wcsrchr ref_wcsrchr
+#define wcsspn ref_wcsspn
+#define wmemchr ref_wmemchr
+#define wmemcmp ref_wmemcmp
+#define wmemcpy ref_wmemcpy
+#define wmemset ref_wmemset
+
+#define __memrchr ref___memrchr
+#define __stpcpy ref___stpcpy
+#define __stpncpy ref___stpncpy
+#define __strcasecmp_l ref___strcasecmp_l
+#define __strchrnul ref___strchrnul
+#define __strncasecmp_l ref___strncasecmp_l
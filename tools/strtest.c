@@ -0,0 +1,636 @@
+/*
+ * Differential test for the dispatched string and memory functions.
+ *
+ * Every function is called on random inputs alongside a build of its
+ * portable src/string/*.c version, and the results and the memory
+ * around all operands must agree. Each operand is an object of exactly
+ * the size the function may access, usually placed against a PROT_NONE
+ * page, so reading or writing past either end of it faults. Like bench,
+ * this checks the variant the current MUSL_HWCAP_MASK selects; "make
+ * check" runs it for each mask in BENCH_MASKS.
+ *
+ * The random sizes stay small, so the copy and fill functions are also
+ * run once on sizes around each point where they switch strategy: the
+ * rep movsb/stosb thresholds, the 2 MiB non-temporal fallback, and a
+ * quarter of and all of the last-level cache as the kernel reports it.
+ * Thresholds above LARGE_MAX are skipped.
+ *
+ * usage: strtest [-f function] [-n iterations] [-s seed]
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <strings.h>
+#include <wchar.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define PAGE 4096
+#define ARENA (20 * PAGE)
+#define MARGIN 128
+#define MAXN 16384
+#define LARGE_MAX (64 << 20)
+
+enum {
+	MEMCHR, RAWMEMCHR, STRCHR, STRLEN, STRNLEN, SPN, PBRK, STRSTR, MEMMEM,
+	MEMCMP, STRCMP, STRNCMP, MEMCPY, MEMMOVE, STRCPY, STRNCPY, STRLCPY,
+	MEMCCPY, MEMSET,
+};
+
+/* the function works on wchar_t */
+#define WIDE 1
+/* the function ignores case */
+#define CASE 2
+
+typedef void (*func)(void);
+
+#define TESTS \
+	T(memchr, MEMCHR, 0) \
+	T(memrchr, MEMCHR, 0) \
+	T(rawmemchr, RAWMEMCHR, 0) \
+	T(strlen, STRLEN, 0) \
+	T(strnlen, STRNLEN, 0) \
+	T(strchr, STRCHR, 0) \
+	T(strchrnul, STRCHR, 0) \
+	T(strrchr, STRCHR, 0) \
+	T(strspn, SPN, 0) \
+	T(strcspn, SPN, 0) \
+	T(strpbrk, PBRK, 0) \
+	T(strstr, STRSTR, 0) \
+	T(strcasestr, STRSTR, CASE) \
+	T(memmem, MEMMEM, 0) \
+	T(memcmp, MEMCMP, 0) \
+	T(strcmp, STRCMP, 0) \
+	T(strncmp, STRNCMP, 0) \
+	T(strcasecmp, STRCMP, CASE) \
+	T(strncasecmp, STRNCMP, CASE) \
+	T(memcpy, MEMCPY, 0) \
+	T(memmove, MEMCPY, 0) \
+	T(memccpy, MEMCCPY, 0) \
+	T(strcpy, STRCPY, 0) \
+	T(stpcpy, STRCPY, 0) \
+	T(strncpy, STRNCPY, 0) \
+	T(stpncpy, STRNCPY, 0) \
+	T(strlcpy, STRLCPY, 0) \
+	T(memset, MEMSET, 0) \
+	T(wcslen, STRLEN, WIDE) \
+	T(wcschr, STRCHR, WIDE) \
+	T(wcsrchr, STRCHR, WIDE) \
+	T(wcsspn, SPN, WIDE) \
+	T(wcscspn, SPN, WIDE) \
+	T(wmemchr, MEMCHR, WIDE) \
+	T(wmemcmp, MEMCMP, WIDE) \
+	T(wcscmp, STRCMP, WIDE) \
+	T(wcsncmp, STRNCMP, WIDE) \
+	T(wmemcpy, MEMCPY, WIDE) \
+	T(wcscpy, STRCPY, WIDE) \
+	T(wcpcpy, STRCPY, WIDE) \
+	T(wmemset, MEMSET, WIDE)
+
+/* built from src/string with tools/strtest-ref.h */
+#define T(name, sig, flags) void ref_##name(void);
+TESTS
+#undef T
+
+static const struct test {
+	const char *name;
+	int sig, flags;
+	func impl, ref;
+} tests[] = {
+#define T(name, sig, flags) { #name, sig, flags, (func)name, ref_##name },
+	TESTS
+#undef T
+	{ "memmove(overlap)", MEMMOVE, 0, (func)memmove, ref_memmove },
+};
+
+struct args {
+	char *s, *t, *d;
+	size_t n, m;
+	int c;
+};
+
+enum { A, B, C, NARENAS };
+
+static char *base[2];
+static char *big[2];
+static size_t big_len, llc;
+static size_t cs;
+static long sa[MAXN + 1], sb[MAXN + 1], junk[MAXN + 1];
+static long alphabet[4];
+static int nalpha;
+
+/* regions around the operands, as offsets from base */
+static struct { size_t off, len; } win[4];
+static int nwin;
+
+static const struct test *cur;
+static unsigned long long seed;
+static long iter;
+static struct args cur_args;
+
+static uint64_t rng;
+
+static uint64_t rand64(void) {
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+static char *arena(int set, int i) {
+	return base[set] + PAGE + i * (ARENA + PAGE);
+}
+
+/* the arenas for the large sizes, big_len bytes each */
+static char *big_arena(int set, int i) {
+	return big[set] + PAGE + i * (big_len + PAGE);
+}
+
+static void pick_alphabet(void) {
+	static const long narrow[] = { 'a', 'b', 'A', 'Z', '#', 0x01, 0x7f, 0x80, 0xff };
+	static const long wide[] = { 'a', 'b', 'A', 'Z', 0x80, 0xff, 0x100, 0xffff, 0x10ffff, 0x7fffffff, -1, INT_MIN };
+	nalpha = 1 + rand64() % 4;
+	for (int i = 0; i < nalpha; i++)
+		alphabet[i] = cs == 1 ? narrow[rand64() % (sizeof narrow / sizeof *narrow)]
+		                      : wide[rand64() % (sizeof wide / sizeof *wide)];
+}
+
+/* a random non-null character, usually from the alphabet */
+static long rchar(void) {
+	if (rand64() % 16)
+		return alphabet[rand64() % nalpha];
+	long c = cs == 1 ? rand64() % 256 : (int)rand64();
+	return c ? c : 1;
+}
+
+/* a character argument, converted by the callee for the narrow functions */
+static int rc(void) {
+	switch (rand64() % 8) {
+	case 0: return 0;
+	case 1: return cs == 1 ? rchar() + 256 * (int)(rand64() % 3) : (int)rand64();
+	default: return rchar();
+	}
+}
+
+static size_t rsize(void) {
+	switch (rand64() % 16) {
+	case 0: return rand64() % (MAXN + 1);
+	case 1: case 2: case 3: return rand64() % 1025;
+	default: return rand64() % 129;
+	}
+}
+
+static void gen_mem(long *x, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		x[i] = rand64() % 8 ? rchar() : 0;
+}
+
+static void gen_str(long *x, size_t len) {
+	for (size_t i = 0; i < len; i++)
+		x[i] = rchar();
+	x[len] = 0;
+}
+
+static void mutate(long *x, size_t len) {
+	if (len)
+		x[rand64() % len] = rand64() % 4 ? rchar() : 0;
+}
+
+/* flips the case of random letters */
+static void swap_case(long *x, size_t len) {
+	for (size_t i = 0; i < len; i++)
+		if (rand64() % 2 && (x[i] | 32) >= 'a' && (x[i] | 32) <= 'z')
+			x[i] ^= 32;
+}
+
+static void put(char *p, size_t i, long v) {
+	if (cs == 1)
+		p[i] = v;
+	else
+		((wchar_t *)p)[i] = v;
+}
+
+static void window(int a, size_t off, size_t len) {
+	size_t lo = off > MARGIN ? off - MARGIN : 0;
+	size_t hi = off + len + MARGIN < ARENA ? off + len + MARGIN : ARENA;
+	win[nwin].off = arena(0, a) - base[0] + lo;
+	win[nwin].len = hi - lo;
+	nwin++;
+}
+
+static char *obj_at(int a, size_t off, const long *x, size_t n) {
+	char *p = arena(0, a) + off;
+	for (size_t i = 0; i < n; i++)
+		put(p, i, x[i]);
+	window(a, off, n * cs);
+	return p;
+}
+
+/* n elements of x, against either guard page or anywhere in arena a */
+static char *obj(int a, const long *x, size_t n) {
+	size_t bytes = n * cs, off;
+	switch (rand64() % 3) {
+	case 0: off = ARENA - bytes; break;
+	case 1: off = 0; break;
+	default: off = rand64() % (ARENA - bytes + 1) / cs * cs;
+	}
+	return obj_at(a, off, x, n);
+}
+
+static size_t min(size_t a, size_t b) {
+	return a < b ? a : b;
+}
+
+static void setup(const struct test *t, struct args *a) {
+	size_t n = rsize(), m = rsize(), k;
+	nwin = 0;
+	pick_alphabet();
+	gen_mem(junk, (n > m ? n : m) + 1);
+	a->n = n;
+	a->m = m;
+	a->c = rc();
+	switch (t->sig) {
+	case MEMCHR:
+		gen_mem(sa, n);
+		a->s = obj(A, sa, n);
+		break;
+	case RAWMEMCHR:
+		gen_mem(sa, n);
+		sa[n] = a->c;
+		a->s = obj(A, sa, n + 1);
+		break;
+	case STRCHR:
+	case STRLEN:
+		gen_str(sa, n);
+		a->s = obj(A, sa, n + 1);
+		break;
+	case STRNLEN:
+		gen_str(sa, n);
+		a->s = obj(A, sa, min(n + 1, m));
+		a->n = m;
+		break;
+	case SPN:
+	case PBRK:
+		gen_str(sa, n);
+		a->s = obj(A, sa, n + 1);
+		k = rand64() % 6;
+		gen_str(sb, k);
+		a->t = obj(C, sb, k + 1);
+		break;
+	case STRSTR:
+	case MEMMEM:
+		if (t->sig == STRSTR)
+			gen_str(sa, n);
+		else
+			gen_mem(sa, n);
+		k = rand64() % 4 ? rand64() % 10 : rand64() % 100;
+		if (k <= n && rand64() % 2) {
+			size_t pos = rand64() % (n - k + 1);
+			for (size_t i = 0; i < k; i++)
+				sb[i] = sa[pos + i];
+			if (rand64() % 4 == 0)
+				mutate(sb, k);
+		}
+		else if (t->sig == STRSTR)
+			gen_str(sb, k);
+		else
+			gen_mem(sb, k);
+		sb[k] = 0;
+		if (t->flags & CASE)
+			swap_case(sb, k);
+		a->s = obj(A, sa, n + (t->sig == STRSTR));
+		a->t = obj(C, sb, k + (t->sig == STRSTR));
+		a->m = k;
+		break;
+	case MEMCMP:
+		gen_mem(sa, n);
+		for (size_t i = 0; i < n; i++)
+			sb[i] = sa[i];
+		if (rand64() % 4)
+			mutate(sb, n);
+		a->s = obj(A, sa, n);
+		a->t = obj(C, sb, n);
+		break;
+	case STRCMP:
+	case STRNCMP:
+		gen_str(sa, n);
+		k = rand64() % 4 ? n : rsize();
+		for (size_t i = 0; i < k; i++)
+			sb[i] = i < n ? sa[i] : rchar();
+		sb[k] = 0;
+		if (t->flags & CASE)
+			swap_case(sb, k);
+		if (rand64() % 4)
+			mutate(sb, k);
+		if (t->sig == STRCMP)
+			m = -1;
+		a->s = obj(A, sa, min(n + 1, m));
+		a->t = obj(C, sb, min(k + 1, m));
+		a->n = m;
+		break;
+	case MEMCPY:
+	case MEMCCPY:
+		gen_mem(sa, n);
+		a->s = obj(A, sa, n);
+		a->d = obj(B, junk, n);
+		break;
+	case MEMMOVE: {
+		size_t bytes = n * cs;
+		size_t soff = rand64() % (ARENA - bytes + 1);
+		size_t doff = soff + rand64() % (2 * bytes + 129) - bytes - 64;
+		if (doff > ARENA - bytes)
+			doff = soff;
+		gen_mem(sa, n);
+		a->d = obj_at(A, doff, junk, n);
+		a->s = obj_at(A, soff, sa, n);
+		break;
+	}
+	case STRCPY:
+		gen_str(sa, n);
+		a->s = obj(A, sa, n + 1);
+		a->d = obj(B, junk, n + 1);
+		break;
+	case STRNCPY:
+		gen_str(sa, n);
+		a->s = obj(A, sa, min(n + 1, m));
+		a->d = obj(B, junk, m);
+		a->n = m;
+		break;
+	case STRLCPY:
+		gen_str(sa, n);
+		a->s = obj(A, sa, n + 1);
+		a->d = obj(B, junk, m);
+		a->n = m;
+		break;
+	case MEMSET:
+		a->d = obj(B, junk, n);
+		break;
+	}
+}
+
+#define PTR(r) ((r) ? (intptr_t)((char *)(r) - b) : -1)
+#define SIGN(r) ((r) > 0 ? 1 : (r) < 0 ? -1 : 0)
+
+static intptr_t call(func f, struct args *a, const char *b) {
+	switch (cur->sig) {
+	case MEMCHR:
+		return PTR(((void *(*)(const void *, int, size_t))f)(a->s, a->c, a->n));
+	case RAWMEMCHR:
+	case STRCHR:
+		return PTR(((void *(*)(const void *, int))f)(a->s, a->c));
+	case STRLEN:
+		return ((size_t (*)(const void *))f)(a->s);
+	case STRNLEN:
+		return ((size_t (*)(const void *, size_t))f)(a->s, a->n);
+	case SPN:
+		return ((size_t (*)(const void *, const void *))f)(a->s, a->t);
+	case PBRK:
+	case STRSTR:
+		return PTR(((void *(*)(const void *, const void *))f)(a->s, a->t));
+	case MEMMEM:
+		return PTR(((void *(*)(const void *, size_t, const void *, size_t))f)(a->s, a->n, a->t, a->m));
+	case MEMCMP:
+	case STRNCMP:
+		return SIGN(((int (*)(const void *, const void *, size_t))f)(a->s, a->t, a->n));
+	case STRCMP:
+		return SIGN(((int (*)(const void *, const void *))f)(a->s, a->t));
+	case MEMCPY:
+	case MEMMOVE:
+	case STRNCPY:
+		return PTR(((void *(*)(void *, const void *, size_t))f)(a->d, a->s, a->n));
+	case STRCPY:
+		return PTR(((void *(*)(void *, const void *))f)(a->d, a->s));
+	case STRLCPY:
+		return ((size_t (*)(void *, const void *, size_t))f)(a->d, a->s, a->n);
+	case MEMCCPY:
+		return PTR(((void *(*)(void *, const void *, int, size_t))f)(a->d, a->s, a->c, a->n));
+	case MEMSET:
+		return PTR(((void *(*)(void *, int, size_t))f)(a->d, a->c, a->n));
+	}
+	return 0;
+}
+
+static long where(const char *p) {
+	if (!p)
+		return -1;
+	if (big[0] && p >= big[0] && p < big_arena(0, 2))
+		return (p - big[0]) % (big_len + PAGE) - PAGE;
+	return (p - base[0]) % (ARENA + PAGE) - PAGE;
+}
+
+static void report(const char *what) {
+	struct args *a = &cur_args;
+	fprintf(stderr, "%s: %s (seed %llu, iteration %ld)\n", cur->name, what, seed, iter);
+	fprintf(stderr, "\tn=%zu m=%zu c=%#x s@%ld t@%ld d@%ld\n", a->n, a->m, a->c,
+		where(a->s), where(a->t), where(a->d));
+}
+
+static void fault(int sig) {
+	report(sig == SIGSEGV ? "segmentation fault" : "bus error");
+	_exit(2);
+}
+
+/* copies bytes [off, off+len) of large arena a and their margins to the
+ * reference set after filling them with random bytes, or compares them */
+static int large_window(int a, size_t off, size_t len, int check) {
+	size_t lo = off > MARGIN ? off - MARGIN : 0;
+	size_t hi = off + len + MARGIN < big_len ? off + len + MARGIN : big_len;
+	char *p = big_arena(0, a), *q = big_arena(1, a);
+	for (size_t i = lo; i < hi; i++) {
+		if (!check)
+			p[i] = q[i] = rand64();
+		else if (p[i] != q[i]) {
+			char msg[80];
+			snprintf(msg, sizeof msg, "memory differs at %ld", where(p + i));
+			report(msg);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* the size of the highest level cache cpu 0 has, or 0 if unknown */
+static size_t cache_size(void) {
+	size_t size = 0;
+	int top = 0;
+	for (int i = 0; ; i++) {
+		char path[64], unit = 0;
+		int level;
+		size_t n;
+		FILE *f;
+		snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+		if (!(f = fopen(path, "r")))
+			break;
+		if (fscanf(f, "%d", &level) != 1)
+			level = 0;
+		fclose(f);
+		snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+		if (level < top || !(f = fopen(path, "r")))
+			continue;
+		if (fscanf(f, "%zu%c", &n, &unit) >= 1) {
+			top = level;
+			size = unit == 'M' ? n << 20 : unit == 'K' ? n << 10 : n;
+		}
+		fclose(f);
+	}
+	return size;
+}
+
+static int run_large(const struct test *t) {
+	static const int extra[] = { -1, 0, 17 };
+	const size_t thresholds[] = { 2048, 4096, 2 << 20, llc / 4, llc };
+	int failures = 0;
+	if (t->sig != MEMCPY && t->sig != MEMMOVE && t->sig != MEMSET)
+		return 0;
+	for (size_t i = 0; i < sizeof thresholds / sizeof *thresholds; i++) {
+		if (!thresholds[i] || thresholds[i] > LARGE_MAX)
+			continue;
+		for (size_t j = 0; j < sizeof extra / sizeof *extra; j++) {
+			struct args a = { .n = thresholds[i] / cs + extra[j] }, ref;
+			size_t bytes = a.n * cs;
+			/* source against the guard page, destination in the other arena */
+			size_t soff = big_len - bytes, doff = rand64() % 64 / cs * cs;
+			int da = 1;
+			pick_alphabet();
+			a.c = rc();
+			if (t->sig == MEMMOVE) {
+				size_t delta = (1 + rand64() % 64) * cs;
+				soff = PAGE + rand64() % 64 / cs * cs;
+				doff = rand64() % 2 ? soff + delta : soff - delta;
+				da = 0;
+			}
+			large_window(0, soff, bytes, 0);
+			large_window(da, doff, bytes, 0);
+			a.s = big_arena(0, 0) + soff;
+			a.d = big_arena(0, da) + doff;
+			ref = a;
+			ref.s += big[1] - big[0];
+			ref.d += big[1] - big[0];
+			cur_args = a;
+			/* reported as iteration -1 */
+			iter = -1;
+			intptr_t want = call(t->ref, &ref, big[1]);
+			intptr_t got = call(t->impl, &a, big[0]);
+			if (got != want) {
+				char msg[80];
+				snprintf(msg, sizeof msg, "returned %ld, expected %ld", (long)got, (long)want);
+				report(msg);
+				failures++;
+			}
+			else if (large_window(0, soff, bytes, 1) || large_window(da, doff, bytes, 1))
+				failures++;
+		}
+	}
+	return failures;
+}
+
+static int run(const struct test *t, long iterations) {
+	int failures = 0;
+	ptrdiff_t delta = base[1] - base[0];
+	cur = t;
+	cs = t->flags & WIDE ? sizeof(wchar_t) : 1;
+	rng = seed ^ 0x9e3779b97f4a7c15 * (t - tests + 1);
+	if (!rng)
+		rng = 1;
+	for (iter = 0; iter < iterations && failures < 5; iter++) {
+		struct args a, ref;
+		setup(t, &a);
+		for (int i = 0; i < nwin; i++)
+			for (size_t j = 0; j < win[i].len; j++)
+				base[1][win[i].off + j] = base[0][win[i].off + j];
+		ref = a;
+		ref.s = a.s ? a.s + delta : 0;
+		ref.t = a.t ? a.t + delta : 0;
+		ref.d = a.d ? a.d + delta : 0;
+		cur_args = a;
+		intptr_t want = call(t->ref, &ref, base[1]);
+		intptr_t got = call(t->impl, &a, base[0]);
+		if (got != want) {
+			char msg[80];
+			snprintf(msg, sizeof msg, "returned %ld, expected %ld", (long)got, (long)want);
+			report(msg);
+			failures++;
+		}
+		for (int i = 0; i < nwin; i++)
+			for (size_t j = 0; j < win[i].len; j++)
+				if (base[1][win[i].off + j] != base[0][win[i].off + j]) {
+					char msg[80];
+					snprintf(msg, sizeof msg, "memory differs at %ld",
+						where(base[0] + win[i].off + j));
+					report(msg);
+					failures++;
+					i = nwin;
+					break;
+				}
+	}
+	return failures + run_large(t);
+}
+
+int main(int argc, char **argv) {
+	const char *only = 0;
+	long iterations = 10000;
+	int opt;
+	seed = 1;
+	while ((opt = getopt(argc, argv, "f:n:s:")) != -1) {
+		switch (opt) {
+		case 'f': only = optarg; break;
+		case 'n': iterations = strtol(optarg, 0, 0); break;
+		case 's': seed = strtoull(optarg, 0, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-f function] [-n iterations] [-s seed]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	/* each set is a guard page followed by arenas, each followed by a guard page */
+	size_t size = PAGE + NARENAS * (ARENA + PAGE);
+	for (int set = 0; set < 2; set++) {
+		base[set] = mmap(0, size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (base[set] == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+		for (int i = 0; i < NARENAS; i++)
+			mprotect(arena(set, i), ARENA, PROT_READ|PROT_WRITE);
+	}
+
+	/* two arenas per set for the large sizes, with guard pages as above */
+	llc = cache_size();
+	big_len = 2 << 20;
+	if (llc / 4 <= LARGE_MAX && llc / 4 > big_len)
+		big_len = llc / 4;
+	if (llc <= LARGE_MAX && llc > big_len)
+		big_len = llc;
+	big_len = (big_len + 64 * sizeof(wchar_t) + 3 * PAGE - 1) / PAGE * PAGE;
+	size = PAGE + 2 * (big_len + PAGE);
+	for (int set = 0; set < 2; set++) {
+		big[set] = mmap(0, size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (big[set] == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+		for (int i = 0; i < 2; i++)
+			mprotect(big_arena(set, i), big_len, PROT_READ|PROT_WRITE);
+	}
+
+	signal(SIGSEGV, fault);
+	signal(SIGBUS, fault);
+
+	const char *mask = getenv("MUSL_HWCAP_MASK");
+	int failed = 0;
+	for (size_t i = 0; i < sizeof tests / sizeof *tests; i++) {
+		if (only && strcmp(only, tests[i].name))
+			continue;
+		if (run(&tests[i], iterations))
+			failed++;
+	}
+	printf("strtest: MUSL_HWCAP_MASK=%s: %d of %zu functions failed\n",
+		mask ? mask : "", failed, sizeof tests / sizeof *tests);
+	return failed != 0;
+}